@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "audio.hpp"
+#include "bench.hpp"
+#include "probe.hpp"
+
+#define AUDIO_BENCH_IPF 10         // instructions per frame, same default as chip8-run
+#define AUDIO_BENCH_CHUNK 1024     // samples per read, what the SFML sink pulls
+#define AUDIO_BENCH_LIVE_FRAMES 60 // one second played in real time
+
+namespace {
+
+/// Prints the stream's counters under the last result line
+void print_stats(const audio_stream& audio) {
+    auto stats = audio.stats();
+    printf("%-10s %-32s %llu underruns, %llu samples dropped, max latency %.1f ms\n", "", "",
+           static_cast<unsigned long long>(stats.underruns),
+           static_cast<unsigned long long>(stats.overflows),
+           stats.max_queued * 1000.0 / AUDIO_SAMPLE_RATE);
+}
+
+} // namespace
+
+/// Cost of the sound on the emulation thread: synthesizing a frame silent, beeping and at
+/// the highest pitch, queueing and draining a frame as headless runs do, and a second of
+/// real time play through the ring to another thread, with its underruns and latency
+BENCH_SUITE(audio) {
+    u64 frames = std::max<u64>(args.cycles / AUDIO_BENCH_IPF, 1);
+    std::array<s16, AUDIO_FRAME_SAMPLES> out;
+
+    struct tone {
+        const char* name;
+        u8 sound_timer;
+        u8 pitch;
+    };
+    const tone tones[] = {
+        {"synthesize (silent)", 0, DEFAULT_PITCH},
+        {"synthesize (beep)", 0xFF, DEFAULT_PITCH},
+        {"synthesize (pitch 255)", 0xFF, 0xFF},
+    };
+    for (const auto& t : tones) {
+        probe_chip8 vm;
+        vm.set_v(0, t.sound_timer);
+        vm.set_v(1, t.pitch);
+        vm.exec(0xF018); // ld_st V0
+        vm.exec(0xF13A); // ld_pitch V1
+        u32 phase = 0;
+        double seconds = bench_time([&] {
+            for (u64 frame = 0; frame < frames; frame++) {
+                synthesize(vm, out.data(), out.size(), phase);
+            }
+        });
+        bench_report("audio", t.name, frames, seconds);
+        printf("%-10s %-32s %.0f ns per frame\n", "", "", seconds * 1e9 / frames);
+    }
+
+    // what a headless run writing a .wav does after every frame
+    probe_chip8 vm;
+    vm.set_v(0, 0xFF);
+    vm.exec(0xF018);
+    {
+        audio_stream audio;
+        std::array<s16, AUDIO_FRAME_SAMPLES> drained;
+        double seconds = bench_time([&] {
+            for (u64 frame = 0; frame < frames; frame++) {
+                audio.render_frame(vm);
+                audio.pop(drained.data(), drained.size());
+            }
+        });
+        bench_report("audio", "render + drain", frames, seconds);
+        printf("%-10s %-32s %.0f ns per frame\n", "", "", seconds * 1e9 / frames);
+    }
+
+    // both sides at their real rates, the latency and underruns a front end sees
+    {
+        using clock = std::chrono::steady_clock;
+        audio_stream audio;
+        auto start = clock::now();
+        double seconds = bench_time([&] {
+            std::thread producer([&] {
+                for (u64 frame = 0; frame < AUDIO_BENCH_LIVE_FRAMES; frame++) {
+                    std::this_thread::sleep_until(start + frame * std::chrono::microseconds(
+                                                                      1'000'000 / TIMER_HZ));
+                    audio.render_frame(vm);
+                }
+            });
+            std::array<s16, AUDIO_BENCH_CHUNK> chunk;
+            const u64 samples = AUDIO_BENCH_LIVE_FRAMES * AUDIO_FRAME_SAMPLES;
+            for (u64 read = 0; read + chunk.size() <= samples; read += chunk.size()) {
+                std::this_thread::sleep_until(
+                    start + std::chrono::microseconds(read * 1'000'000 / AUDIO_SAMPLE_RATE));
+                audio.read(chunk.data(), chunk.size());
+            }
+            producer.join();
+        });
+        bench_report("audio", "stream (real time)", AUDIO_BENCH_LIVE_FRAMES, seconds);
+        print_stats(audio);
+    }
+}
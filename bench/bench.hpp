@@ -0,0 +1,63 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+/// Options shared by every benchmark suite
+struct bench_args {
+    std::string roms_dir;
+    u64 cycles;
+};
+
+/// One bench_report() line, kept for the JSON report
+struct bench_result {
+    std::string suite;
+    std::string name;
+    u64 ops;
+    double seconds;
+};
+
+/// A named group of benchmarks, registered with BENCH_SUITE
+struct bench_suite {
+    const char* name;
+    void (*fn)(const bench_args& args);
+};
+
+/// Returns every registered suite
+std::vector<bench_suite>& bench_registry();
+
+/// Registers `fn` as a suite named `name` at static init time
+struct bench_register {
+    bench_register(const char* name, void (*fn)(const bench_args&)) {
+        bench_registry().push_back({name, fn});
+    }
+};
+
+#define BENCH_SUITE(name)                                                                     \
+    static void bench_##name(const bench_args& args);                                         \
+    static bench_register bench_reg_##name(#name, bench_##name);                              \
+    static void bench_##name(const bench_args& args)
+
+/// Returns the paths of every ROM inside args.roms_dir, sorted by name
+std::vector<std::string> bench_roms(const bench_args& args);
+
+/// Prints one result line, ops is whatever unit the case counts (instructions, frames...)
+/// Every result is also written to the JSON report when one was asked for (--json)
+void bench_report(const char* suite, const std::string& name, u64 ops, double seconds);
+
+/// Returns every result reported so far
+std::vector<bench_result>& bench_results();
+
+/// Returns the wall time of fn() in seconds
+template <typename F> double bench_time(F&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+#endif
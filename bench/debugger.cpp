@@ -0,0 +1,36 @@
+#include <filesystem>
+#include <stdexcept>
+
+#include "bench.hpp"
+#include "debugger.hpp"
+#include "probe.hpp"
+
+/// Cached engine throughput with the debugger idle (created, nothing armed) and with a
+/// breakpoint and a memory watchpoint armed that are never hit
+/// Every run must end in the same state, the idle one at the speed of no debugger at all
+BENCH_SUITE(debugger) {
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        probe_chip8 plain, idle, armed;
+        for (probe_chip8* vm : {&plain, &idle, &armed}) {
+            vm->set_engine(engine::cached);
+            vm->set_seed(0);
+            vm->load_rom(rom);
+        }
+        idle.debug();
+        armed.debug().set_breakpoint(MEMORY_SIZE - 2);
+        armed.debug().watch_memory(MEMORY_SIZE - 16, MEMORY_SIZE - 1);
+
+        double seconds = bench_time([&] { plain.step(args.cycles); });
+        bench_report("debugger", name + " (none)", args.cycles, seconds);
+        seconds = bench_time([&] { idle.step(args.cycles); });
+        bench_report("debugger", name + " (idle)", args.cycles, seconds);
+        seconds = bench_time([&] { armed.step(args.cycles); });
+        bench_report("debugger", name + " (armed)", args.cycles, seconds);
+
+        if (!idle.same_state(plain) || !armed.same_state(plain)) {
+            throw std::runtime_error(name + ": the debugger changed the result");
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#include "bench.hpp"
+#include "chip8.hpp"
+#include "disassembler.hpp"
+
+#define DISASM_BENCH_IPF 10 // instructions per frame, same default as chip8-run
+#define DISASM_BENCH_FULL 100
+
+/// Cost of the Code dock's listing per ROM: analyzing a freshly loaded image from scratch,
+/// and keeping it up to date once per frame while the ROM runs and writes memory
+BENCH_SUITE(disasm) {
+    u64 frames = std::max<u64>(args.cycles / DISASM_BENCH_IPF, 1);
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        chip8 vm;
+        vm.set_seed(0);
+        vm.load_rom(rom);
+        disassembler disasm;
+        double seconds = bench_time([&] {
+            for (u64 n = 0; n < DISASM_BENCH_FULL; n++) {
+                disasm.reset();
+                disasm.update(vm.get_memory(), vm.get_pc());
+            }
+        });
+        bench_report("disasm", name + " (full analysis)", DISASM_BENCH_FULL, seconds);
+        printf("%-10s %-32s %u instructions, %zu rows, %.0f us\n", "", "",
+               disasm.stats().instructions, disasm.rows().size(),
+               seconds * 1e6 / DISASM_BENCH_FULL);
+
+        seconds = 0;
+        for (u64 frame = 0; frame < frames; frame++) {
+            vm.step(DISASM_BENCH_IPF);
+            vm.tick_timers();
+            seconds += bench_time([&] { disasm.update(vm.get_memory(), vm.get_pc()); });
+        }
+        auto stats = disasm.stats();
+        bench_report("disasm", name + " (update per frame)", frames, seconds);
+        printf("%-10s %-32s %.0f ns per frame, %llu redecoded, %llu rebuilds\n", "", "",
+               seconds * 1e9 / frames, static_cast<unsigned long long>(stats.invalidated),
+               static_cast<unsigned long long>(stats.rebuilds));
+    }
+}
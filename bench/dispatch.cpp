@@ -0,0 +1,106 @@
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "chip8.hpp"
+
+namespace {
+
+/// Exposes the dispatcher that chip8::run() used before the decode table, and the current
+/// one without the handlers' work
+class linear_chip8 : public chip8 {
+  public:
+    /// Fetch, then scan opcode_table until a mask matches
+    void run_linear() {
+        _opcode = (_memory[_pc] << 8 | _memory[_pc + 1]);
+        _pc += 2;
+
+        bool found = false;
+        for (const auto& op : opcode_table) {
+            if (op._opcode == (_opcode & op._mask)) {
+                found = true;
+                op._fn(*this);
+                break;
+            }
+        }
+
+        if (!found) {
+            invalid();
+        }
+    }
+
+    /// Runs `cycles` instructions and returns every opcode executed, in order
+    std::vector<u16> trace(usize cycles) {
+        std::vector<u16> opcodes(cycles);
+        for (auto& op : opcodes) {
+            run();
+            op = _opcode;
+        }
+        return opcodes;
+    }
+
+    /// Decodes every opcode of trace and calls an empty handler per opcode_table entry
+    /// instead of the real one, so only the table lookups and the indirect call are left
+    void dispatch_only(const std::vector<u16>& trace) {
+        for (u16 op : trace) {
+            empty_handlers()[decode_table[op]](*this);
+        }
+    }
+
+  private:
+    template <usize N> static void empty(chip8&) {
+        [[maybe_unused]] static volatile usize sink;
+        sink = N; // distinct bodies, so the compiler keeps one target per instruction
+    }
+
+    template <usize... N>
+    static std::array<handler, 256> make_empty_handlers(std::index_sequence<N...>) {
+        std::array<handler, 256> table;
+        table.fill(&empty<MAX_INSTRUCTIONS>); // INVALID_INSTRUCTION
+        ((table[N] = &empty<N>), ...);
+        return table;
+    }
+
+    static const std::array<handler, 256>& empty_handlers() {
+        static const auto table =
+            make_empty_handlers(std::make_index_sequence<MAX_INSTRUCTIONS>());
+        return table;
+    }
+};
+
+} // namespace
+
+/// Interpreter dispatch per ROM: scanning opcode_table, the decode and handler tables, and
+/// the tables' fetch-free cost alone over a recorded instruction stream
+BENCH_SUITE(dispatch) {
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+        linear_chip8 vm;
+
+        vm.set_seed(0);
+        vm.load_rom(rom);
+        double linear = bench_time([&] {
+            for (u64 n = 0; n < args.cycles; n++) {
+                vm.run_linear();
+            }
+        });
+        bench_report("dispatch", name + " (linear)", args.cycles, linear);
+
+        vm.set_seed(0);
+        vm.load_rom(rom);
+        double table = bench_time([&] {
+            for (u64 n = 0; n < args.cycles; n++) {
+                vm.run();
+            }
+        });
+        bench_report("dispatch", name + " (table)", args.cycles, table);
+
+        // the same instruction stream again, dispatched to handlers that do nothing
+        vm.set_seed(0);
+        vm.load_rom(rom);
+        auto trace = vm.trace(args.cycles);
+        double dispatch = bench_time([&] { vm.dispatch_only(trace); });
+        bench_report("dispatch", name + " (dispatch only)", args.cycles, dispatch);
+    }
+}
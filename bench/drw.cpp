@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <string>
+
+#include "bench.hpp"
+#include "probe.hpp"
+
+#define DRW_SPRITE_ADDR 0x300
+
+/// drw() alone over every sprite height at positions that take each path of its row
+/// loop: byte aligned, unaligned, clipped at the right and bottom edges, and the same
+/// edges wrapping around, plus the SUPER-CHIP hi-res display and its 16x16 sprites and
+/// XO-CHIP sprites drawn to both planes
+BENCH_SUITE(drw) {
+    struct position {
+        const char* name;
+        u8 x, y;
+        bool wrap, hires;
+        u8 planes;
+    };
+    static const position positions[] = {
+        {"aligned", 8, 4, false, false, 1},
+        {"unaligned", 13, 4, false, false, 1},
+        {"right clip", 60, 4, false, false, 1},
+        {"bottom clip", 8, 28, false, false, 1},
+        {"right wrap", 60, 4, true, false, 1},
+        {"bottom wrap", 8, 28, true, false, 1},
+        {"hi-res unaligned", 61, 4, false, true, 1},
+        {"hi-res right wrap", 124, 4, true, true, 1},
+        {"two planes unaligned", 13, 4, false, false, 3},
+    };
+
+    u64 calls = std::max<u64>(args.cycles, 1);
+    for (const auto& pos : positions) {
+        // Dxy0 draws 16x16 in hi-res only
+        for (u8 height = pos.hires ? 0 : 1; height <= 0xF; height++) {
+            probe_chip8 vm;
+            for (u16 row = 0; row < 64; row++) {
+                vm.write_memory(DRW_SPRITE_ADDR + row, static_cast<u8>(0xA5 ^ row * 0x11));
+            }
+            vm.set_sprite_wrap(pos.wrap);
+            if (pos.hires) {
+                vm.exec(0x00FF);
+            }
+            vm.exec(0xF001 | pos.planes << 8);
+            vm.set_v(0, pos.x);
+            vm.set_v(1, pos.y);
+            vm.set_registers(DRW_SPRITE_ADDR, START_ADDR, 0);
+
+            u16 op = 0xD010 | height;
+            double seconds = bench_time([&] {
+                for (u64 n = 0; n < calls; n++) {
+                    vm.exec(op);
+                }
+            });
+            auto size = height ? std::to_string(height) + " rows" : std::string("16x16");
+            bench_report("drw", std::string(pos.name) + " " + size, calls, seconds);
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#include "bench.hpp"
+#include "probe.hpp"
+#include "simd_batch.hpp"
+
+BENCH_SUITE(engines) {
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        probe_chip8 reference;
+        reference.set_seed(0);
+        reference.load_rom(rom);
+        double seconds = bench_time([&] { reference.step(args.cycles); });
+        bench_report("engines", name + " (interpreter)", args.cycles, seconds);
+
+        for (auto e : {engine::cached, engine::jit}) {
+            probe_chip8 vm;
+            vm.set_engine(e);
+            vm.set_seed(0);
+            vm.load_rom(rom);
+            seconds = bench_time([&] { vm.step(args.cycles); });
+            bench_report("engines", name + " (" + engine_name(e) + ")", args.cycles, seconds);
+
+            const auto& stats = vm.get_block_stats();
+            printf("%-10s %-32s %llu hits, %llu misses, %llu invalidations\n", "", "",
+                   static_cast<unsigned long long>(stats.hits),
+                   static_cast<unsigned long long>(stats.misses),
+                   static_cast<unsigned long long>(stats.invalidations));
+
+            if (!vm.same_state(reference)) {
+                throw std::runtime_error(name + ": " + engine_name(e) +
+                                         " diverged from the interpreter");
+            }
+        }
+    }
+}
+
+/// Steps the interpreter and every other engine side by side, comparing the whole state after
+/// every slice, so a divergence is reported close to where it happened. Each slice is one
+/// frame: the timers tick and the scripted keys change between slices, like in the GUI
+BENCH_SUITE(lockstep) {
+    const u64 slice = 97; // odd on purpose, so slices end in the middle of blocks too
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        for (auto e : {engine::cached, engine::jit}) {
+            probe_chip8 reference, vm;
+            vm.set_engine(e);
+            reference.load_rom(rom);
+            vm.load_rom(rom);
+            reference.set_seed(0);
+            vm.set_seed(0);
+
+            double seconds = bench_time([&] {
+                for (u64 done = 0; done < args.cycles; done += slice) {
+                    for (auto* m : {static_cast<chip8*>(&reference), static_cast<chip8*>(&vm)}) {
+                        script_keys(*m, done / slice);
+                        m->step(slice);
+                        m->tick_timers();
+                    }
+                    if (!vm.same_state(reference)) {
+                        throw std::runtime_error(name + ": " + engine_name(e) +
+                                                 " diverged from the interpreter near pc " +
+                                                 std::to_string(reference.pc()) + " after " +
+                                                 std::to_string(done + slice) + " cycles");
+                    }
+                }
+            });
+            bench_report("lockstep", name + " (" + engine_name(e) + ")", args.cycles, seconds);
+        }
+    }
+}
+
+/// Fx15 and Fx1E take their operand from Vx: a loop where Vx != x runs in every engine and
+/// in a simd batch, then the timer, I and V5 are checked against the values worked out by hand
+BENCH_SUITE(fx_operands) {
+    // 6312 6534 A300 F315 F51E F31E F507 1200: DT = V3, I = 0x300 + V5 + V3, V5 = DT
+    const std::vector<u8> program = {0x63, 0x12, 0x65, 0x34, 0xA3, 0x00, 0xF3, 0x15,
+                                     0xF5, 0x1E, 0xF3, 0x1E, 0xF5, 0x07, 0x12, 0x00};
+    const u64 cycles = std::max<u64>(args.cycles / 8, 1) * 8; // whole passes of the loop
+
+    auto check = [](const chip8& vm, const std::string& name) {
+        if (vm.get_delay_timer() != 0x12 || vm.get_i() != 0x346 || vm.get_v()[5] != 0x12) {
+            throw std::runtime_error(name + ": Fx15/Fx1E used x instead of Vx");
+        }
+    };
+
+    for (auto e : {engine::interpreter, engine::cached, engine::jit}) {
+        chip8 vm;
+        vm.set_engine(e);
+        vm.load_rom(program);
+        double seconds = bench_time([&] { vm.step(cycles); });
+        bench_report("fx_operands", engine_name(e), cycles, seconds);
+        check(vm, engine_name(e));
+    }
+
+    simd_batch batch;
+    for (usize l = 0; l < batch.size(); l++) {
+        batch[l].load_rom(program);
+    }
+    double seconds = bench_time([&] { batch.step(cycles); });
+    bench_report("fx_operands", "simd batch", cycles * batch.size(), seconds);
+    for (usize l = 0; l < batch.size(); l++) {
+        check(batch[l], "simd lane " + std::to_string(l));
+    }
+}
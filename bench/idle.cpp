@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <set>
+#include <stdexcept>
+
+#include "bench.hpp"
+#include "probe.hpp"
+
+/// Frames of ipf instructions plus a timer tick on the cached engine, as run and with idle
+/// loops skipped: at the default clock (too short a step to probe), and at faster ones where
+/// waits take most of the frame. Both runs must end in the same state, and the timer waits
+/// of PONG and TETRIS (one a jump back, the other 8 instructions through skips and a forward
+/// jump) must be caught at the fastest clock.
+BENCH_SUITE(idle) {
+    const std::set<std::string> waiting = {"PONG", "TETRIS"};
+    for (u64 ipf : {10, 100, 1000}) {
+        u64 frames = std::max<u64>(args.cycles / ipf, 1);
+        for (const auto& rom : bench_roms(args)) {
+            auto name = std::filesystem::path(rom).filename().string();
+            auto label = " (" + std::to_string(ipf) + " ipf";
+
+            probe_chip8 plain, skipping;
+            for (probe_chip8* vm : {&plain, &skipping}) {
+                vm->set_engine(engine::cached);
+                vm->set_seed(0);
+                vm->load_rom(rom);
+            }
+            skipping.set_idle_skip(true);
+
+            auto run = [&](probe_chip8& vm) {
+                return bench_time([&] {
+                    for (u64 frame = 0; frame < frames; frame++) {
+                        vm.step(ipf);
+                        vm.tick_timers();
+                    }
+                });
+            };
+            bench_report("idle", name + label + ")", frames * ipf, run(plain));
+            bench_report("idle", name + label + ", skipping)", frames * ipf, run(skipping));
+            printf("%-10s %-32s %.1f%% of the instructions skipped\n", "", "",
+                   skipping.get_idle_skipped() * 100.0 / (frames * ipf));
+
+            if (!skipping.same_state(plain)) {
+                throw std::runtime_error(name + ": skipping idle loops changed the result");
+            }
+            if (ipf == 1000 && waiting.count(name) && !skipping.get_idle_skipped()) {
+                throw std::runtime_error(name + ": no idle loop found");
+            }
+        }
+    }
+}
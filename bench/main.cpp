@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "bench.hpp"
+
+std::vector<bench_suite>& bench_registry() {
+    static std::vector<bench_suite> suites;
+    return suites;
+}
+
+std::vector<std::string> bench_roms(const bench_args& args) {
+    std::vector<std::string> roms;
+    for (const auto& entry : std::filesystem::directory_iterator(args.roms_dir)) {
+        if (entry.is_regular_file()) {
+            roms.push_back(entry.path().string());
+        }
+    }
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+std::vector<bench_result>& bench_results() {
+    static std::vector<bench_result> results;
+    return results;
+}
+
+void bench_report(const char* suite, const std::string& name, u64 ops, double seconds) {
+    bench_results().push_back({suite, name, ops, seconds});
+    printf("%-10s %-32s %12llu ops %9.3f ms %14.0f ops/s\n", suite, name.c_str(),
+           static_cast<unsigned long long>(ops), seconds * 1000.0, ops / seconds);
+}
+
+namespace {
+
+/// Escapes a string for a JSON string literal
+std::string json_string(const std::string& str) {
+    std::string out = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+/// Prints the options and every registered suite
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " <option(s)> [suite...]\n"
+              << "Options:\n"
+              << "\t-r,--roms <dir>\tROM directory (default: " << CHIP8_ROMS_DIR << ")\n"
+              << "\t-c,--cycles <n>\tInstructions executed per ROM\n"
+              << "\t-j,--json <file>\tAlso write the results as JSON, - for stdout\n"
+              << "Suites:\n";
+    for (const auto& suite : bench_registry()) {
+        std::cerr << "\t" << suite.name << "\n";
+    }
+}
+
+/// Writes every result as JSON, one object per case, so runs can be diffed over time
+bool write_json(const std::string& filename, const bench_args& args) {
+    FILE* out = filename == "-" ? stdout : fopen(filename.c_str(), "w");
+    if (!out) {
+        fprintf(stderr, "[-] can't write %s \n", filename.c_str());
+        return false;
+    }
+
+    fprintf(out, "{\n  \"cycles\": %llu,\n  \"roms\": %s,\n  \"results\": [\n",
+            static_cast<unsigned long long>(args.cycles), json_string(args.roms_dir).c_str());
+    const auto& results = bench_results();
+    for (usize idx = 0; idx < results.size(); idx++) {
+        const auto& r = results[idx];
+        fprintf(out,
+                "    {\"suite\": %s, \"name\": %s, \"ops\": %llu, \"seconds\": %.9f, "
+                "\"ops_per_second\": %.0f}%s\n",
+                json_string(r.suite).c_str(), json_string(r.name).c_str(),
+                static_cast<unsigned long long>(r.ops), r.seconds, r.ops / r.seconds,
+                idx + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return out == stdout || fclose(out) == 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench_args args{CHIP8_ROMS_DIR, 1'000'000};
+    std::vector<std::string> only;
+    std::string json;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string& arg = argv[i];
+        if ((arg == "-r" || arg == "--roms") && i + 1 < argc) {
+            args.roms_dir = argv[++i];
+        } else if ((arg == "-c" || arg == "--cycles") && i + 1 < argc) {
+            args.cycles = std::stoull(argv[++i]);
+        } else if ((arg == "-j" || arg == "--json") && i + 1 < argc) {
+            json = argv[++i];
+        } else if (arg[0] != '-') {
+            only.push_back(arg);
+        } else {
+            usage(argv[0]);
+            return 0;
+        }
+    }
+
+    std::error_code ec;
+    if (!std::filesystem::is_directory(args.roms_dir, ec)) {
+        fprintf(stderr, "[-] %s is not a directory \n", args.roms_dir.c_str());
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (const auto& suite : bench_registry()) {
+        if (only.empty() || std::find(only.begin(), only.end(), suite.name) != only.end()) {
+            suite.fn(args);
+        }
+    }
+    if (!json.empty() && !write_json(json, args)) {
+        return 1;
+    }
+}
@@ -0,0 +1,35 @@
+#include <algorithm>
+
+#include "bench.hpp"
+#include "probe.hpp"
+
+#define OPCODE_OPERANDS 0x0125 // x = 1, y = 2, n = 5, kk = 0x25, nnn = 0x125
+#define OPCODE_I 0x300         // I before every handler, memory instructions stay in bounds
+
+/// Cost of every handler of chip8.cpp on its own: the handler is called through the
+/// handler table on fixed operands, with I, pc and sp put back before each call so jumps,
+/// calls and memory instructions repeat the same work. 0x0NNN (sys) does nothing and is
+/// the cost of the loop and the call.
+BENCH_SUITE(opcodes) {
+    u64 calls = std::max<u64>(args.cycles, 1);
+    auto instructions = probe_chip8::instructions();
+    for (usize idx = 0; idx < instructions.size(); idx++) {
+        auto [opcode, mask] = instructions[idx];
+        u16 op = opcode | (OPCODE_OPERANDS & ~mask);
+
+        probe_chip8 vm;
+        vm.set_seed(0);
+        vm.set_key(0x5, true); // Fx0A completes instead of waiting
+        vm.set_v(1, 0x5);
+        vm.set_v(2, 0x3);
+        vm.set_registers(OPCODE_I, START_ADDR, 1);
+
+        double seconds = bench_time([&] {
+            for (u64 n = 0; n < calls; n++) {
+                vm.set_registers(OPCODE_I, START_ADDR, 1);
+                vm.exec(op);
+            }
+        });
+        bench_report("opcodes", chip8::instruction_name(idx), calls, seconds);
+    }
+}
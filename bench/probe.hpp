@@ -0,0 +1,59 @@
+#ifndef PROBE_HPP
+#define PROBE_HPP
+
+#include <utility>
+#include <vector>
+
+#include "chip8.hpp"
+
+/// chip8 with access to its internals, so benchmarks can check engines agree and time
+/// single handlers
+class probe_chip8 : public chip8 {
+  public:
+    /// Runs opcode's handler without a fetch, as if it was just read from pc
+    void exec(u16 opcode) {
+        _opcode = opcode;
+        _handlers[opcode](*this);
+    }
+
+    /// Puts I, pc and the stack pointer back where exec() loops expect them
+    void set_registers(u16 i, u16 pc, u8 sp) {
+        _i = i;
+        _pc = pc;
+        _sp = sp;
+    }
+
+    void set_v(u8 x, u8 val) {
+        _v[x & 0xF] = val;
+    }
+
+    /// Returns the (opcode, mask) pattern of every instruction in opcode_table
+    static std::vector<std::pair<u16, u16>> instructions() {
+        std::vector<std::pair<u16, u16>> out;
+        for (const auto& op : opcode_table) {
+            out.emplace_back(op._opcode, op._mask);
+        }
+        return out;
+    }
+
+    /// Returns true if the whole architectural state matches other's
+    bool same_state(const probe_chip8& other) const {
+        return _memory == other._memory && _v == other._v && _i == other._i &&
+               _pc == other._pc && _sp == other._sp && _stack == other._stack &&
+               _delay_timer == other._delay_timer && _sound_timer == other._sound_timer &&
+               _video == other._video;
+    }
+
+    u16 pc() const {
+        return _pc;
+    }
+};
+
+/// Presses and releases keys on a fixed schedule, so ROMs waiting for input move on: every
+/// 8 frames the next key of the keypad is held down for 4 frames
+inline void script_keys(chip8& vm, u64 frame) {
+    u8 key = static_cast<u8>((frame / 8) % 16);
+    vm.set_key(key, frame % 8 < 4);
+}
+
+#endif
@@ -0,0 +1,29 @@
+#include <filesystem>
+#include <stdexcept>
+
+#include "bench.hpp"
+#include "probe.hpp"
+
+/// Interpreter throughput with and without profiling counters, the profiled run must end
+/// in the same state
+BENCH_SUITE(profile) {
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        probe_chip8 plain, profiled;
+        for (probe_chip8* vm : {&plain, &profiled}) {
+            vm->set_seed(0);
+            vm->load_rom(rom);
+        }
+        profiled.set_profiling(true);
+
+        double seconds = bench_time([&] { plain.step(args.cycles); });
+        bench_report("profile", name + " (off)", args.cycles, seconds);
+        seconds = bench_time([&] { profiled.step(args.cycles); });
+        bench_report("profile", name + " (counting)", args.cycles, seconds);
+
+        if (!profiled.same_state(plain)) {
+            throw std::runtime_error(name + ": profiling changed the result");
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+#include "bench.hpp"
+#include "probe.hpp"
+#include "simd_batch.hpp"
+
+/// Interpreter throughput per quirk preset, each runs its own handler set so none should
+/// be slower than default. Every engine and a simd lane must end where the interpreter did.
+BENCH_SUITE(quirks) {
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        for (const char* preset : {"default", "vip", "schip,wrap"}) {
+            u8 quirks = 0;
+            parse_quirks(preset, quirks);
+
+            probe_chip8 reference;
+            reference.set_quirks(quirks);
+            reference.set_seed(0);
+            reference.load_rom(rom);
+            double seconds = bench_time([&] { reference.step(args.cycles); });
+            bench_report("quirks", name + " (" + preset + ")", args.cycles, seconds);
+
+            for (auto e : {engine::cached, engine::jit}) {
+                probe_chip8 vm;
+                vm.set_engine(e);
+                vm.set_quirks(quirks);
+                vm.set_seed(0);
+                vm.load_rom(rom);
+                vm.step(args.cycles);
+                if (!vm.same_state(reference)) {
+                    throw std::runtime_error(name + ": " + engine_name(e) + " diverged with " +
+                                             preset + " quirks");
+                }
+            }
+
+            simd_batch batch(1);
+            chip8& setup = batch[0];
+            setup.set_quirks(quirks);
+            setup.set_seed(0);
+            setup.load_rom(rom);
+            batch.step(args.cycles);
+            const chip8& lane = std::as_const(batch)[0]; // brings the registers back
+            if (lane.get_v() != reference.get_v() || lane.get_i() != reference.get_i() ||
+                lane.get_pc() != reference.get_pc() ||
+                lane.get_framebuffer() != reference.get_framebuffer()) {
+                throw std::runtime_error(name + ": simd lane diverged with " +
+                                         std::string(preset) + " quirks");
+            }
+        }
+    }
+}
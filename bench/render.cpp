@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#include "bench.hpp"
+#include "chip8.hpp"
+
+#define RENDER_IPF 10 // instructions per frame, same default as chip8-run
+
+/// Frame time of the GUI render path without a display: every frame runs RENDER_IPF
+/// instructions and ticks the timers, expands the framebuffer to RGBA texels and copies them
+/// into a staging "texture", the CPU side of sf::Texture::update(). Compares converting every
+/// frame with skipping frames the dirty flag says are unchanged, emulation alone is the
+/// baseline.
+BENCH_SUITE(render) {
+    u64 frames = std::max<u64>(args.cycles / RENDER_IPF, 1);
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        static std::array<u32, DISPLAY_SIZE> pixels, texture;
+        for (int mode = 0; mode < 3; mode++) {
+            chip8 vm;
+            vm.set_seed(0);
+            vm.load_rom(rom);
+
+            u64 uploads = 0;
+            double seconds = bench_time([&] {
+                for (u64 frame = 0; frame < frames; frame++) {
+                    vm.step(RENDER_IPF);
+                    vm.tick_timers();
+                    if (mode == 0 || (mode == 2 && !vm.get_video_dirty())) {
+                        continue;
+                    }
+                    const framebuffer& fb = vm.get_framebuffer();
+                    expand_framebuffer<u32>(fb, pixels.data(), TEXEL_ON, TEXEL_OFF);
+                    std::memcpy(texture.data(), pixels.data(),
+                                fb.width() * fb.height() * sizeof(u32));
+                    vm.clear_video_dirty();
+                    uploads++;
+                }
+            });
+
+            const char* label[] = {" (emulation only)", " (every frame)", " (dirty frames)"};
+            bench_report("render", name + label[mode], frames, seconds);
+            if (mode) {
+                printf("%-10s %-32s %llu uploads, %.2f us per frame\n", "", "",
+                       static_cast<unsigned long long>(uploads), seconds * 1e6 / frames);
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#include "bench.hpp"
+#include "chip8.hpp"
+#include "rewind.hpp"
+#include "scheduler.hpp"
+
+#define REWIND_BENCH_IPF 10 // instructions per frame, same default as chip8-run
+
+/// Cost of recording a rewind history: frames run with and without a rewind_buffer
+/// attached to the scheduler, the memory one second of history takes, and the latency of
+/// scrubbing back one frame at a time and jumping to random points of the history
+BENCH_SUITE(rewind) {
+    u64 frames = std::max<u64>(args.cycles / REWIND_BENCH_IPF, 1);
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        double base = 0;
+        rewind_buffer history;
+        for (int recording = 0; recording < 2; recording++) {
+            chip8 vm;
+            vm.set_seed(0);
+            vm.load_rom(rom);
+            scheduler sched(vm);
+            sched.set_instructions_per_frame(REWIND_BENCH_IPF);
+            sched.set_rewind(recording ? &history : nullptr);
+
+            double seconds = bench_time([&] {
+                for (u64 frame = 0; frame < frames; frame++) {
+                    sched.run_frame();
+                }
+            });
+            bench_report("rewind", name + (recording ? " (recording)" : " (no recording)"),
+                         frames, seconds);
+            if (recording) {
+                printf("%-10s %-32s %.0f ns per recorded frame\n", "", "",
+                       (seconds - base) * 1e9 / frames);
+            }
+            base = seconds;
+        }
+
+        auto stats = history.stats();
+        double kept = static_cast<double>(stats.states) / TIMER_HZ;
+        printf("%-10s %-32s %.1f KB per second of history, %.0f s in %.0f MB, "
+               "%llu keyframes, %llu evicted\n",
+               "", "", stats.bytes / 1024.0 / kept,
+               stats.capacity / (stats.bytes / kept), stats.capacity / 1048576.0,
+               static_cast<unsigned long long>(stats.keyframes),
+               static_cast<unsigned long long>(stats.evicted));
+
+        chip8 vm;
+        save_state state;
+        usize steps = history.size();
+        double seconds = bench_time([&] {
+            for (usize age = 0; age < steps; age++) {
+                history.get(age, state);
+                vm.restore(state);
+            }
+        });
+        bench_report("rewind", name + " (scrub back)", steps, seconds);
+        printf("%-10s %-32s %.0f ns per frame back\n", "", "", seconds * 1e9 / steps);
+
+        seconds = bench_time([&] {
+            for (usize n = 0; n < steps; n++) {
+                history.get((n * 7919) % steps, state);
+                vm.restore(state);
+            }
+        });
+        bench_report("rewind", name + " (random seek)", steps, seconds);
+        printf("%-10s %-32s %.0f ns per seek\n", "", "", seconds * 1e9 / steps);
+    }
+}
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#include "bench.hpp"
+#include "chip8.hpp"
+
+#define SAVESTATE_IPF 10 // instructions per frame, same default as chip8-run
+#define SAVESTATE_FILE_OPS 1000
+
+/// Latency of save states: snapshot() and restore() once per frame of a running ROM, as a
+/// rewind buffer or netplay rollback would, and the file round trip of save/load
+BENCH_SUITE(savestate) {
+    u64 frames = std::max<u64>(args.cycles / SAVESTATE_IPF, 1);
+    auto path = (std::filesystem::temp_directory_path() / "chip8_bench.state").string();
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        chip8 vm;
+        vm.set_engine(engine::cached);
+        vm.set_seed(0);
+        vm.load_rom(rom);
+
+        static save_state states[2];
+        double seconds = bench_time([&] {
+            for (u64 frame = 0; frame < frames; frame++) {
+                vm.step(SAVESTATE_IPF);
+                vm.snapshot(states[frame & 1]);
+            }
+        });
+        bench_report("savestate", name + " (step + snapshot)", frames, seconds);
+        printf("%-10s %-32s %.0f ns per frame\n", "", "", seconds * 1e9 / frames);
+
+        // restoring the state just taken rewrites nothing, alternating two frames apart
+        // rewrites whatever the ROM changed in between and invalidates those blocks
+        for (int alternate = 0; alternate < 2; alternate++) {
+            seconds = bench_time([&] {
+                for (u64 n = 0; n < frames; n++) {
+                    vm.restore(states[alternate ? n & 1 : 0]);
+                }
+            });
+            bench_report("savestate", name + (alternate ? " (restore, alternating)"
+                                                        : " (restore, same)"),
+                         frames, seconds);
+            printf("%-10s %-32s %.0f ns per restore\n", "", "", seconds * 1e9 / frames);
+        }
+
+        seconds = bench_time([&] {
+            for (u64 n = 0; n < SAVESTATE_FILE_OPS; n++) {
+                vm.save_state_to(path);
+            }
+        });
+        bench_report("savestate", name + " (file save)", SAVESTATE_FILE_OPS, seconds);
+
+        seconds = bench_time([&] {
+            for (u64 n = 0; n < SAVESTATE_FILE_OPS; n++) {
+                vm.load_state_from(path);
+            }
+        });
+        bench_report("savestate", name + " (file load)", SAVESTATE_FILE_OPS, seconds);
+    }
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+#include "bench.hpp"
+#include "vm_pool.hpp"
+
+#define SCALING_INSTANCES 256
+#define SCALING_IPF 1000 // instructions per frame of every instance
+
+/// Aggregate throughput of SCALING_INSTANCES instances (every ROM, round robin) on 1 to N
+/// worker threads, N being the hardware thread count, with a timer tick every
+/// SCALING_IPF instructions
+BENCH_SUITE(scaling) {
+    auto roms = bench_roms(args);
+    if (roms.empty()) {
+        return;
+    }
+
+    usize hw = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<usize> counts;
+    for (usize threads = 1; threads < hw; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(hw);
+
+    // args.cycles is the per ROM budget of the other suites, spread it over the instances
+    u64 cycles = std::max<u64>(args.cycles * roms.size() / SCALING_INSTANCES, POOL_SLICE);
+    for (usize threads : counts) {
+        vm_pool pool(threads);
+        pool.set_instructions_per_frame(SCALING_IPF);
+        for (usize idx = 0; idx < SCALING_INSTANCES; idx++) {
+            pool.add().load_rom(roms[idx % roms.size()]);
+        }
+
+        double seconds = bench_time([&] { pool.run(cycles); });
+        auto stats = pool.stats();
+        bench_report("scaling", std::to_string(threads) + " threads", cycles * pool.size(),
+                     seconds);
+        printf("%-10s %-32s %llu slices, %llu steals\n", "", "",
+               static_cast<unsigned long long>(stats.slices),
+               static_cast<unsigned long long>(stats.steals));
+    }
+}
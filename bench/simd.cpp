@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#include "bench.hpp"
+#include "simd_batch.hpp"
+
+#define SIMD_BENCH_IPF 1000 // instructions per frame, a fast clock so frames aren't all overhead
+
+/// Returns true if the whole architectural state of a matches b's
+static bool same_state(const chip8& a, const chip8& b) {
+    return a.get_memory() == b.get_memory() && a.get_v() == b.get_v() &&
+           a.get_i() == b.get_i() && a.get_pc() == b.get_pc() && a.get_sp() == b.get_sp() &&
+           a.get_stack() == b.get_stack() && a.get_delay_timer() == b.get_delay_timer() &&
+           a.get_sound_timer() == b.get_sound_timer() &&
+           a.get_framebuffer() == b.get_framebuffer();
+}
+
+/// A full batch of every ROM against as many interpreters, every lane seeded like its
+/// interpreter, run frame by frame with a timer tick after each, then compared lane by lane
+/// Odd lanes hold a key down, so lanes of key driven ROMs diverge and converge again
+BENCH_SUITE(simd) {
+    u64 frames = std::max<u64>(args.cycles / SIMD_LANES / SIMD_BENCH_IPF, 1);
+    u64 cycles = frames * SIMD_BENCH_IPF;
+    printf("%-10s %s lanes\n", "simd", simd_batch::vectorized() ? "avx2" : "scalar");
+
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        std::vector<std::unique_ptr<chip8>> reference;
+        simd_batch batch;
+        for (usize l = 0; l < batch.size(); l++) {
+            reference.push_back(std::make_unique<chip8>());
+            for (chip8* vm : {reference.back().get(), &batch[l]}) {
+                vm->load_rom(rom);
+                vm->set_seed(l);
+                vm->set_key(static_cast<u8>(l / 2), l % 2);
+            }
+        }
+
+        double seconds = bench_time([&] {
+            for (u64 frame = 0; frame < frames; frame++) {
+                for (auto& vm : reference) {
+                    vm->step(SIMD_BENCH_IPF);
+                    vm->tick_timers();
+                }
+            }
+        });
+        bench_report("simd", name + " (interpreters)", cycles * batch.size(), seconds);
+
+        seconds = bench_time([&] {
+            for (u64 frame = 0; frame < frames; frame++) {
+                batch.step(SIMD_BENCH_IPF);
+                batch.tick_timers();
+            }
+        });
+        bench_report("simd", name + " (batch)", cycles * batch.size(), seconds);
+
+        const auto& stats = batch.stats();
+        printf("%-10s %-32s %llu groups, %llu vector, %llu scalar lane instructions\n", "", "",
+               static_cast<unsigned long long>(stats.groups),
+               static_cast<unsigned long long>(stats.vector_insns),
+               static_cast<unsigned long long>(stats.scalar_insns));
+
+        for (usize l = 0; l < batch.size(); l++) {
+            if (!same_state(batch[l], *reference[l])) {
+                throw std::runtime_error(name + ": simd lane " + std::to_string(l) +
+                                         " diverged from the interpreter");
+            }
+        }
+    }
+}
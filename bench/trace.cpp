@@ -0,0 +1,31 @@
+#include <filesystem>
+#include <stdexcept>
+
+#include "bench.hpp"
+#include "probe.hpp"
+
+#ifdef CHIP8_TRACE
+/// Interpreter throughput with and without the instruction trace ring, only in builds
+/// configured with CHIP8_TRACE; the traced run must end in the same state
+BENCH_SUITE(trace) {
+    for (const auto& rom : bench_roms(args)) {
+        auto name = std::filesystem::path(rom).filename().string();
+
+        probe_chip8 plain, traced;
+        for (probe_chip8* vm : {&plain, &traced}) {
+            vm->set_seed(0);
+            vm->load_rom(rom);
+        }
+        traced.set_trace(TRACE_DEFAULT_CAPACITY);
+
+        double seconds = bench_time([&] { plain.step(args.cycles); });
+        bench_report("trace", name + " (off)", args.cycles, seconds);
+        seconds = bench_time([&] { traced.step(args.cycles); });
+        bench_report("trace", name + " (recording)", args.cycles, seconds);
+
+        if (!traced.same_state(plain) || traced.get_trace()->count() != args.cycles) {
+            throw std::runtime_error(name + ": tracing changed the result");
+        }
+    }
+}
+#endif
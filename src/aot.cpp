@@ -0,0 +1,507 @@
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <set>
+
+#include "aot.hpp"
+#include "utils.hpp"
+
+namespace {
+
+/// Appends one printf formatted line of generated code
+void line(std::string& out, const char* fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    out += buf;
+    out += '\n';
+}
+
+/// Generates the code of one basic block
+class block_writer {
+  private:
+    std::string& _out;
+    const std::set<u16>& _starts;
+    const basic_block& _block;
+    u8 _quirks;
+
+    /// Counts the instruction that ends the block and everything before it
+    void finish(u32 executed) {
+        line(_out, "    done += %u;", executed);
+    }
+
+    /// Continues at a known address, directly if a recompiled block starts there
+    void exit_static(u16 target, const char* indent = "    ") {
+        line(_out, "%spc = 0x%03X;", indent, target);
+        if (_starts.count(target)) {
+            line(_out, "%sif (links[0x%03X]) {", indent, target);
+            line(_out, "%s    goto b_%03X;", indent, target);
+            line(_out, "%s}", indent);
+        }
+        line(_out, "%sgoto leave;", indent);
+    }
+
+    /// Runs the regular handler, with the cached registers written back around it
+    void fallback(u16 opcode, u16 next, bool uses_registers) {
+        if (uses_registers) {
+            line(_out, "    save();");
+        }
+        line(_out, "    aot::call(vm, 0x%04X, 0x%03X);", opcode, next);
+        if (uses_registers) {
+            line(_out, "    load();");
+        }
+    }
+
+    /// A store may have overwritten recompiled code, hand over to the block cache if so
+    void check_generation(u32 executed, u16 next) {
+        line(_out, "    if (generation != entered) {");
+        line(_out, "        done += %u;", executed);
+        line(_out, "        pc = 0x%03X;", next);
+        line(_out, "        goto leave;");
+        line(_out, "    }");
+    }
+
+    /// Ends the block with a skip: continue at next, or next + 2 if cond holds
+    /// A skipped F000 nnnn is two words, tested when taken since the block doesn't cover it
+    void skip(const char* cond, u32 executed, u16 next) {
+        finish(executed);
+        line(_out, "    if (%s) {", cond);
+        line(_out, "        if (memory[0x%03X] == 0xF0 && memory[0x%03X] == 0x00) {", next,
+             next + 1);
+        exit_static(next + 4, "            ");
+        line(_out, "        }");
+        exit_static(next + 2, "        ");
+        line(_out, "    }");
+        exit_static(next);
+    }
+
+  public:
+    block_writer(std::string& out, const std::set<u16>& starts, const basic_block& block,
+                 u8 quirks)
+        : _out(out), _starts(starts), _block(block), _quirks(quirks) {
+    }
+
+    /// Translates every instruction, returns after the block's exit code
+    void write() {
+        line(_out, "b_%03X: // 0x%03X - 0x%03X", _block._start, _block._start, _block._end);
+        line(_out, "    if (cycles - done < %u) {", _block._length);
+        line(_out, "        goto leave;");
+        line(_out, "    }");
+
+        for (u8 idx = 0; idx < _block._length; idx++) {
+            if (!instruction(idx)) {
+                return; // the block ended with a jump, call, skip...
+            }
+        }
+
+        line(_out, "    done += %u;", _block._length);
+        exit_static(_block._end);
+    }
+
+    /// Translates instruction idx, returns false if it left the block
+    bool instruction(u8 idx) {
+        u16 opcode = _block._insns[idx]._opcode;
+        u16 addr = _block._start + idx * 2;
+        u16 next = addr + 2;
+        u32 executed = idx + 1;
+        u8 x = get_x(opcode), y = get_y(opcode), kk = get_kk(opcode);
+        u16 nnn = get_nnn(opcode);
+        char cond[32];
+
+        line(_out, "    // %03X: %04X", addr, opcode);
+        switch (get_highest_nibble(opcode)) {
+        case 0x0:
+            if (opcode == 0x00EE) {
+                finish(executed);
+                line(_out, "    pc = stack[--aot::sp(vm)];");
+                line(_out, "    goto dispatch;");
+                return false;
+            } else if (opcode == 0x00FD) {
+                // exit, the handler keeps _pc on the instruction
+                fallback(opcode, next, false);
+                finish(executed);
+                line(_out, "    pc = aot::pc(vm);");
+                line(_out, "    goto dispatch;");
+                return false;
+            } else if (!chip8::is_sys(opcode)) {
+                fallback(opcode, next, false); // cls and the SUPER-CHIP display instructions
+            }
+            return true; // sys, ignored
+        case 0x1:
+            finish(executed);
+            exit_static(nnn);
+            return false;
+        case 0x2:
+            finish(executed);
+            line(_out, "    stack[aot::sp(vm)++] = 0x%03X;", next);
+            exit_static(nnn);
+            return false;
+        case 0x3:
+            snprintf(cond, sizeof(cond), "v%x == 0x%02X", x, kk);
+            skip(cond, executed, next);
+            return false;
+        case 0x4:
+            snprintf(cond, sizeof(cond), "v%x != 0x%02X", x, kk);
+            skip(cond, executed, next);
+            return false;
+        case 0x5:
+            if ((opcode & 0xF) == 0x2) {
+                fallback(opcode, next, true); // XO-CHIP register range store
+                check_generation(executed, next);
+                return true;
+            } else if ((opcode & 0xF) == 0x3) {
+                fallback(opcode, next, true);
+                return true;
+            }
+            snprintf(cond, sizeof(cond), "v%x == v%x", x, y);
+            skip(cond, executed, next);
+            return false;
+        case 0x6:
+            line(_out, "    v%x = 0x%02X;", x, kk);
+            return true;
+        case 0x7:
+            line(_out, "    v%x += 0x%02X;", x, kk);
+            return true;
+        case 0x8:
+            alu(opcode, x, y);
+            return true;
+        case 0x9:
+            snprintf(cond, sizeof(cond), "v%x != v%x", x, y);
+            skip(cond, executed, next);
+            return false;
+        case 0xA:
+            line(_out, "    i = 0x%03X;", nnn);
+            return true;
+        case 0xB:
+            // computed jump, only followed if it lands on a recompiled block
+            finish(executed);
+            if (_quirks & QUIRK_JUMP_VX) {
+                line(_out, "    pc = 0x%03X + v%x;", nnn, x);
+            } else {
+                line(_out, "    pc = 0x%03X + v0;", nnn);
+            }
+            line(_out, "    goto dispatch;");
+            return false;
+        case 0xC:
+            line(_out, "    v%x = aot::random(vm) & 0x%02X;", x, kk);
+            return true;
+        case 0xD:
+            fallback(opcode, next, true);
+            return true;
+        case 0xE:
+            snprintf(cond, sizeof(cond), "%skeypad[v%x & 0xF]", kk == 0x9E ? "" : "!", x);
+            skip(cond, executed, next);
+            return false;
+        case 0xF:
+        default:
+            return misc(opcode, x, executed, next);
+        }
+    }
+
+    /// 8xyN
+    void alu(u16 opcode, u8 x, u8 y) {
+        u8 n = get_lowest_nibble(opcode);
+        if ((_quirks & QUIRK_SHIFT_VY) && (n == 0x6 || n == 0xE)) {
+            line(_out, "    v%x = v%x;", x, y);
+        }
+        switch (n) {
+        case 0x0:
+            line(_out, "    v%x = v%x;", x, y);
+            break;
+        case 0x1:
+            line(_out, "    v%x |= v%x;", x, y);
+            vf_reset();
+            break;
+        case 0x2:
+            line(_out, "    v%x &= v%x;", x, y);
+            vf_reset();
+            break;
+        case 0x3:
+            line(_out, "    v%x ^= v%x;", x, y);
+            vf_reset();
+            break;
+        case 0x4:
+            line(_out, "    sum = v%x + v%x;", x, y);
+            line(_out, "    vf = sum > 0xFF ? 1 : 0;");
+            line(_out, "    v%x = sum & 0xFF;", x);
+            break;
+        case 0x5:
+            line(_out, "    vf = v%x < v%x ? 1 : 0;", x, y);
+            line(_out, "    v%x -= v%x;", x, y);
+            break;
+        case 0x6:
+            line(_out, "    vf = v%x & 1;", x);
+            line(_out, "    v%x >>= 1;", x);
+            break;
+        case 0x7:
+            line(_out, "    vf = v%x > v%x ? 1 : 0;", y, x);
+            line(_out, "    v%x = v%x - v%x;", x, y, x);
+            break;
+        case 0xE:
+        default:
+            line(_out, "    vf = v%x >> 7;", x);
+            line(_out, "    v%x <<= 1;", x);
+            break;
+        }
+    }
+
+    /// or/and/xor clear VF with QUIRK_VF_RESET
+    void vf_reset() {
+        if (_quirks & QUIRK_VF_RESET) {
+            line(_out, "    vf = 0;");
+        }
+    }
+
+    /// str_r/read_r move I past the last register with QUIRK_MEMORY_I
+    void memory_i(u8 x) {
+        if (_quirks & QUIRK_MEMORY_I) {
+            line(_out, "    i += 0x%X;", x + 1);
+        }
+    }
+
+    /// FxNN
+    bool misc(u16 opcode, u8 x, u32 executed, u16 next) {
+        switch (get_kk(opcode)) {
+        case 0x00:
+            // F000 nnnn, the handler reads nnnn at run time and moves _pc past it
+            fallback(opcode, next, true);
+            finish(executed);
+            line(_out, "    pc = aot::pc(vm);");
+            line(_out, "    goto dispatch;");
+            return false;
+        case 0x01:
+            fallback(opcode, next, false); // plane
+            return true;
+        case 0x02:
+        case 0x3A:
+            fallback(opcode, next, true); // audio pattern, pitch
+            return true;
+        case 0x07:
+            line(_out, "    v%x = dt;", x);
+            return true;
+        case 0x0A:
+            // key wait, the handler rewinds _pc while no key is down
+            fallback(opcode, next, true);
+            finish(executed);
+            line(_out, "    pc = aot::pc(vm);");
+            line(_out, "    goto dispatch;");
+            return false;
+        case 0x15:
+            line(_out, "    dt = v%x;", x);
+            return true;
+        case 0x18:
+            line(_out, "    st = v%x;", x);
+            return true;
+        case 0x1E:
+            line(_out, "    i += v%x;", x);
+            return true;
+        case 0x29:
+            line(_out, "    i = v%x * 5;", x);
+            return true;
+        case 0x30:
+            line(_out, "    i = 0x%02X + (v%x & 0xF) * 10;", BIG_FONT_ADDR, x);
+            return true;
+        case 0x75:
+        case 0x85:
+            fallback(opcode, next, true); // RPL flags live in the chip8
+            return true;
+        case 0x33:
+            line(_out, "    vm.write_memory(i, v%x / 100);", x);
+            line(_out, "    vm.write_memory(i + 1, v%x / 10 %% 10);", x);
+            line(_out, "    vm.write_memory(i + 2, v%x %% 10);", x);
+            check_generation(executed, next);
+            return true;
+        case 0x55:
+            for (u8 reg = 0; reg <= x; reg++) {
+                line(_out, "    vm.write_memory(i + %u, v%x);", reg, reg);
+            }
+            memory_i(x);
+            check_generation(executed, next);
+            return true;
+        case 0x65:
+        default:
+            for (u8 reg = 0; reg <= x; reg++) {
+                line(_out, "    v%x = memory[u16(i + %u)];", reg, reg);
+            }
+            memory_i(x);
+            return true;
+        }
+    }
+};
+
+} // namespace
+
+native_block aot_program::lookup(const u8* memory, u16 start, u16 end) const {
+    auto last = _blocks + _count;
+    auto it = std::lower_bound(_blocks, last, start,
+                               [](const aot_block& b, u16 pc) { return b._start < pc; });
+    if (it == last || it->_start != start || it->_end != end) {
+        return nullptr;
+    }
+
+    for (usize addr = start; addr < end; addr++) {
+        u8 expected = addr < _image_size ? _image[addr] : 0;
+        if (memory[addr] != expected) {
+            return nullptr;
+        }
+    }
+    return _run;
+}
+
+std::string aot::translate(const std::vector<u8>& rom, const std::string& name,
+                           const std::string& symbol, u8 quirks) {
+    chip8 vm;
+    vm.set_quirks(quirks);
+    vm.load_rom(rom);
+
+    // control flow recovery: decode every block reachable from START_ADDR, following both
+    // sides of skips and the return address of calls
+    std::map<u16, std::unique_ptr<basic_block>> blocks;
+    std::vector<u16> pending{START_ADDR};
+    while (!pending.empty()) {
+        u16 pc = pending.back();
+        pending.pop_back();
+        if (pc + 1 >= MEMORY_SIZE || blocks.count(pc)) {
+            continue;
+        }
+        auto block = vm.decode_block(pc);
+        if (!block) {
+            continue;
+        }
+
+        const auto& last = block->_insns[block->_length - 1];
+        u16 nnn = get_nnn(last._opcode);
+        if (!(last._flags & OP_ENDS_BLOCK)) {
+            pending.push_back(block->_end);
+        } else {
+            switch (get_highest_nibble(last._opcode)) {
+            case 0x1:
+                pending.push_back(nnn);
+                break;
+            case 0x2:
+                pending.push_back(nnn);
+                pending.push_back(block->_end);
+                break;
+            case 0x3:
+            case 0x4:
+            case 0x5:
+            case 0x9:
+            case 0xE:
+                pending.push_back(block->_end);
+                pending.push_back(block->_end + 2);
+                if (vm.fetch(block->_end) == LONG_I_OPCODE) {
+                    pending.push_back(block->_end + 4);
+                }
+                break;
+            case 0xF: // key wait, F000 nnnn
+                pending.push_back(block->_end + (last._opcode == LONG_I_OPCODE ? 2 : 0));
+                break;
+            default: // ret, computed jump
+                break;
+            }
+        }
+        blocks[pc] = std::move(block);
+    }
+
+    std::set<u16> starts;
+    for (const auto& [pc, block] : blocks) {
+        starts.insert(pc);
+    }
+
+    std::string out;
+    line(out, "// %s recompiled by chip8_aot, do not edit", name.c_str());
+    line(out, "#include \"aot.hpp\"");
+    line(out, "");
+    line(out, "namespace {");
+    line(out, "");
+    line(out, "u32 run(chip8& vm, u32 cycles) {");
+    line(out, "    u8* regs = aot::v(vm);");
+    line(out, "    u8 v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, va, vb, vc, vd, ve, vf;");
+    line(out, "    u16 i, sum;");
+    line(out, "    u16 pc = aot::pc(vm);");
+    line(out, "    u16* stack = aot::stack(vm);");
+    line(out, "    u8& dt = aot::delay_timer(vm);");
+    line(out, "    u8& st = aot::sound_timer(vm);");
+    line(out, "    (void)dt, (void)st; // unused by ROMs that never touch the timers");
+    line(out, "    const u8* memory = aot::memory(vm);");
+    line(out, "    const u8* keypad = aot::keypad(vm);");
+    line(out, "    const void* const* links = aot::links(vm);");
+    line(out, "    const u32& generation = aot::generation(vm);");
+    line(out, "    const u32 entered = generation;");
+    line(out, "    u32 done = 0;");
+    line(out, "");
+    line(out, "    auto load = [&] {");
+    line(out, "        v0 = regs[0x0], v1 = regs[0x1], v2 = regs[0x2], v3 = regs[0x3];");
+    line(out, "        v4 = regs[0x4], v5 = regs[0x5], v6 = regs[0x6], v7 = regs[0x7];");
+    line(out, "        v8 = regs[0x8], v9 = regs[0x9], va = regs[0xA], vb = regs[0xB];");
+    line(out, "        vc = regs[0xC], vd = regs[0xD], ve = regs[0xE], vf = regs[0xF];");
+    line(out, "        i = aot::i(vm);");
+    line(out, "    };");
+    line(out, "    auto save = [&] {");
+    line(out, "        regs[0x0] = v0, regs[0x1] = v1, regs[0x2] = v2, regs[0x3] = v3;");
+    line(out, "        regs[0x4] = v4, regs[0x5] = v5, regs[0x6] = v6, regs[0x7] = v7;");
+    line(out, "        regs[0x8] = v8, regs[0x9] = v9, regs[0xA] = va, regs[0xB] = vb;");
+    line(out, "        regs[0xC] = vc, regs[0xD] = vd, regs[0xE] = ve, regs[0xF] = vf;");
+    line(out, "        aot::i(vm) = i;");
+    line(out, "    };");
+    line(out, "    (void)stack, (void)memory, (void)keypad, (void)sum, (void)entered;");
+    line(out, "");
+    line(out, "    load();");
+    line(out, "    goto dispatch;");
+    line(out, "");
+
+    for (const auto& [pc, block] : blocks) {
+        block_writer(out, starts, *block, quirks).write();
+        line(out, "");
+    }
+
+    // blocks are only entered while the block cache holds them, i.e. still unmodified
+    line(out, "dispatch:");
+    line(out, "    if (!links[pc]) {");
+    line(out, "        goto leave;");
+    line(out, "    }");
+    line(out, "    switch (pc) {");
+    for (u16 pc : starts) {
+        line(out, "    case 0x%03X:", pc);
+        line(out, "        goto b_%03X;", pc);
+    }
+    line(out, "    default:");
+    line(out, "        goto leave;");
+    line(out, "    }");
+    line(out, "");
+    line(out, "leave:");
+    line(out, "    save();");
+    line(out, "    aot::pc(vm) = pc;");
+    line(out, "    return done;");
+    line(out, "}");
+    line(out, "");
+
+    // memory image, so blocks are only used while memory still matches it
+    usize image_size = START_ADDR + rom.size();
+    out += "const u8 image[] = {";
+    for (usize addr = 0; addr < image_size; addr++) {
+        out += addr % 16 ? " " : "\n   ";
+        char byte[8];
+        snprintf(byte, sizeof(byte), "0x%02X,", vm._memory[addr]);
+        out += byte;
+    }
+    line(out, "\n};");
+    line(out, "");
+    line(out, "const aot_block blocks[] = {");
+    for (const auto& [pc, block] : blocks) {
+        line(out, "    {0x%03X, 0x%03X},", block->_start, block->_end);
+    }
+    line(out, "    {0xFFFF, 0xFFFF}, // keeps the array non-empty, no block starts there");
+    line(out, "};");
+    line(out, "");
+    line(out, "} // namespace");
+    line(out, "");
+    line(out, "extern const aot_program %s;", symbol.c_str());
+    line(out,
+         "const aot_program %s = {\"%s\", image, sizeof(image), blocks, %zu, run, 0x%02X};",
+         symbol.c_str(), name.c_str(), blocks.size(), quirks);
+    return out;
+}
@@ -0,0 +1,88 @@
+#ifndef AOT_HPP
+#define AOT_HPP
+
+#include <string>
+#include <vector>
+
+#include "block_cache.hpp"
+#include "chip8.hpp"
+#include "types.hpp"
+
+/// Address range of one recompiled basic block
+struct aot_block {
+    u16 _start;
+    u16 _end; // one past the last byte
+};
+
+/// ROM recompiled ahead of time by chip8_aot
+/// Linked into a runner and installed with chip8::set_aot_program()
+struct aot_program {
+    const char* _name;
+    const u8* _image; // memory the blocks were recompiled from (fonts, ROM), zero past the end
+    usize _image_size;
+    const aot_block* _blocks; // sorted by _start
+    usize _count;
+    native_block _run; // runs any of _blocks, entered at the instance's _pc
+    u8 _quirks;        // QUIRK_* bits compiled in, only used by instances with the same set
+
+    /// Returns _run if [start, end) is a recompiled block and memory still holds the bytes
+    /// it was recompiled from, nullptr otherwise (not reachable statically, self-modified)
+    native_block lookup(const u8* memory, u16 start, u16 end) const;
+};
+
+/// Ahead of time recompiler: ROM to a C++ translation unit
+/// Also gives the generated code access to chip8 internals
+class aot {
+  public:
+    /// Recovers the control flow of rom from START_ADDR and returns C++ source defining
+    /// `const aot_program <symbol>`, one label per basic block, for the QUIRK_* set quirks
+    static std::string translate(const std::vector<u8>& rom, const std::string& name,
+                                 const std::string& symbol, u8 quirks = 0);
+
+    // state accessors used by generated code
+    static u8* v(chip8& vm) {
+        return vm._v.data();
+    }
+    static u16& i(chip8& vm) {
+        return vm._i;
+    }
+    static u16& pc(chip8& vm) {
+        return vm._pc;
+    }
+    static u8& sp(chip8& vm) {
+        return vm._sp;
+    }
+    static u16* stack(chip8& vm) {
+        return vm._stack.data();
+    }
+    static u8& delay_timer(chip8& vm) {
+        return vm._delay_timer;
+    }
+    static u8& sound_timer(chip8& vm) {
+        return vm._sound_timer;
+    }
+    static const u8* memory(chip8& vm) {
+        return vm._memory.data();
+    }
+    static const u8* keypad(chip8& vm) {
+        return vm._keypad.data();
+    }
+    static u8 random(chip8& vm) {
+        return vm.random_byte();
+    }
+    static const u32& generation(chip8& vm) {
+        return vm._blocks.generation();
+    }
+    static const void* const* links(chip8& vm) {
+        return vm._blocks.links();
+    }
+
+    /// Runs the regular handler of opcode, as if it was fetched right before next_pc
+    static void call(chip8& vm, u16 opcode, u16 next_pc) {
+        vm._opcode = opcode;
+        vm._pc = next_pc;
+        vm._handlers[opcode](vm);
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "audio.hpp"
+
+#define WAV_HEADER_SIZE 44
+
+namespace {
+
+void put_le(std::vector<u8>& out, u64 val, usize bytes) {
+    for (usize byte = 0; byte < bytes; byte++, val >>= 8) {
+        out.push_back(val & 0xFF);
+    }
+}
+
+/// Pattern bits per sample for every pitch register value, in 1/65536 bits
+/// XO-CHIP plays the pattern at 4000 * 2^((pitch - 64) / 48) bits per second
+const std::array<u32, 256>& pitch_steps() {
+    static const auto steps = [] {
+        std::array<u32, 256> out{};
+        for (int pitch = 0; pitch < 256; pitch++) {
+            double rate = AUDIO_PATTERN_RATE * std::exp2((pitch - DEFAULT_PITCH) / 48.0);
+            out[pitch] = static_cast<u32>(std::lround(rate / AUDIO_SAMPLE_RATE * 65536));
+        }
+        return out;
+    }();
+    return steps;
+}
+
+/// RIFF header of a 16-bit mono PCM file holding `samples` samples
+std::vector<u8> wav_header(u64 samples) {
+    u64 data = samples * sizeof(s16);
+    std::vector<u8> out;
+    auto tag = [&](const char* name) {
+        for (usize c = 0; c < 4; c++) {
+            out.push_back(name[c]);
+        }
+    };
+    tag("RIFF");
+    put_le(out, WAV_HEADER_SIZE - 8 + data, 4);
+    tag("WAVE");
+    tag("fmt ");
+    put_le(out, 16, 4); // fmt chunk size
+    put_le(out, 1, 2);  // PCM
+    put_le(out, 1, 2);  // channels
+    put_le(out, AUDIO_SAMPLE_RATE, 4);
+    put_le(out, AUDIO_SAMPLE_RATE * sizeof(s16), 4); // bytes per second
+    put_le(out, sizeof(s16), 2);                     // bytes per sample frame
+    put_le(out, 16, 2);                              // bits per sample
+    tag("data");
+    put_le(out, data, 4);
+    return out;
+}
+
+} // namespace
+
+void synthesize(const chip8& vm, s16* out, usize n, u32& phase) {
+    if (!vm.get_sound_timer()) {
+        std::fill_n(out, n, 0);
+        phase = 0; // every beep starts at the first bit, so the same run sounds the same
+        return;
+    }
+
+    // 65536 bits of phase is a whole number of 128 bit patterns, so the u32 wraps cleanly
+    const auto& pattern = vm.get_audio_pattern();
+    u32 step = pitch_steps()[vm.get_pitch()];
+    for (usize s = 0; s < n; s++, phase += step) {
+        u32 bit = (phase >> 16) & (AUDIO_PATTERN_SIZE * 8 - 1);
+        bool high = (pattern[bit >> 3] >> (7 - (bit & 7))) & 1;
+        out[s] = high ? AUDIO_AMPLITUDE : -AUDIO_AMPLITUDE;
+    }
+}
+
+const std::array<s16, AUDIO_FRAME_SAMPLES>& audio_stream::render_frame(const chip8& vm) {
+    synthesize(vm, _frame.data(), _frame.size(), _phase);
+    usize pushed = _ring.push(_frame.data(), _frame.size());
+    _produced.fetch_add(_frame.size(), std::memory_order_relaxed);
+    if (pushed < _frame.size()) {
+        _overflows.fetch_add(_frame.size() - pushed, std::memory_order_relaxed);
+    }
+    return _frame;
+}
+
+void audio_stream::read(s16* out, usize n) {
+    usize queued = _ring.size();
+    _queued.store(queued, std::memory_order_relaxed);
+    if (queued > _max_queued.load(std::memory_order_relaxed)) {
+        _max_queued.store(queued, std::memory_order_relaxed);
+    }
+
+    // start over only once there is a margin again, instead of stuttering a frame at a time
+    if (!_playing && queued >= AUDIO_PREFILL) {
+        _playing = true;
+    }
+    usize got = 0;
+    if (_playing) {
+        got = _ring.pop(out, n);
+        if (got < n) {
+            _underruns.fetch_add(1, std::memory_order_relaxed);
+            _playing = false;
+        }
+    }
+    std::fill(out + got, out + n, 0);
+    _silence.fetch_add(n - got, std::memory_order_relaxed);
+}
+
+audio_stats audio_stream::stats() const {
+    return {_produced.load(std::memory_order_relaxed),
+            _overflows.load(std::memory_order_relaxed),
+            _underruns.load(std::memory_order_relaxed),
+            _silence.load(std::memory_order_relaxed),
+            _queued.load(std::memory_order_relaxed),
+            _max_queued.load(std::memory_order_relaxed)};
+}
+
+wav_sink::~wav_sink() {
+    close();
+}
+
+bool wav_sink::open(const std::string& filename) {
+    close();
+    _filename = filename;
+    _samples = 0;
+    _file.open(filename, std::ios_base::binary | std::ios_base::trunc);
+    auto header = wav_header(0); // sizes are patched by close()
+    _file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    if (!_file) {
+        fprintf(stderr, "[-] can't write audio %s \n", filename.c_str());
+        _file.close();
+        return false;
+    }
+    return true;
+}
+
+void wav_sink::write(const s16* samples, usize n) {
+    std::vector<u8> out;
+    out.reserve(n * sizeof(s16));
+    for (usize s = 0; s < n; s++) {
+        put_le(out, static_cast<u16>(samples[s]), 2);
+    }
+    _file.write(reinterpret_cast<const char*>(out.data()), out.size());
+    _samples += n;
+}
+
+usize wav_sink::drain(audio_stream& stream) {
+    std::array<s16, AUDIO_FRAME_SAMPLES> block;
+    usize total = 0;
+    for (usize got; (got = stream.pop(block.data(), block.size())) > 0; total += got) {
+        write(block.data(), got);
+    }
+    return total;
+}
+
+bool wav_sink::close() {
+    if (!_file.is_open()) {
+        return true;
+    }
+    auto header = wav_header(_samples);
+    _file.seekp(0);
+    _file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    bool ok = static_cast<bool>(_file);
+    _file.close();
+    if (!ok) {
+        fprintf(stderr, "[-] can't write audio %s \n", _filename.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,111 @@
+#ifndef AUDIO_HPP
+#define AUDIO_HPP
+
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <string>
+
+#include "chip8.hpp"
+#include "scheduler.hpp"
+#include "spsc_queue.hpp"
+#include "types.hpp"
+
+#define AUDIO_SAMPLE_RATE 44100                              // mono, 16-bit
+#define AUDIO_FRAME_SAMPLES (AUDIO_SAMPLE_RATE / TIMER_HZ)   // 735 per frame, no remainder
+#define AUDIO_RING_SIZE 8192                                 // samples, ~186 ms
+#define AUDIO_PREFILL (2 * AUDIO_FRAME_SAMPLES)              // queued before playback starts
+#define AUDIO_AMPLITUDE 6000                                 // of a pattern bit, 0 is silence
+#define AUDIO_PATTERN_RATE 4000                              // pattern bits/s at DEFAULT_PITCH
+
+static_assert(AUDIO_SAMPLE_RATE % TIMER_HZ == 0, "a frame must be a whole number of samples");
+
+/// Fills out with n samples of vm's sound: its audio pattern played at its pitch while the
+/// sound timer runs, silence otherwise. phase is the position in the pattern, in 1/65536
+/// bits, carried from one call to the next and restarted by every silence.
+void synthesize(const chip8& vm, s16* out, usize n, u32& phase);
+
+/// Counters of an audio_stream, readable from any thread
+struct audio_stats {
+    u64 produced;  // samples synthesized
+    u64 overflows; // samples dropped because the ring was full
+    u64 underruns; // read()s that ran dry while playing, each one rebuffers AUDIO_PREFILL
+    u64 silence;   // samples read() padded with silence, while rebuffering or dry
+    usize queued;  // samples waiting at the last read(), the latency the ring adds
+    usize max_queued;
+};
+
+/// Sound of a chip8, synthesized on the emulation thread and streamed to an output
+/// The scheduler renders one frame of samples after running each frame's instructions and
+/// pushes it into a lock-free ring, an output sink pulls from the ring on its own thread.
+/// Neither side ever waits: a full ring drops the newest samples, a dry one plays silence
+/// until AUDIO_PREFILL samples are queued again.
+class audio_stream {
+  private:
+    spsc_queue<s16, AUDIO_RING_SIZE> _ring;
+
+    // producer side
+    std::array<s16, AUDIO_FRAME_SAMPLES> _frame{};
+    u32 _phase{};
+    std::atomic<u64> _produced{};
+    std::atomic<u64> _overflows{};
+
+    // consumer side
+    bool _playing{};
+    std::atomic<u64> _underruns{};
+    std::atomic<u64> _silence{};
+    std::atomic<usize> _queued{};
+    std::atomic<usize> _max_queued{};
+
+  public:
+    /// Producer: synthesizes one frame of vm's sound and queues it, never waits
+    /// Returns the frame's samples, valid until the next call
+    const std::array<s16, AUDIO_FRAME_SAMPLES>& render_frame(const chip8& vm);
+
+    /// Consumer: fills out with n samples for a real-time output, padding with silence
+    /// while the ring runs dry or rebuffers
+    void read(s16* out, usize n);
+
+    /// Consumer: removes up to n queued samples into out, returns how many
+    /// For offline sinks, which drain the ring after every frame and never count underruns
+    usize pop(s16* out, usize n) {
+        return _ring.pop(out, n);
+    }
+
+    audio_stats stats() const;
+};
+
+/// Writes 16-bit mono PCM .wav files, so headless runs can record and compare their sound
+class wav_sink {
+  private:
+    std::ofstream _file;
+    std::string _filename;
+    u64 _samples{};
+
+  public:
+    wav_sink() = default;
+    ~wav_sink();
+
+    wav_sink(const wav_sink&) = delete;
+    wav_sink& operator=(const wav_sink&) = delete;
+
+    /// Creates filename, returns false and prints the error on failure
+    bool open(const std::string& filename);
+
+    /// Appends n samples
+    void write(const s16* samples, usize n);
+
+    /// Appends every sample queued in stream, call after each frame the stream renders
+    /// Returns how many were written
+    usize drain(audio_stream& stream);
+
+    /// Fills in the sizes the header left blank and closes the file, returns false and
+    /// prints the error if anything failed to write
+    bool close();
+
+    u64 samples() const {
+        return _samples;
+    }
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "audio_sfml.hpp"
+
+sfml_audio_sink::sfml_audio_sink(audio_stream& stream) : _stream(stream) {
+    initialize(1, AUDIO_SAMPLE_RATE);
+}
+
+sfml_audio_sink::~sfml_audio_sink() {
+    stop(); // before _stream and _chunk go, SFML's thread may be inside onGetData
+}
+
+bool sfml_audio_sink::onGetData(Chunk& data) {
+    _stream.read(_chunk.data(), _chunk.size());
+    data.samples = _chunk.data();
+    data.sampleCount = _chunk.size();
+    return true; // a live stream never ends, silence keeps it going while paused
+}
@@ -0,0 +1,36 @@
+#ifndef AUDIO_SFML_HPP
+#define AUDIO_SFML_HPP
+
+#include <array>
+
+#include <SFML/Audio.hpp>
+
+#include "audio.hpp"
+#include "types.hpp"
+
+#define AUDIO_SFML_CHUNK 1024 // samples per pull, ~23 ms
+
+/// Live output of an audio_stream through the sound card
+/// SFML pulls chunks on its own thread and every pull reads the stream's ring, so playing
+/// never blocks the emulation thread. A ring that runs dry plays silence until it refills.
+class sfml_audio_sink : public sf::SoundStream {
+  private:
+    audio_stream& _stream;
+    std::array<s16, AUDIO_SFML_CHUNK> _chunk{};
+
+    bool onGetData(Chunk& data) override;
+    void onSeek(sf::Time) override {
+    }
+
+  public:
+    explicit sfml_audio_sink(audio_stream& stream);
+    ~sfml_audio_sink();
+
+    /// Returns the seconds of sound between the emulator and SFML, the ring's share of the
+    /// output latency (SFML buffers a few more chunks itself)
+    double latency() const {
+        return static_cast<double>(_stream.stats().queued) / AUDIO_SAMPLE_RATE;
+    }
+};
+
+#endif
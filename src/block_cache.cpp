@@ -0,0 +1,55 @@
+#include <algorithm>
+
+#include "block_cache.hpp"
+#include "chip8.hpp"
+
+basic_block* block_cache::insert(std::unique_ptr<basic_block> block) {
+    if (_blocks.empty()) {
+        _blocks.resize(MEMORY_SIZE);
+        _code.resize(MEMORY_SIZE);
+        _links.resize(MEMORY_SIZE);
+    }
+
+    std::fill(_code.begin() + block->_start, _code.begin() + block->_end, 1);
+    auto& slot = _blocks[block->_start];
+    slot = std::move(block);
+    return slot.get();
+}
+
+void block_cache::invalidate(u16 addr) {
+    // a block is at most MAX_BLOCK_BYTES long, so only blocks starting in this window
+    // can cover addr
+    usize first = addr >= MAX_BLOCK_BYTES ? addr - MAX_BLOCK_BYTES + 1 : 0;
+    usize lo = addr, hi = addr + 1;
+    for (usize start = first; start <= addr; start++) {
+        auto& block = _blocks[start];
+        if (block && block->_end > addr) {
+            lo = std::min<usize>(lo, block->_start);
+            hi = std::max<usize>(hi, block->_end);
+            _links[start] = nullptr;
+            block.reset();
+            _stats.invalidations++;
+        }
+    }
+    _generation++;
+
+    // rebuild the code map over the dropped range from the blocks that are left
+    std::fill(_code.begin() + lo, _code.begin() + hi, 0);
+    first = lo >= MAX_BLOCK_BYTES ? lo - MAX_BLOCK_BYTES + 1 : 0;
+    for (usize start = first; start < hi; start++) {
+        const auto& block = _blocks[start];
+        if (block && block->_end > lo) {
+            std::fill(_code.begin() + std::max<usize>(block->_start, lo),
+                      _code.begin() + std::min<usize>(block->_end, hi), 1);
+        }
+    }
+}
+
+void block_cache::clear() {
+    for (auto& block : _blocks) {
+        block.reset();
+    }
+    std::fill(_code.begin(), _code.end(), 0);
+    std::fill(_links.begin(), _links.end(), nullptr);
+    _generation++;
+}
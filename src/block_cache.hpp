@@ -0,0 +1,139 @@
+#ifndef BLOCK_CACHE_HPP
+#define BLOCK_CACHE_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "types.hpp"
+
+#define MAX_BLOCK_LENGTH 32
+#define MAX_BLOCK_BYTES (MAX_BLOCK_LENGTH * 2)
+
+class chip8;
+
+/// Native code for a block and the blocks it links to
+/// Runs at most `cycles` instructions, returns how many it executed
+using native_block = u32 (*)(chip8&, u32 cycles);
+
+/// What the cached engine does for an instruction, chip8::run_cached() switches on it
+/// Everything but fn and store runs inline from the operands decode_block() extracted
+enum class cached_op : u8 {
+    fn,    // call the interpreter's handler (quirks, drawing)
+    store, // call the interpreter's handler, then check for self-modifying code
+    ret,
+    jp,
+    call,
+    se_kk,
+    sne_kk,
+    se,
+    sne,
+    ld_kk,
+    add_kk,
+    ld,
+    add,
+    sub,
+    subn,
+    ld_i,
+    skp,
+    sknp,
+    ld_vx_dt,
+    ld_dt,
+    ld_st,
+    add_i,
+    ld_f,
+    ld_k,
+};
+
+/// One predecoded instruction of a basic block
+struct cached_insn {
+    u16 _opcode;
+    u8 _flags;
+    u8 _x;   // register operands
+    u8 _y;
+    u8 _kk;  // byte operand
+    u16 _nnn; // address operand
+    u16 _next; // address of the instruction after it
+    cached_op _op;
+    void (*_fn)(chip8&); // the interpreter's handler, reads _opcode
+};
+
+/// Straight-line run of instructions, ending at the first jump, call, skip or key wait
+struct basic_block {
+    u16 _start;
+    u16 _end; // one past the last byte
+    u8 _length;
+    u32 _runs;            // times the block was entered, used to find hot blocks
+    native_block _native; // compiled code, if any
+    basic_block* _next;   // the block that ran after it last time
+    u32 _next_generation; // block_cache::generation() when _next was set, stale if it changed
+    std::array<cached_insn, MAX_BLOCK_LENGTH> _insns;
+};
+
+/// Block cache hit/miss counters
+struct block_stats {
+    u64 hits;
+    u64 misses;
+    u64 invalidations;
+};
+
+/// Predecoded basic blocks, indexed by start address
+/// Every memory write is reported through on_write(), blocks decoded from the written byte
+/// are dropped right away
+class block_cache {
+  private:
+    std::vector<std::unique_ptr<basic_block>> _blocks;
+    std::vector<u8> _code; // 1 if a cached block was decoded from this byte
+    std::vector<const void*> _links; // native code linked blocks jump to, by start address
+    u32 _generation{};     // bumped every time blocks are dropped
+    block_stats _stats{};
+
+    /// Drops every block that covers addr
+    void invalidate(u16 addr);
+
+  public:
+    /// Returns the block starting at pc, or nullptr if it has to be decoded
+    basic_block* lookup(u16 pc) {
+        if (pc < _blocks.size() && _blocks[pc]) {
+            _stats.hits++;
+            return _blocks[pc].get();
+        }
+        _stats.misses++;
+        return nullptr;
+    }
+
+    /// Stores a freshly decoded block
+    basic_block* insert(std::unique_ptr<basic_block> block);
+
+    /// Must be called for every write to memory
+    void on_write(u16 addr) {
+        if (addr < _code.size() && _code[addr]) {
+            invalidate(addr);
+        }
+    }
+
+    /// Drops every block (ROM load, reset)
+    void clear();
+
+    /// Sets the code compiled blocks jump to when they continue at pc
+    void link(u16 pc, const void* code) {
+        _links[pc] = code;
+    }
+
+    /// Returns the link table, one entry per address, nullptr where nothing is compiled
+    /// The table never moves once the first block is inserted
+    const void* const* links() const {
+        return _links.data();
+    }
+
+    /// Changes whenever blocks are dropped, so a running block can tell it was overwritten
+    const u32& generation() const {
+        return _generation;
+    }
+
+    const block_stats& stats() const {
+        return _stats;
+    }
+};
+
+#endif
@@ -1,54 +1,136 @@
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <fstream>
 
+#include "aot.hpp"
 #include "chip8.hpp"
+#include "debugger.hpp"
+#include "profile.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
-chip8::chip8() {
-    std::srand((unsigned int)time(nullptr));
+// clang-format off
+template <class Q>
+constexpr std::array<chip8::opcode_member, MAX_INSTRUCTIONS> chip8::opcodes() {
+    return {{
+        {0x00E0, 0xFFFF, &exec<&chip8::cls>, OP_WRITES_OUTPUT},      // 0x00E0
+        {0x00EE, 0xFFFF, &exec<&chip8::ret>, OP_ENDS_BLOCK},         // 0x00EE
+        {0x00C0, 0xFFF0, &exec<&chip8::scd>, OP_WRITES_OUTPUT},      // 0x00CN
+        {0x00FB, 0xFFFF, &exec<&chip8::scr>, OP_WRITES_OUTPUT},      // 0x00FB
+        {0x00FC, 0xFFFF, &exec<&chip8::scl>, OP_WRITES_OUTPUT},      // 0x00FC
+        {0x00FD, 0xFFFF, &exec<&chip8::halt>, OP_ENDS_BLOCK},        // 0x00FD
+        {0x00FE, 0xFFFF, &exec<&chip8::low>, OP_WRITES_OUTPUT},      // 0x00FE
+        {0x00FF, 0xFFFF, &exec<&chip8::high>, OP_WRITES_OUTPUT},     // 0x00FF
+        {0x00D0, 0xFFF0, &exec<&chip8::scu>, OP_WRITES_OUTPUT},      // 0x00DN
+        {0x0000, 0xF000, &exec<&chip8::sys>, 0},                     // 0x0NNN
+        {0x1000, 0xF000, &exec<&chip8::jp>, OP_ENDS_BLOCK},          // 0x1NNN
+        {0x2000, 0xF000, &exec<&chip8::call>, OP_ENDS_BLOCK},        // 0x2NNN
+        {0x3000, 0xF000, &exec<&chip8::seq_kk>, OP_ENDS_BLOCK},      // 0x3XNN
+        {0x4000, 0xF000, &exec<&chip8::sne_kk>, OP_ENDS_BLOCK},      // 0x4XNN
+        {0x5000, 0xF00F, &exec<&chip8::seq>, OP_ENDS_BLOCK},         // 0x5XY0
+        {0x6000, 0xF000, &exec<&chip8::ld_kk>, 0},                   // 0x6XNN
+        {0x7000, 0xF000, &exec<&chip8::add_kk>, 0},                  // 0x7XNN
+        {0x8000, 0xF00F, &exec<&chip8::ld>, 0},                      // 0x8XY0
+        {0x8001, 0xF00F, &exec<&chip8::logic_or<Q>>, 0},             // 0x8XY1
+        {0x8002, 0xF00F, &exec<&chip8::logic_and<Q>>, 0},            // 0x8XY2
+        {0x8003, 0xF00F, &exec<&chip8::logic_xor<Q>>, 0},            // 0x8XY3
+        {0x8004, 0xF00F, &exec<&chip8::add>, 0},                     // 0x8XY4
+        {0x8005, 0xF00F, &exec<&chip8::sub>, 0},                     // 0x8XY5
+        {0x8006, 0xF00F, &exec<&chip8::shr<Q>>, 0},                  // 0x8XY6
+        {0x8007, 0xF00F, &exec<&chip8::subn>, 0},                    // 0x8XY7
+        {0x800E, 0xF00F, &exec<&chip8::shl<Q>>, 0},                  // 0x8XYE
+        {0x9000, 0xF00F, &exec<&chip8::sne>, OP_ENDS_BLOCK},         // 0x9XY0
+        {0xA000, 0xF000, &exec<&chip8::ld_i>, 0},                    // 0xANNN
+        {0xB000, 0xF000, &exec<&chip8::jpo<Q>>, OP_ENDS_BLOCK},      // 0xBNNN
+        {0xC000, 0xF000, &exec<&chip8::rnd>, 0},                     // 0xCXNN
+        {0xD000, 0xF000, &exec<&chip8::drw<Q>>, OP_WRITES_OUTPUT},   // 0xDXYN
+        {0xE09E, 0xF0FF, &exec<&chip8::skp>, OP_ENDS_BLOCK},         // 0xEX9E
+        {0xE0A1, 0xF0FF, &exec<&chip8::sknp>, OP_ENDS_BLOCK},        // 0xEXA1
+        {0xF007, 0xF0FF, &exec<&chip8::ld_vx_dt>, 0},                // 0xFX07
+        {0xF00A, 0xF0FF, &exec<&chip8::ld_k>, OP_ENDS_BLOCK},        // 0xFX0A
+        {0xF015, 0xF0FF, &exec<&chip8::ld_dt>, 0},                   // 0xFX15
+        {0xF018, 0xF0FF, &exec<&chip8::ld_st>, 0},                   // 0xFX18
+        {0xF01E, 0xF0FF, &exec<&chip8::add_i>, 0},                   // 0xFX1E
+        {0xF029, 0xF0FF, &exec<&chip8::ld_f>, 0},                    // 0xFX29
+        {0xF033, 0xF0FF, &exec<&chip8::str_b>, OP_WRITES_MEMORY},    // 0xFX33
+        {0xF055, 0xF0FF, &exec<&chip8::str_r<Q>>, OP_WRITES_MEMORY}, // 0xFX55
+        {0xF065, 0xF0FF, &exec<&chip8::read_r<Q>>, 0},               // 0xFX65
+        {0xF030, 0xF0FF, &exec<&chip8::ld_hf>, 0},                   // 0xFX30
+        {0xF075, 0xF0FF, &exec<&chip8::str_rpl>, OP_WRITES_OUTPUT},  // 0xFX75
+        {0xF085, 0xF0FF, &exec<&chip8::read_rpl>, 0},                // 0xFX85
+        {0x5002, 0xF00F, &exec<&chip8::str_xy>, OP_WRITES_MEMORY},   // 0x5XY2
+        {0x5003, 0xF00F, &exec<&chip8::read_xy>, 0},                 // 0x5XY3
+        {0xF000, 0xFFFF, &exec<&chip8::ld_il>, OP_ENDS_BLOCK},       // 0xF000
+        {0xF001, 0xF0FF, &exec<&chip8::plane>, 0},                   // 0xFN01
+        {0xF002, 0xFFFF, &exec<&chip8::ld_audio>, OP_WRITES_OUTPUT}, // 0xF002
+        {0xF03A, 0xF0FF, &exec<&chip8::ld_pitch>, 0}}};              // 0xFX3A
+}
+// clang-format on
+
+const std::array<chip8::opcode_member, MAX_INSTRUCTIONS> chip8::opcode_table =
+    opcodes<quirk_policy<0>>();
+
+const std::array<u8, DECODE_TABLE_SIZE> chip8::decode_table = [] {
+    std::array<u8, DECODE_TABLE_SIZE> table{};
+    for (usize opcode = 0; opcode < DECODE_TABLE_SIZE; opcode++) {
+        table[opcode] = INVALID_INSTRUCTION;
+        // first match wins, same priority as the table order (00E0/00EE before 0NNN)
+        for (usize idx = 0; idx < opcode_table.size(); idx++) {
+            if (opcode_table[idx]._opcode == (opcode & opcode_table[idx]._mask)) {
+                table[opcode] = static_cast<u8>(idx);
+                break;
+            }
+        }
+    }
+    return table;
+}();
+
+template <u8 Q> const chip8::handler* chip8::handlers() {
+    static const auto table = [] {
+        constexpr auto ops = opcodes<quirk_policy<Q>>();
+        std::array<handler, DECODE_TABLE_SIZE> table{};
+        for (usize opcode = 0; opcode < DECODE_TABLE_SIZE; opcode++) {
+            u8 idx = decode_table[opcode];
+            table[opcode] = idx == INVALID_INSTRUCTION ? &exec<&chip8::invalid> : ops[idx]._fn;
+        }
+        return table;
+    }();
+    return table.data();
+}
+
+bool parse_engine(const std::string& name, engine& e) {
+    for (auto candidate : {engine::interpreter, engine::cached, engine::jit, engine::aot}) {
+        if (name == engine_name(candidate)) {
+            e = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* engine_name(engine e) {
+    switch (e) {
+    case engine::cached:
+        return "cached";
+    case engine::jit:
+        return "jit";
+    case engine::aot:
+        return "aot";
+    case engine::interpreter:
+    default:
+        return "interpreter";
+    }
+}
+
+chip8::chip8() : _handlers(handlers<0>()) {
+    set_seed(static_cast<u64>(time(nullptr)));
 
     load_fonts();
     _pc = START_ADDR;
-
-    // clang-format off
-    opcode_table = {{
-        {0x00E0, 0xFFFF, &chip8::cls},       // 0x00E0
-        {0x00EE, 0xFFFF, &chip8::ret},       // 0x00EE
-        {0x0000, 0xF000, &chip8::sys},       // 0x0NNN
-        {0x1000, 0xF000, &chip8::jp},        // 0x1NNN
-        {0x2000, 0xF000, &chip8::call},      // 0x2NNN
-        {0x3000, 0xF000, &chip8::seq_kk},    // 0x3XNN
-        {0x4000, 0xF000, &chip8::sne_kk},    // 0x4XNN
-        {0x5000, 0xF00F, &chip8::seq},       // 0x5XY0
-        {0x6000, 0xF000, &chip8::ld_kk},     // 0x6XNN
-        {0x7000, 0xF000, &chip8::add_kk},    // 0x7XNN
-        {0x8000, 0xF00F, &chip8::ld},        // 0x8XY0
-        {0x8001, 0xF00F, &chip8::logic_or},  // 0x8XY1
-        {0x8002, 0xF00F, &chip8::logic_and}, // 0x8XY2
-        {0x8003, 0xF00F, &chip8::logic_xor}, // 0x8XY3
-        {0x8004, 0xF00F, &chip8::add},       // 0x8XY4
-        {0x8005, 0xF00F, &chip8::sub},       // 0x8XY5
-        {0x8006, 0xF00F, &chip8::shr},       // 0x8XY6
-        {0x8007, 0xF00F, &chip8::subn},      // 0x8XY7
-        {0x800E, 0xF00F, &chip8::shl},       // 0x8XYE
-        {0x9000, 0xF00F, &chip8::sne},       // 0x9XY0
-        {0xA000, 0xF000, &chip8::ld_i},      // 0xANNN
-        {0xB000, 0xF000, &chip8::jpo},       // 0xBNNN
-        {0xC000, 0xF000, &chip8::rnd},       // 0xCXNN
-        {0xD000, 0xF000, &chip8::drw},       // 0xDXYN
-        {0xE09E, 0xF0FF, &chip8::skp},       // 0xEX9E
-        {0xE0A1, 0xF0FF, &chip8::sknp},      // 0xEXA1
-        {0xF007, 0xF0FF, &chip8::ld_vx_dt},  // 0xFX07
-        {0xF00A, 0xF0FF, &chip8::ld_k},      // 0xFX0A
-        {0xF015, 0xF0FF, &chip8::ld_dt},     // 0xFX15
-        {0xF018, 0xF0FF, &chip8::ld_st},     // 0xFX18
-        {0xF01E, 0xF0FF, &chip8::add_i},     // 0xFX1E
-        {0xF029, 0xF0FF, &chip8::ld_f},      // 0xFX29
-        {0xF033, 0xF0FF, &chip8::str_b},     // 0xFX33
-        {0xF055, 0xF0FF, &chip8::str_r},     // 0xFX55
-        {0xF065, 0xF0FF, &chip8::read_r}}};  // 0xFX65
-    // clang-format on
 }
 
 chip8::~chip8() {
@@ -56,16 +138,22 @@ chip8::~chip8() {
 
 void chip8::reset_chip8() {
     _memory.fill(0);
+    load_fonts(); // the interpreter area holds the fonts, Fx29/Fx30 point into it
     _v.fill(0);
     _stack.fill(0);
     _keypad.fill(0);
-    _video.fill(0);
+    _video = framebuffer{};
+    _video_dirty = true;
+    _planes = 1;
+    _audio_pattern.fill(DEFAULT_AUDIO_PATTERN);
+    _pitch = DEFAULT_PITCH;
     _i = 0;
     _pc = START_ADDR;
     _sp = 0;
     _delay_timer = 0;
     _sound_timer = 0;
     _opcode = 0;
+    flush_blocks();
 }
 
 void chip8::load_fonts() {
@@ -88,11 +176,34 @@ void chip8::load_fonts() {
         0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
         0xF0, 0x80, 0xF0, 0x80, 0x80  // F
     };
+
+    // SUPER-CHIP digits, 8x10
+    std::array<u8, 160> big_fontset = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    };
     // clang-format on
 
     for (usize i = 0; i < fontset.size(); i++) {
         _memory[i] = fontset[i];
     }
+    for (usize i = 0; i < big_fontset.size(); i++) {
+        _memory[BIG_FONT_ADDR + i] = big_fontset[i];
+    }
 }
 
 void chip8::load_rom(const std::string& filename) {
@@ -118,30 +229,388 @@ void chip8::load_rom(const std::string& filename) {
 }
 
 void chip8::load_rom(const std::vector<u8>& raw_data) {
-    for (usize idx = START_ADDR; const auto& b : raw_data) {
-        _memory[idx] = b;
-        idx++;
+    usize size = std::min<usize>(raw_data.size(), MEMORY_SIZE - START_ADDR);
+    std::copy_n(raw_data.begin(), size, _memory.begin() + START_ADDR);
+    flush_blocks();
+}
+
+namespace {
+
+void put16(u8* out, u16 val) {
+    out[0] = val & 0xFF;
+    out[1] = val >> 8;
+}
+
+u16 get16(const u8* in) {
+    return in[0] | in[1] << 8;
+}
+
+static_assert(SAVE_STATE_OFF_I == SAVE_STATE_OFF_V + TOTAL_REGISTERS);
+static_assert(SAVE_STATE_OFF_KEYPAD == SAVE_STATE_OFF_STACK + STACK_SIZE * sizeof(u16));
+static_assert(SAVE_STATE_OFF_RNG == SAVE_STATE_OFF_KEYPAD + MAX_KEYS);
+static_assert(SAVE_STATE_OFF_RPL == SAVE_STATE_OFF_RNG + sizeof(u64));
+static_assert(SAVE_STATE_OFF_AUDIO == SAVE_STATE_OFF_RPL + RPL_REGISTERS);
+static_assert(SAVE_STATE_OFF_VIDEO == SAVE_STATE_OFF_AUDIO + AUDIO_PATTERN_SIZE);
+static_assert(SAVE_STATE_OFF_MEMORY == SAVE_STATE_OFF_VIDEO + sizeof(framebuffer::_rows));
+static_assert(SAVE_STATE_SIZE == SAVE_STATE_OFF_MEMORY + MEMORY_SIZE);
+
+} // namespace
+
+void chip8::snapshot(save_state& state) const {
+    u8* out = state.data();
+    std::memcpy(out + SAVE_STATE_OFF_MAGIC, SAVE_STATE_MAGIC, 4);
+    put16(out + SAVE_STATE_OFF_VERSION, SAVE_STATE_VERSION);
+    for (usize byte = 0; byte < 4; byte++) {
+        out[SAVE_STATE_OFF_SIZE + byte] = (SAVE_STATE_SIZE >> byte * 8) & 0xFF;
+    }
+    std::memcpy(out + SAVE_STATE_OFF_MEMORY, _memory.data(), MEMORY_SIZE);
+    std::memcpy(out + SAVE_STATE_OFF_V, _v.data(), TOTAL_REGISTERS);
+    put16(out + SAVE_STATE_OFF_I, _i);
+    put16(out + SAVE_STATE_OFF_PC, _pc);
+    out[SAVE_STATE_OFF_SP] = _sp;
+    out[SAVE_STATE_OFF_DT] = _delay_timer;
+    out[SAVE_STATE_OFF_ST] = _sound_timer;
+    out[SAVE_STATE_OFF_HIRES] = _video._hires;
+    out[SAVE_STATE_OFF_PLANES] = _planes;
+    out[SAVE_STATE_OFF_PITCH] = _pitch;
+    for (usize n = 0; n < STACK_SIZE; n++) {
+        put16(out + SAVE_STATE_OFF_STACK + n * 2, _stack[n]);
     }
+    for (usize word = 0; word < _video._rows.size(); word++) {
+        u64 bits = _video._rows[word];
+        for (usize byte = 0; byte < sizeof(u64); byte++, bits >>= 8) {
+            out[SAVE_STATE_OFF_VIDEO + word * sizeof(u64) + byte] = bits & 0xFF;
+        }
+    }
+    std::memcpy(out + SAVE_STATE_OFF_KEYPAD, _keypad.data(), MAX_KEYS);
+    for (usize byte = 0; byte < sizeof(u64); byte++) {
+        out[SAVE_STATE_OFF_RNG + byte] = (_rng >> byte * 8) & 0xFF;
+    }
+    std::memcpy(out + SAVE_STATE_OFF_RPL, _rpl.data(), RPL_REGISTERS);
+    std::memcpy(out + SAVE_STATE_OFF_AUDIO, _audio_pattern.data(), AUDIO_PATTERN_SIZE);
+}
+
+bool chip8::restore(const u8* data, usize size) {
+    if (!valid_save_state(data, size)) {
+        return false;
+    }
+
+    // compare in 4 KB, then 64 byte chunks and rewrite only the bytes that changed, a
+    // restore of a recent snapshot touches a handful of bytes and keeps the rest of the
+    // block cache
+    const u8* memory = data + SAVE_STATE_OFF_MEMORY;
+    for (usize page = 0; page < MEMORY_SIZE; page += 4096) {
+        if (!std::memcmp(&_memory[page], memory + page, 4096)) {
+            continue;
+        }
+        for (usize chunk = page; chunk < page + 4096; chunk += 64) {
+            if (!std::memcmp(&_memory[chunk], memory + chunk, 64)) {
+                continue;
+            }
+            for (usize addr = chunk; addr < chunk + 64; addr++) {
+                if (_memory[addr] != memory[addr]) {
+                    write_memory(static_cast<u16>(addr), memory[addr]);
+                }
+            }
+        }
+    }
+
+    std::memcpy(_v.data(), data + SAVE_STATE_OFF_V, TOTAL_REGISTERS);
+    _i = get16(data + SAVE_STATE_OFF_I);
+    _pc = get16(data + SAVE_STATE_OFF_PC);
+    _sp = data[SAVE_STATE_OFF_SP];
+    _delay_timer = data[SAVE_STATE_OFF_DT];
+    _sound_timer = data[SAVE_STATE_OFF_ST];
+    for (usize n = 0; n < STACK_SIZE; n++) {
+        _stack[n] = get16(data + SAVE_STATE_OFF_STACK + n * 2);
+    }
+    _video._hires = data[SAVE_STATE_OFF_HIRES] != 0;
+    _planes = data[SAVE_STATE_OFF_PLANES] & ALL_PLANES;
+    _pitch = data[SAVE_STATE_OFF_PITCH];
+    for (usize word = 0; word < _video._rows.size(); word++) {
+        u64 bits = 0;
+        for (usize byte = sizeof(u64); byte-- > 0;) {
+            bits = bits << 8 | data[SAVE_STATE_OFF_VIDEO + word * sizeof(u64) + byte];
+        }
+        _video._rows[word] = bits;
+    }
+    std::memcpy(_keypad.data(), data + SAVE_STATE_OFF_KEYPAD, MAX_KEYS);
+    _rng = 0;
+    for (usize byte = sizeof(u64); byte-- > 0;) {
+        _rng = _rng << 8 | data[SAVE_STATE_OFF_RNG + byte];
+    }
+    std::memcpy(_rpl.data(), data + SAVE_STATE_OFF_RPL, RPL_REGISTERS);
+    std::memcpy(_audio_pattern.data(), data + SAVE_STATE_OFF_AUDIO, AUDIO_PATTERN_SIZE);
+    _video_dirty = true;
+    return true;
+}
+
+bool chip8::save_state_to(const std::string& filename) const {
+    save_state state;
+    snapshot(state);
+    return write_save_state(filename, state);
+}
+
+bool chip8::load_state_from(const std::string& filename) {
+    save_state_file file(filename);
+    if (!file.data()) {
+        return false;
+    }
+    if (!restore(file.data(), file.size())) {
+        fprintf(stderr, "[-] %s is not a version %d save state \n", filename.c_str(),
+                SAVE_STATE_VERSION);
+        return false;
+    }
+    return true;
 }
 
 void chip8::run() {
-    _opcode = (_memory[_pc] << 8 | _memory[_pc + 1]);
+    _opcode = fetch(_pc);
     _pc += 2;
 
-    bool found = false;
-    for (const auto& op : opcode_table) {
-        if (op._opcode == (_opcode & op._mask)) {
-            found = true;
-            (this->*(op._fn))();
+    _handlers[_opcode](*this);
+}
+
+usize chip8::step(usize cycles) {
+    bool instrumented = _profile != nullptr;
+#ifdef CHIP8_TRACE
+    instrumented |= _trace != nullptr;
+#endif
+    instrumented |= _debug && _debug->armed();
+    if (instrumented) [[unlikely]] {
+        return run_instrumented(cycles);
+    }
+    if (_idle_skip && cycles >= IDLE_MIN_CYCLES) {
+        return run_skipping_idle(cycles);
+    }
+    return run_engine(cycles);
+}
+
+usize chip8::run_engine(usize cycles) {
+    switch (_engine) {
+    case engine::cached:
+    case engine::jit:
+    case engine::aot:
+        return run_cached(cycles);
+    case engine::interpreter:
+    default:
+        for (usize n = 0; n < cycles; n++) {
+            run();
+        }
+        return cycles;
+    }
+}
+
+usize chip8::run_skipping_idle(usize cycles) {
+    // probe where the step starts, then again after runs of doubling length, so a loop
+    // entered halfway through is caught once it has spun about as long as the code before it
+    // ran, for log2(cycles / IDLE_MIN_CYCLES) checks in a step that never idles. A probe that
+    // fails stands in a busy loop (a counter, a key scan), the rest of the step runs as is.
+    usize done = 0;
+    usize chunk = IDLE_MIN_CYCLES;
+    while (done < cycles) {
+        if (!may_idle(_pc)) {
+            done += run_engine(std::min(chunk, cycles - done));
+            chunk *= 2;
+            continue;
+        }
+        usize period = 0;
+        done += find_idle_loop(cycles - done, period);
+        if (!period) {
+            return done + run_engine(cycles - done);
+        }
+
+        // whole passes change nothing, only the partial one left is run
+        usize rest = cycles - done;
+        _idle_skipped += rest - rest % period;
+        for (usize n = 0; n < rest % period; n++) {
+            run();
+        }
+        return cycles;
+    }
+    return done;
+}
+
+bool chip8::may_idle(u16 pc) const {
+    // depth first over the paths out of pc, both ways at skips and through jumps, looking
+    // for one back to pc within IDLE_MAX_PERIOD instructions that crosses nothing with side
+    // effects. One successor of a skip waits per depth, so the stack never grows past that.
+    struct path {
+        u16 addr;
+        u8 length;
+    };
+    std::array<path, IDLE_MAX_PERIOD + 2> pending;
+    usize top = 0;
+    pending[top++] = {pc, 0};
+    while (top) {
+        auto [addr, length] = pending[--top];
+        if (length && addr == pc) {
+            return true;
+        }
+        u16 opcode = fetch(addr);
+        usize index = instruction_index(opcode);
+        if (length == IDLE_MAX_PERIOD || index == MAX_INSTRUCTIONS ||
+            opcode_table[index]._flags & (OP_WRITES_MEMORY | OP_WRITES_OUTPUT)) {
+            continue;
+        }
+        u16 next = addr + (opcode == LONG_I_OPCODE ? 4 : 2);
+        u8 after = length + 1;
+        switch (opcode_table[index]._opcode) {
+        case 0x1000:
+            pending[top++] = {get_nnn(opcode), after};
+            break;
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+        case 0xE09E:
+        case 0xE0A1:
+            pending[top++] = {static_cast<u16>(next + (fetch(next) == LONG_I_OPCODE ? 4 : 2)),
+                              after};
+            pending[top++] = {next, after};
+            break;
+        case 0xF00A: // waits for a key
+        case 0x00FD: // exit spins on itself
+            if (addr == pc) {
+                return true;
+            }
+            break; // a loop of its own, probed once execution stands on it
+        case 0x2000:
+        case 0x00EE:
+        case 0xB000:
+            break; // leaves for code the search doesn't follow
+        default:
+            pending[top++] = {next, after};
             break;
         }
     }
+    return false;
+}
 
-    if (!found) {
-        printf("[ERR] instruction/opcode implementation not found :(");
-        return;
+usize chip8::find_idle_loop(usize budget, usize& period) {
+    // everything an instruction without OP_WRITES_MEMORY or OP_WRITES_OUTPUT can change
+    struct registers {
+        std::array<u8, TOTAL_REGISTERS> _v;
+        u16 _i, _pc;
+        u8 _sp;
+        std::array<u16, STACK_SIZE> _stack;
+        u8 _delay_timer, _sound_timer, _planes, _pitch;
+        u64 _rng;
+        bool operator==(const registers&) const = default;
+    };
+    auto snapshot = [this] {
+        return registers{_v,           _i,          _pc,     _sp,    _stack,
+                         _delay_timer, _sound_timer, _planes, _pitch, _rng};
+    };
+
+    // a loop of up to IDLE_MAX_PERIOD instructions through pc comes back to it within that
+    // many, the first pass may still be settling (Fx07 loading the timer), the second can't
+    registers start = snapshot();
+    usize limit = std::min<usize>(budget, 2 * IDLE_MAX_PERIOD);
+    usize since = 0;
+    usize n = 0;
+    for (; n < limit && since < IDLE_MAX_PERIOD; n++) {
+        usize index = instruction_index(fetch(_pc));
+        if (index == MAX_INSTRUCTIONS ||
+            opcode_table[index]._flags & (OP_WRITES_MEMORY | OP_WRITES_OUTPUT)) {
+            return n;
+        }
+        run();
+        since++;
+        if (_pc != start._pc) {
+            continue;
+        }
+        registers now = snapshot();
+        if (now == start) {
+            period = since;
+            return n + 1;
+        }
+        start = now;
+        since = 0;
     }
+    return n;
+}
 
+usize chip8::run_instrumented(usize cycles) {
+    debugger* dbg = _debug && _debug->armed() ? _debug.get() : nullptr;
+    usize n = 0;
+    while (n < cycles) {
+        if (dbg && !dbg->before(*this)) {
+            break;
+        }
+        u16 pc = _pc;
+        run();
+        n++;
+        if (_profile) {
+            _profile->_pc_hits[pc % MEMORY_SIZE]++;
+            _profile->_instructions[instruction_index(_opcode)]++;
+        }
+#ifdef CHIP8_TRACE
+        if (_trace) {
+            _trace->push({pc, _opcode, _i, _v[get_x(_opcode)], _v[0xF]});
+        }
+#endif
+        if (dbg && !dbg->after(*this)) {
+            break;
+        }
+    }
+    if (_profile) {
+        _profile->_total += n;
+    }
+    return n;
+}
+
+debugger& chip8::debug() {
+    if (!_debug) {
+        _debug = std::make_unique<debugger>();
+    }
+    return *_debug;
+}
+
+bool chip8::debug_paused() const {
+    return _debug && _debug->paused();
+}
+
+#ifdef CHIP8_TRACE
+void chip8::set_trace(usize capacity) {
+    _trace = capacity ? std::make_unique<trace_ring>(capacity) : nullptr;
+}
+#endif
+
+void chip8::set_profiling(bool enabled) {
+    if (!enabled) {
+        _profile.reset();
+    } else if (!_profile) {
+        _profile = std::make_unique<profile>();
+    }
+}
+
+std::string chip8::instruction_name(usize index) {
+    if (index >= MAX_INSTRUCTIONS) {
+        return "invalid";
+    }
+    static const char* digits = "0123456789ABCDEF";
+    u16 opcode = opcode_table[index]._opcode;
+    u16 mask = opcode_table[index]._mask;
+    u8 family = opcode >> 12;
+    bool address = family <= 2 || family == 0xA || family == 0xB;
+    bool two_regs = family == 5 || family == 8 || family == 9 || family == 0xD;
+
+    std::string name = "0x";
+    name += digits[family];
+    for (int shift = 8; shift >= 0; shift -= 4) {
+        if ((mask >> shift) & 0xF) {
+            name += digits[(opcode >> shift) & 0xF];
+        } else if (address || (shift < 8 && !two_regs) || (shift == 0 && family == 0xD)) {
+            name += 'N';
+        } else {
+            name += shift == 8 ? 'X' : 'Y';
+        }
+    }
+    return name;
+}
+
+void chip8::tick_timers() {
     if (_delay_timer > 0) {
         _delay_timer--;
     }
@@ -151,8 +620,330 @@ void chip8::run() {
     }
 }
 
+void chip8::set_engine(engine e) {
+    if (e == engine::jit && !jit::available()) {
+        e = engine::cached;
+    }
+
+    _engine = e;
+    if (_engine == engine::jit && !_jit) {
+        _jit = std::make_unique<jit>(*this);
+    } else if (_engine != engine::jit) {
+        _jit.reset();
+    }
+    flush_blocks();
+}
+
+void chip8::set_quirks(u8 quirks) {
+    // quirk set -> handlers<set>, every combination is instantiated here
+    static constexpr auto select = []<usize... Q>(std::index_sequence<Q...>) {
+        return std::array<const handler* (*)(), QUIRK_SETS>{&handlers<Q>...};
+    }(std::make_index_sequence<QUIRK_SETS>());
+
+    _quirks = quirks & (QUIRK_SETS - 1);
+    _handlers = select[_quirks]();
+    flush_blocks();
+}
+
+void chip8::set_aot_program(const aot_program* program) {
+    _aot = program;
+    flush_blocks();
+}
+
+void chip8::flush_blocks() {
+    _blocks.clear();
+    if (_jit) {
+        _jit->reset();
+    }
+}
+
+std::unique_ptr<basic_block> chip8::decode_block(u16 pc) const {
+    auto block = std::make_unique<basic_block>();
+    block->_start = pc;
+    block->_length = 0;
+    block->_runs = 0;
+    block->_native = nullptr;
+    block->_next = block.get(); // a valid guess for key waits, a wrong one is just looked up
+    block->_next_generation = _blocks.generation();
+
+    // the instruction after the last one must be in memory too, skips look at it
+    u16 addr = pc;
+    while (block->_length < MAX_BLOCK_LENGTH && addr + 4 <= MEMORY_SIZE) {
+        u16 opcode = fetch(addr);
+        u8 idx = decode_table[opcode];
+        if (idx == INVALID_INSTRUCTION) {
+            break; // leave it to run() so the error path stays in one place
+        }
+
+        const auto& op = opcode_table[idx];
+        block->_insns[block->_length++] = {opcode,
+                                           op._flags,
+                                           get_x(opcode),
+                                           get_y(opcode),
+                                           get_kk(opcode),
+                                           get_nnn(opcode),
+                                           static_cast<u16>(addr + 2),
+                                           cached_op_of(op._opcode, op._flags),
+                                           _handlers[opcode]};
+        addr += 2;
+
+        if (op._flags & OP_ENDS_BLOCK) {
+            break;
+        }
+    }
+
+    if (block->_length == 0) {
+        return nullptr;
+    }
+
+    block->_end = addr;
+    if (_engine == engine::aot && _aot && _aot->_quirks == _quirks) {
+        block->_native = _aot->lookup(_memory.data(), block->_start, block->_end);
+    }
+    return block;
+}
+
+usize chip8::run_cached(usize cycles) {
+    usize done = 0;
+    basic_block* prev = nullptr; // the block that just ran, while no block was dropped since
+    u32 generation = _blocks.generation();
+    while (done < cycles) {
+        if (generation != _blocks.generation()) {
+            prev = nullptr;
+            generation = _blocks.generation();
+        }
+
+        // chain to the block that followed last time, skipping the lookup when it still does
+        basic_block* block;
+        if (prev && prev->_next_generation == generation && prev->_next->_start == _pc) {
+            block = prev->_next;
+        } else {
+            block = _blocks.lookup(_pc);
+            if (!block) {
+                auto decoded = decode_block(_pc);
+                if (!decoded) {
+                    run();
+                    done++;
+                    prev = nullptr;
+                    continue;
+                }
+                block = _blocks.insert(std::move(decoded));
+                if (block->_native) {
+                    _blocks.link(block->_start, reinterpret_cast<const void*>(block->_native));
+                }
+            }
+            if (prev) {
+                prev->_next = block;
+                prev->_next_generation = generation;
+            }
+        }
+        prev = block;
+
+        if (block->_native || _jit) [[unlikely]] {
+            // native code runs the whole block, so it only fits when the budget allows
+            if (block->_native && block->_length <= cycles - done) {
+                done += block->_native(*this, static_cast<u32>(cycles - done));
+                continue;
+            }
+            if (_jit && !block->_native && ++block->_runs >= JIT_HOT_THRESHOLD) {
+                block->_native = _jit->compile(*block);
+                if (!block->_native) {
+                    flush_blocks(); // code buffer full, start over
+                }
+                continue;
+            }
+        }
+
+        // only the block's last instruction can move _pc, the others run inline without
+        // touching it or _opcode unless they call into the interpreter
+        usize n = std::min<usize>(block->_length, cycles - done);
+        const cached_insn* insn = block->_insns.data();
+        const cached_insn* end = insn + n;
+        done += n;
+        for (; insn != end; insn++) {
+            switch (insn->_op) {
+            case cached_op::fn:
+                _opcode = insn->_opcode;
+                _pc = insn->_next;
+                insn->_fn(*this);
+                break;
+            case cached_op::store: {
+                // self-modifying code: a store may drop this very block, stop right after it
+                u32 generation = _blocks.generation();
+                _opcode = insn->_opcode;
+                _pc = insn->_next;
+                insn->_fn(*this);
+                if (generation != _blocks.generation()) {
+                    done -= end - insn - 1;
+                    end = insn + 1;
+                }
+                break;
+            }
+            case cached_op::ret:
+                _pc = _stack[--_sp];
+                break;
+            case cached_op::jp:
+                _pc = insn->_nnn;
+                break;
+            case cached_op::call:
+                _stack[_sp++] = insn->_next;
+                _pc = insn->_nnn;
+                break;
+            case cached_op::se_kk:
+                _pc = insn->_next;
+                if (_v[insn->_x] == insn->_kk)
+                    skip_next();
+                break;
+            case cached_op::sne_kk:
+                _pc = insn->_next;
+                if (_v[insn->_x] != insn->_kk)
+                    skip_next();
+                break;
+            case cached_op::se:
+                _pc = insn->_next;
+                if (_v[insn->_x] == _v[insn->_y])
+                    skip_next();
+                break;
+            case cached_op::sne:
+                _pc = insn->_next;
+                if (_v[insn->_x] != _v[insn->_y])
+                    skip_next();
+                break;
+            case cached_op::ld_kk:
+                _v[insn->_x] = insn->_kk;
+                break;
+            case cached_op::add_kk:
+                _v[insn->_x] += insn->_kk;
+                break;
+            case cached_op::ld:
+                _v[insn->_x] = _v[insn->_y];
+                break;
+            case cached_op::add: {
+                u16 sum = _v[insn->_x] + _v[insn->_y];
+                _v[0xF] = sum > 0xFF ? 1 : 0;
+                _v[insn->_x] = sum & 0xFF;
+                break;
+            }
+            case cached_op::sub:
+                _v[0xF] = _v[insn->_x] < _v[insn->_y] ? 1 : 0;
+                _v[insn->_x] -= _v[insn->_y];
+                break;
+            case cached_op::subn:
+                _v[0xF] = _v[insn->_y] > _v[insn->_x] ? 1 : 0;
+                _v[insn->_x] = _v[insn->_y] - _v[insn->_x];
+                break;
+            case cached_op::ld_i:
+                _i = insn->_nnn;
+                break;
+            case cached_op::skp:
+                _pc = insn->_next;
+                if (_keypad[_v[insn->_x] & 0xF])
+                    skip_next();
+                break;
+            case cached_op::sknp:
+                _pc = insn->_next;
+                if (!_keypad[_v[insn->_x] & 0xF])
+                    skip_next();
+                break;
+            case cached_op::ld_vx_dt:
+                _v[insn->_x] = _delay_timer;
+                break;
+            case cached_op::ld_dt:
+                _delay_timer = _v[insn->_x];
+                break;
+            case cached_op::ld_st:
+                _sound_timer = _v[insn->_x];
+                break;
+            case cached_op::add_i:
+                _i += _v[insn->_x];
+                break;
+            case cached_op::ld_f:
+                _i = _v[insn->_x] * 5;
+                break;
+            case cached_op::ld_k: {
+                // wait here until a key is down, all 16 are checked at once first
+                _pc = insn->_next - 2;
+                u64 down[MAX_KEYS / 8];
+                std::memcpy(down, _keypad.data(), sizeof(down));
+                if (!(down[0] | down[1])) {
+                    break;
+                }
+                for (u8 key = 0; key < MAX_KEYS; key++) {
+                    if (_keypad[key] == 1) {
+                        _v[insn->_x] = key;
+                        _pc = insn->_next;
+                        break;
+                    }
+                }
+                break;
+            }
+            }
+        }
+        if (!(end[-1]._flags & OP_ENDS_BLOCK)) {
+            _pc = end[-1]._next;
+        }
+    }
+    return done;
+}
+
+cached_op chip8::cached_op_of(u16 pattern, u8 flags) {
+    switch (pattern) {
+    case 0x00EE:
+        return cached_op::ret;
+    case 0x1000:
+        return cached_op::jp;
+    case 0x2000:
+        return cached_op::call;
+    case 0x3000:
+        return cached_op::se_kk;
+    case 0x4000:
+        return cached_op::sne_kk;
+    case 0x5000:
+        return cached_op::se;
+    case 0x9000:
+        return cached_op::sne;
+    case 0x6000:
+        return cached_op::ld_kk;
+    case 0x7000:
+        return cached_op::add_kk;
+    case 0x8000:
+        return cached_op::ld;
+    case 0x8004:
+        return cached_op::add;
+    case 0x8005:
+        return cached_op::sub;
+    case 0x8007:
+        return cached_op::subn;
+    case 0xA000:
+        return cached_op::ld_i;
+    case 0xE09E:
+        return cached_op::skp;
+    case 0xE0A1:
+        return cached_op::sknp;
+    case 0xF007:
+        return cached_op::ld_vx_dt;
+    case 0xF015:
+        return cached_op::ld_dt;
+    case 0xF018:
+        return cached_op::ld_st;
+    case 0xF01E:
+        return cached_op::add_i;
+    case 0xF029:
+        return cached_op::ld_f;
+    case 0xF00A:
+        return cached_op::ld_k;
+    default:
+        return flags & OP_WRITES_MEMORY ? cached_op::store : cached_op::fn;
+    }
+}
+
+void chip8::invalid() {
+    fprintf(stderr, "[ERR] instruction/opcode implementation not found :(");
+}
+
 void chip8::cls() {
-    _video.fill(0);
+    _video.clear(_planes);
+    _video_dirty = true;
 }
 
 void chip8::ret() {
@@ -173,17 +964,17 @@ void chip8::call() {
 
 void chip8::seq_kk() {
     if (_v[get_x(_opcode)] == get_kk(_opcode))
-        _pc += 2;
+        skip_next();
 }
 
 void chip8::sne_kk() {
     if (_v[get_x(_opcode)] != get_kk(_opcode))
-        _pc += 2;
+        skip_next();
 }
 
 void chip8::seq() {
     if (_v[get_x(_opcode)] == _v[get_y(_opcode)])
-        _pc += 2;
+        skip_next();
 }
 
 void chip8::ld_kk() {
@@ -198,16 +989,25 @@ void chip8::ld() {
     _v[get_x(_opcode)] = _v[get_y(_opcode)];
 }
 
-void chip8::logic_or() {
+template <class Q> void chip8::logic_or() {
     _v[get_x(_opcode)] |= _v[get_y(_opcode)];
+    if constexpr (Q::vf_reset) {
+        _v[0xF] = 0;
+    }
 }
 
-void chip8::logic_and() {
+template <class Q> void chip8::logic_and() {
     _v[get_x(_opcode)] &= _v[get_y(_opcode)];
+    if constexpr (Q::vf_reset) {
+        _v[0xF] = 0;
+    }
 }
 
-void chip8::logic_xor() {
+template <class Q> void chip8::logic_xor() {
     _v[get_x(_opcode)] ^= _v[get_y(_opcode)];
+    if constexpr (Q::vf_reset) {
+        _v[0xF] = 0;
+    }
 }
 
 void chip8::add() {
@@ -225,8 +1025,11 @@ void chip8::sub() {
     _v[x] -= _v[y];
 }
 
-void chip8::shr() {
+template <class Q> void chip8::shr() {
     u8 x = get_x(_opcode);
+    if constexpr (Q::shift_vy) {
+        _v[x] = _v[get_y(_opcode)];
+    }
     _v[0xF] = (_v[x] & 1);
     _v[x] >>= 1;
 }
@@ -238,60 +1041,97 @@ void chip8::subn() {
     _v[x] = _v[y] - _v[x];
 }
 
-void chip8::shl() {
+template <class Q> void chip8::shl() {
     u8 x = get_x(_opcode);
+    if constexpr (Q::shift_vy) {
+        _v[x] = _v[get_y(_opcode)];
+    }
     _v[0xF] = (_v[x] >> 7);
     _v[x] <<= 1;
 }
 
 void chip8::sne() {
     if (_v[get_x(_opcode)] != _v[get_y(_opcode)])
-        _pc += 2;
+        skip_next();
 }
 
 void chip8::ld_i() {
     _i = get_nnn(_opcode);
 }
 
-void chip8::jpo() {
-    _pc = get_nnn(_opcode) + _v[0];
+template <class Q> void chip8::jpo() {
+    _pc = get_nnn(_opcode) + _v[Q::jump_vx ? get_x(_opcode) : 0];
 }
 
 void chip8::rnd() {
-    _v[get_x(_opcode)] = (std::rand() % 0xFF) & get_kk(_opcode);
+    _v[get_x(_opcode)] = random_byte() & get_kk(_opcode);
 }
 
-void chip8::drw() {
-    _v[0xF] = 0;
-    auto cords = point_t(_v[get_x(_opcode)] % CHIP8_WIDTH, _v[get_y(_opcode)] % CHIP8_HEIGHT);
+template <class Q> void chip8::drw() {
+    usize width = _video.width();
+    usize height = _video.height();
+    u8 x = _v[get_x(_opcode)] % width;
+    u8 y = _v[get_y(_opcode)] % height;
     u8 n = get_lowest_nibble(_opcode);
+    bool big = n == 0 && _video._hires; // SUPER-CHIP 16x16, two bytes per row
+    usize rows = big ? 16 : n;
 
-    for (usize row = 0; row < n; row++) {
-        u8 sprite = _memory[_i + row];
+    // one shift, collision test and xor per sprite row, over both words of a hi-res row
+    // every selected plane draws its own sprite, they follow each other from I
+    bool collision = false;
+    u16 sprite_addr = _i;
+    for (usize plane = 0; plane < FRAMEBUFFER_PLANES; plane++) {
+        if (!(_planes & (1 << plane))) {
+            continue;
+        }
+        for (usize row = 0; row < rows; row++) {
+            usize line = y + row;
+            if (line >= height) {
+                if constexpr (!Q::wrap) {
+                    break; // clipped at the bottom edge
+                }
+                line -= height;
+            }
 
-        for (usize col = 0; col < 8; col++) {
-            auto idx = (cords.x + col) + ((cords.y + row) * CHIP8_WIDTH);
-            u8 sprite_px = sprite & (0x80 >> col);
-            u32* screen_px = &_video[idx];
+            u64* words = _video.row(line, plane);
+            u16 addr = static_cast<u16>(sprite_addr + (big ? row * 2 : row));
+            u64 sprite = big ? static_cast<u64>(_memory[addr]) << 56 |
+                                   static_cast<u64>(_memory[static_cast<u16>(addr + 1)]) << 48
+                             : static_cast<u64>(_memory[addr]) << 56;
+            if (!_video._hires) {
+                u64 bits = Q::wrap ? std::rotr(sprite, x) : sprite >> x;
+                collision |= (words[0] & bits) != 0;
+                words[0] ^= bits;
+                continue;
+            }
 
-            if (sprite_px) {
-                if (*screen_px) {
-                    _v[0xF] = 1;
-                }
-                *screen_px ^= 1;
+            // 128 bit shift, what passes the right edge wraps into the left word
+            u64 left, right;
+            if (x < 64) {
+                left = sprite >> x;
+                right = x ? sprite << (64 - x) : 0;
+            } else {
+                left = Q::wrap && x > 64 ? sprite << (128 - x) : 0;
+                right = sprite >> (x - 64);
             }
+            collision |= ((words[0] & left) | (words[1] & right)) != 0;
+            words[0] ^= left;
+            words[1] ^= right;
         }
+        sprite_addr += big ? 32 : n;
     }
+    _v[0xF] = collision ? 1 : 0;
+    _video_dirty = true;
 }
 
 void chip8::skp() {
-    if (_keypad[_v[get_x(_opcode)]])
-        _pc += 2;
+    if (_keypad[_v[get_x(_opcode)] & 0xF])
+        skip_next();
 }
 
 void chip8::sknp() {
-    if (!_keypad[_v[get_x(_opcode)]])
-        _pc += 2;
+    if (!_keypad[_v[get_x(_opcode)] & 0xF])
+        skip_next();
 }
 
 void chip8::ld_vx_dt() {
@@ -315,15 +1155,15 @@ void chip8::ld_k() {
 }
 
 void chip8::ld_dt() {
-    _delay_timer = get_x(_opcode);
+    _delay_timer = _v[get_x(_opcode)];
 }
 
 void chip8::ld_st() {
-    _sound_timer = get_x(_opcode);
+    _sound_timer = _v[get_x(_opcode)];
 }
 
 void chip8::add_i() {
-    _i += get_x(_opcode);
+    _i += _v[get_x(_opcode)];
 }
 
 void chip8::ld_f() {
@@ -336,19 +1176,153 @@ void chip8::str_b() {
     val = val / 10;
     u8 tens = val % 10;
     u8 hundreds = val / 10;
-    _memory[_i] = hundreds;
-    _memory[_i + 1] = tens;
-    _memory[_i + 2] = ones;
+    write_memory(_i, hundreds);
+    write_memory(_i + 1, tens);
+    write_memory(_i + 2, ones);
 }
 
-void chip8::str_r() {
+template <class Q> void chip8::str_r() {
     u8 x = get_x(_opcode);
     for (usize i = 0; i <= x; i++)
-        _memory[_i + i] = _v[i];
+        write_memory(_i + i, _v[i]);
+    if constexpr (Q::memory_i) {
+        _i += x + 1;
+    }
 }
 
-void chip8::read_r() {
+template <class Q> void chip8::read_r() {
     u8 x = get_x(_opcode);
     for (usize i = 0; i <= x; i++)
-        _v[i] = _memory[_i + i];
+        _v[i] = _memory[static_cast<u16>(_i + i)];
+    if constexpr (Q::memory_i) {
+        _i += x + 1;
+    }
+}
+
+void chip8::scd() {
+    // whole scanlines: one block move of the rows that stay, then clear the top n
+    usize n = std::min<usize>(get_lowest_nibble(_opcode), _video.height());
+    usize kept = (_video.height() - n) * FRAMEBUFFER_WORDS;
+    for (usize plane = 0; plane < FRAMEBUFFER_PLANES; plane++) {
+        if (_planes & (1 << plane)) {
+            u64* top = _video.row(0, plane);
+            std::memmove(_video.row(n, plane), top, kept * sizeof(u64));
+            std::fill(top, _video.row(n, plane), 0);
+        }
+    }
+    _video_dirty = true;
+}
+
+void chip8::scu() {
+    usize n = std::min<usize>(get_lowest_nibble(_opcode), _video.height());
+    usize kept = (_video.height() - n) * FRAMEBUFFER_WORDS;
+    for (usize plane = 0; plane < FRAMEBUFFER_PLANES; plane++) {
+        if (_planes & (1 << plane)) {
+            u64* top = _video.row(0, plane);
+            std::memmove(top, _video.row(n, plane), kept * sizeof(u64));
+            std::fill(top + kept, _video.row(_video.height(), plane), 0);
+        }
+    }
+    _video_dirty = true;
+}
+
+void chip8::scr() {
+    // a word shift per row, hi-res rows carry the low nibble of the left word over
+    for (usize plane = 0; plane < FRAMEBUFFER_PLANES; plane++) {
+        if (!(_planes & (1 << plane))) {
+            continue;
+        }
+        for (usize y = 0; y < _video.height(); y++) {
+            u64* words = _video.row(y, plane);
+            if (_video._hires) {
+                words[1] = words[1] >> 4 | words[0] << 60;
+            }
+            words[0] >>= 4;
+        }
+    }
+    _video_dirty = true;
+}
+
+void chip8::scl() {
+    for (usize plane = 0; plane < FRAMEBUFFER_PLANES; plane++) {
+        if (!(_planes & (1 << plane))) {
+            continue;
+        }
+        for (usize y = 0; y < _video.height(); y++) {
+            u64* words = _video.row(y, plane);
+            if (_video._hires) {
+                words[0] = words[0] << 4 | words[1] >> 60;
+                words[1] <<= 4;
+            } else {
+                words[0] <<= 4;
+            }
+        }
+    }
+    _video_dirty = true;
+}
+
+void chip8::halt() {
+    _pc -= 2;
+}
+
+void chip8::low() {
+    _video.clear();
+    _video._hires = false;
+    _video_dirty = true;
+}
+
+void chip8::high() {
+    _video.clear();
+    _video._hires = true;
+    _video_dirty = true;
+}
+
+void chip8::ld_hf() {
+    _i = BIG_FONT_ADDR + (_v[get_x(_opcode)] & 0xF) * 10;
+}
+
+void chip8::str_rpl() {
+    u8 x = get_x(_opcode);
+    for (usize i = 0; i <= x; i++)
+        _rpl[i] = _v[i];
+}
+
+void chip8::read_rpl() {
+    u8 x = get_x(_opcode);
+    for (usize i = 0; i <= x; i++)
+        _v[i] = _rpl[i];
+}
+
+void chip8::str_xy() {
+    u8 x = get_x(_opcode);
+    u8 y = get_y(_opcode);
+    usize count = (x <= y ? y - x : x - y) + 1;
+    for (usize n = 0; n < count; n++)
+        write_memory(_i + n, _v[x <= y ? x + n : x - n]);
+}
+
+void chip8::read_xy() {
+    u8 x = get_x(_opcode);
+    u8 y = get_y(_opcode);
+    usize count = (x <= y ? y - x : x - y) + 1;
+    for (usize n = 0; n < count; n++)
+        _v[x <= y ? x + n : x - n] = _memory[static_cast<u16>(_i + n)];
+}
+
+void chip8::ld_il() {
+    _i = fetch(_pc);
+    _pc += 2;
+}
+
+void chip8::plane() {
+    _planes = get_x(_opcode) & ALL_PLANES;
+}
+
+void chip8::ld_audio() {
+    for (usize n = 0; n < AUDIO_PATTERN_SIZE; n++)
+        _audio_pattern[n] = _memory[static_cast<u16>(_i + n)];
+}
+
+void chip8::ld_pitch() {
+    _pitch = _v[get_x(_opcode)];
 }
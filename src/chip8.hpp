@@ -6,19 +6,56 @@
 #include <utility>
 #include <vector>
 
+#include "block_cache.hpp"
+#include "framebuffer.hpp"
+#include "jit.hpp"
+#include "quirks.hpp"
+#include "save_state.hpp"
+#include "trace.hpp"
 #include "types.hpp"
 
-#define MEMORY_SIZE 4096
+#define MEMORY_SIZE 0x10000 // XO-CHIP's 64 KB, every u16 address is inside it
 #define STACK_SIZE 16
 #define TOTAL_REGISTERS 16
 #define START_ADDR 512
-#define DISPLAY_SIZE 64 * 32
-#define MAX_INSTRUCTIONS 35
+#define MAX_INSTRUCTIONS 51
+#define DECODE_TABLE_SIZE 0x10000
+#define INVALID_INSTRUCTION 0xFF
 #define MAX_KEYS 16
-#define CHIP8_WIDTH 64
-#define CHIP8_HEIGHT 32
+#define BIG_FONT_ADDR 0x50         // SUPER-CHIP 8x10 digits, after the 4x5 ones at 0
+#define RPL_REGISTERS 16           // SUPER-CHIP persistent flag registers
+#define AUDIO_PATTERN_SIZE 16      // XO-CHIP 1-bit sample buffer, 128 samples
+#define DEFAULT_AUDIO_PATTERN 0xF0 // square wave at reset, the 500 Hz CHIP-8 beep
+#define DEFAULT_PITCH 64           // XO-CHIP pitch register at reset, 4000 samples per second
+#define LONG_I_OPCODE 0xF000       // XO-CHIP F000 nnnn, the only two-word instruction
 #define SCALE_FACTOR 10
 
+// opcode_member flags
+#define OP_ENDS_BLOCK 0x01    // may change _pc: jumps, calls, returns, skips, key wait
+#define OP_WRITES_MEMORY 0x02 // writes _memory through write_memory()
+#define OP_WRITES_OUTPUT 0x04 // changes the display, the audio pattern or the RPL flags
+
+#define IDLE_MAX_PERIOD 8  // longest idle loop step() recognizes, in instructions
+#define IDLE_MIN_CYCLES 64 // shortest step() worth probing for an idle loop
+
+/// Execution engine used by chip8::step()
+enum class engine {
+    interpreter, // fetch, decode and dispatch every instruction
+    cached,      // execute predecoded basic blocks from a block_cache
+    jit,         // like cached, hot blocks are recompiled to native code
+    aot,         // like cached, blocks of a ROM recompiled ahead of time run natively
+};
+
+/// Parses an engine name as used on the command line, returns false if it is unknown
+bool parse_engine(const std::string& name, engine& e);
+
+/// Returns the command line name of an engine
+const char* engine_name(engine e);
+
+struct aot_program;
+struct profile;
+class debugger;
+
 // CHIP-8 virtual machine implementation
 class chip8 {
   protected:
@@ -30,17 +67,122 @@ class chip8 {
     std::array<u16, STACK_SIZE> _stack{};
     u8 _delay_timer{};
     u8 _sound_timer{};
-    std::array<u32, DISPLAY_SIZE> _video{};
+    framebuffer _video{};
+    bool _video_dirty{true}; // set by cls and drw, cleared once the frame has been presented
     std::array<u8, MAX_KEYS> _keypad{};
     u16 _opcode{};
+    u64 _rng{}; // rnd's generator state, see set_seed()
+    std::array<u8, RPL_REGISTERS> _rpl{}; // kept across ROM loads, like the HP48's
+    u8 _planes{1}; // XO-CHIP bitplanes cls, drw and the scrolls touch, see plane()
+    std::array<u8, AUDIO_PATTERN_SIZE> _audio_pattern{};
+    u8 _pitch{DEFAULT_PITCH};
+
+    // execution engine state
+    engine _engine{engine::interpreter};
+    block_cache _blocks;
+    std::unique_ptr<jit> _jit;
+    const aot_program* _aot{};
+
+    u8 _quirks{}; // QUIRK_* bits, see set_quirks()
+
+    std::unique_ptr<profile> _profile; // nullptr unless profiling, see set_profiling()
+    std::unique_ptr<debugger> _debug;  // nullptr until debug() is first called
+    bool _idle_skip{};                 // see set_idle_skip()
+    u64 _idle_skipped{};               // instructions skipped in idle loops so far
+#ifdef CHIP8_TRACE
+    std::unique_ptr<trace_ring> _trace; // nullptr unless tracing, see set_trace()
+#endif
+
+    // instruction handler, a plain function so it can be stored in flat tables
+    using handler = void (*)(chip8&);
+
+    /// Calls the member handler fn, instantiated once per instruction so the call is direct
+    template <void (chip8::*fn)()> static void exec(chip8& vm) {
+        (vm.*fn)();
+    }
 
     // opcode table
     struct opcode_member {
         u16 _opcode;
         u16 _mask;
-        void (chip8::*_fn)();
+        handler _fn;
+        u8 _flags;
     };
-    std::array<struct opcode_member, MAX_INSTRUCTIONS> opcode_table{};
+    static const std::array<struct opcode_member, MAX_INSTRUCTIONS> opcode_table;
+
+    // opcode -> opcode_table index (or INVALID_INSTRUCTION)
+    static const std::array<u8, DECODE_TABLE_SIZE> decode_table;
+
+    /// Returns opcode_table with the handlers instantiated for quirk policy Q
+    template <class Q> static constexpr std::array<opcode_member, MAX_INSTRUCTIONS> opcodes();
+
+    /// Returns the opcode -> handler table of quirk set Q, built from opcodes() on first use
+    /// and shared by every instance using the set, so dispatch is a single indexed load and
+    /// call into handlers compiled for exactly those quirks
+    template <u8 Q> static const handler* handlers();
+
+    const handler* _handlers; // handlers() of _quirks
+
+    /// Returns the next byte of the instance's random sequence (splitmix64)
+    u8 random_byte() {
+        u64 z = (_rng += 0x9E3779B97F4A7C15);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return static_cast<u8>((z ^ (z >> 31)) >> 56);
+    }
+
+    /// Returns the instruction word at addr, the second byte wraps around the address space
+    u16 fetch(u16 addr) const {
+        return _memory[addr] << 8 | _memory[static_cast<u16>(addr + 1)];
+    }
+
+    /// Moves _pc past the next instruction, both words of it for F000 nnnn
+    void skip_next() {
+        _pc += fetch(_pc) == LONG_I_OPCODE ? 4 : 2;
+    }
+
+    /// Handler for opcodes that are not in opcode_table
+    void invalid();
+
+    /// Decodes the straight-line run of instructions starting at pc
+    /// Returns nullptr if the first instruction can't be cached (invalid opcode, end of memory)
+    std::unique_ptr<basic_block> decode_block(u16 pc) const;
+
+    /// Interprets `cycles` instructions, counting each one into _profile and _trace and
+    /// checking it against _debug, returns how many ran before a break
+    usize run_instrumented(usize cycles);
+
+    /// Runs up to `cycles` instructions from the block cache, returns how many ran
+    usize run_cached(usize cycles);
+
+    /// Runs `cycles` instructions with the selected engine, without instrumentation
+    usize run_engine(usize cycles);
+
+    /// Runs `cycles` instructions, skipping the rest of them once execution is caught in an
+    /// idle loop, see set_idle_skip()
+    usize run_skipping_idle(usize cycles);
+
+    /// Returns true if some path out of pc, taking either side of skips and following jumps,
+    /// comes back to pc (or waits there) within IDLE_MAX_PERIOD instructions without any
+    /// side effect: only then is a probe with find_idle_loop() worth interpreting for
+    bool may_idle(u16 pc) const;
+
+    /// Interprets up to `budget` instructions looking for an idle loop at _pc, returns how
+    /// many ran. Sets period to the loop's length in instructions if it found one, execution
+    /// then stands at the same point of the loop it started from.
+    usize find_idle_loop(usize budget, usize& period);
+
+    /// Returns what the cached engine runs for an opcode_table pattern with these flags
+    static cached_op cached_op_of(u16 pattern, u8 flags);
+
+    /// Drops every cached block and the native code generated for them
+    void flush_blocks();
+
+    friend class jit;
+    friend class aot;
+    friend class simd_batch;
+    friend class disassembler;
+    friend class debugger;
 
   public:
     chip8();
@@ -62,16 +204,244 @@ class chip8 {
     /// This function can be used to debug/test custom ROMs
     void load_rom(const std::vector<u8>& raw_data);
 
+    /// Writes the machine state (memory, registers, stack, timers, video, keypad) into
+    /// state, see save_state.hpp for the layout
+    void snapshot(save_state& state) const;
+
+    /// Restores a state written by snapshot(), returns false and leaves the machine alone
+    /// if data is not a save state of this version
+    /// Only memory bytes that differ are written, so cached blocks outside of them survive
+    bool restore(const u8* data, usize size);
+
+    bool restore(const save_state& state) {
+        return restore(state.data(), state.size());
+    }
+
+    /// Saves the machine state to filename, returns false and prints the error on failure
+    bool save_state_to(const std::string& filename) const;
+
+    /// Restores the machine state from filename, the file is memory mapped where possible
+    /// Returns false and prints the error on failure, the machine is left alone then
+    bool load_state_from(const std::string& filename);
+
     /// Fetch, decode, execute...
     void run();
 
+    /// Executes `cycles` instructions with the selected engine, timers are left alone
+    /// Returns how many instructions were executed
+    usize step(usize cycles);
+
+    /// Decrements the delay and sound timers, meant to be called at 60 Hz (see scheduler)
+    void tick_timers();
+
+    /// Restarts rnd's random sequence from seed, every engine draws the same sequence
+    /// Instances are seeded from the clock when constructed, seed them for reproducible runs
+    void set_seed(u64 seed) {
+        _rng = seed;
+    }
+
+    /// Selects the engine used by step()
+    /// engine::jit falls back to engine::cached on hosts without a JIT backend
+    void set_engine(engine e);
+
+    /// Installs the native code recompiled from a ROM by chip8_aot, used by engine::aot
+    /// Without a program engine::aot runs like engine::cached
+    void set_aot_program(const aot_program* program);
+
+    /// Starts or stops collecting per instruction and per address counters
+    /// While profiling, step() interprets whatever the engine (every engine reaches the same
+    /// states, so the counts are the ROM's). Without it step() doesn't even check for one.
+    void set_profiling(bool enabled);
+
+    /// Returns the counters, nullptr unless profiling
+    const profile* get_profile() const {
+        return _profile.get();
+    }
+
+    profile* get_profile() {
+        return _profile.get();
+    }
+
+    /// Starts or stops skipping idle loops, off by default
+    /// A loop is idle when one pass through it comes back to the same pc with the same
+    /// registers and timers, and writes neither memory nor the display, audio or RPL flags,
+    /// like the usual `Fx07 / 3x00 / 1nnn` delay timer waits and Fx0A key waits. Only
+    /// tick_timers() and key changes can get such a loop out, and neither happens during a
+    /// step(), so step() counts the rest of its instructions as run and ends where the loop
+    /// would have been. Every engine reaches the exact same state, only faster.
+    void set_idle_skip(bool enabled) {
+        _idle_skip = enabled;
+    }
+
+    bool get_idle_skip() const {
+        return _idle_skip;
+    }
+
+    /// Returns how many instructions step() skipped in idle loops so far
+    u64 get_idle_skipped() const {
+        return _idle_skipped;
+    }
+
+    /// Returns the breakpoints and watchpoints, created on first use
+    /// While any is armed step() interprets and checks every instruction like profiling,
+    /// and stops early at a break. Without one step() doesn't check anything.
+    debugger& debug();
+
+    /// Returns the debugger, nullptr if debug() was never called
+    const debugger* get_debugger() const {
+        return _debug.get();
+    }
+
+    /// Returns true while the debugger holds execution, step() then runs nothing
+    bool debug_paused() const;
+
+#ifdef CHIP8_TRACE
+    /// Records every following instruction into a ring of the last `capacity` ones (rounded
+    /// up to a power of two), 0 stops. Like profiling, step() interprets while tracing.
+    /// Only exists in builds configured with CHIP8_TRACE, others have no tracing code at all.
+    void set_trace(usize capacity);
+
+    /// Returns the trace, nullptr unless tracing
+    const trace_ring* get_trace() const {
+        return _trace.get();
+    }
+#endif
+
+    /// Returns the opcode_table index of opcode, MAX_INSTRUCTIONS if it isn't in the table
+    static usize instruction_index(u16 opcode) {
+        u8 idx = decode_table[opcode];
+        return idx == INVALID_INSTRUCTION ? MAX_INSTRUCTIONS : idx;
+    }
+
+    /// Returns true if opcode is a 0nnn machine code call, which every engine ignores
+    static bool is_sys(u16 opcode) {
+        return (opcode & 0xF000) == 0 && opcode_table[decode_table[opcode]]._mask == 0xF000;
+    }
+
+    /// Returns the pattern of an opcode_table entry as the table spells it, e.g. "0x8XY4"
+    static std::string instruction_name(usize index);
+
+    /// Returns the engine used by step()
+    engine get_engine() const {
+        return _engine;
+    }
+
+    /// Returns the block cache hit/miss counters
+    const block_stats& get_block_stats() const {
+        return _blocks.stats();
+    }
+
+    /// Writes a byte into memory
+    /// Every write after the ROM is loaded must go through here, so cached code is invalidated
+    void write_memory(u16 addr, u8 val) {
+        _memory[addr] = val;
+        _blocks.on_write(addr);
+    }
+
+    /// Sets the state of one of the 16 keys
+    void set_key(u8 key, bool pressed) {
+        _keypad[key & 0xF] = pressed;
+    }
+
+    /// Returns the keypad, 1 for every key that is down
+    const std::array<u8, MAX_KEYS>& get_keypad() const {
+        return _keypad;
+    }
+
+    /// Returns the display, one bit per pixel and plane, see expand_framebuffer()
+    const framebuffer& get_framebuffer() const {
+        return _video;
+    }
+
+    /// Selects the interpreter behaviours (QUIRK_* bits) the ROM expects
+    /// Every set has its own handlers with the quirks compiled in, this only swaps the handler
+    /// table (and drops cached blocks, which hold the previous set's handlers)
+    void set_quirks(u8 quirks);
+
+    /// Returns the QUIRK_* bits in use
+    u8 get_quirks() const {
+        return _quirks;
+    }
+
+    /// Selects whether drw wraps sprites around the screen edges or clips them (default)
+    /// Shorthand for toggling QUIRK_WRAP with set_quirks()
+    void set_sprite_wrap(bool wrap) {
+        set_quirks(wrap ? _quirks | QUIRK_WRAP : _quirks & ~QUIRK_WRAP);
+    }
+
+    /// Returns true if the framebuffer may have changed since the last clear_video_dirty()
+    /// Renderers use it to skip converting and uploading frames that didn't change
+    bool get_video_dirty() const {
+        return _video_dirty;
+    }
+
+    /// Marks the current framebuffer as presented
+    void clear_video_dirty() {
+        _video_dirty = false;
+    }
+
+    bool get_sprite_wrap() const {
+        return _quirks & QUIRK_WRAP;
+    }
+
+    const std::array<u8, MEMORY_SIZE>& get_memory() const {
+        return _memory;
+    }
+
+    const std::array<u8, TOTAL_REGISTERS>& get_v() const {
+        return _v;
+    }
+
+    u16 get_i() const {
+        return _i;
+    }
+
+    u16 get_pc() const {
+        return _pc;
+    }
+
+    u8 get_sp() const {
+        return _sp;
+    }
+
+    const std::array<u16, STACK_SIZE>& get_stack() const {
+        return _stack;
+    }
+
+    u8 get_delay_timer() const {
+        return _delay_timer;
+    }
+
+    u8 get_sound_timer() const {
+        return _sound_timer;
+    }
+
+    const std::array<u8, RPL_REGISTERS>& get_rpl() const {
+        return _rpl;
+    }
+
+    /// Returns the XO-CHIP plane mask drawing instructions use
+    u8 get_planes() const {
+        return _planes;
+    }
+
+    /// Returns the XO-CHIP audio pattern, played MSB first while the sound timer runs
+    const std::array<u8, AUDIO_PATTERN_SIZE>& get_audio_pattern() const {
+        return _audio_pattern;
+    }
+
+    /// Returns the XO-CHIP pitch register, see ld_pitch()
+    u8 get_pitch() const {
+        return _pitch;
+    }
+
   public:
     /*********************
         CPU INSTRUCTIONS
     **********************/
 
     /// 00E0 - CLS
-    /// Clear the display
+    /// Clear the display (the selected planes)
     void cls();
 
     /// 00EE - RET
@@ -99,6 +469,7 @@ class chip8 {
 
     /// 5xy0 - SE Vx, Vy
     /// Skip next instruction if Vx = Vy (if registers equal)
+    /// Like every skip, skips both words of an F000 nnnn
     void seq();
 
     /// 6xkk - LD Vx, byte
@@ -113,17 +484,19 @@ class chip8 {
     /// Set Vx = Vy
     void ld();
 
+    // handlers templated on a quirk_policy compile once per quirk set, see set_quirks()
+
     /// 8xy1 - OR Vx, Vy
-    /// Set Vx = Vx OR Vy
-    void logic_or();
+    /// Set Vx = Vx OR Vy (VF = 0 with QUIRK_VF_RESET, like and/xor)
+    template <class Q> void logic_or();
 
     /// 8xy2 - AND Vx, Vy
     /// Set Vx = Vx AND Vy
-    void logic_and();
+    template <class Q> void logic_and();
 
     /// 8xy3 - XOR Vx, Vy
     /// Set Vx = Vx XOR Vy
-    void logic_xor();
+    template <class Q> void logic_xor();
 
     /// 8xy4 - ADD Vx, Vy
     /// Set Vx = Vx + Vy, set VF = carry
@@ -134,8 +507,8 @@ class chip8 {
     void sub();
 
     /// 8xy6 - SHR Vx {, Vy}
-    /// Set Vx = Vx SHR 1
-    void shr();
+    /// Set Vx = Vx SHR 1 (Vy SHR 1 with QUIRK_SHIFT_VY, like shl)
+    template <class Q> void shr();
 
     /// 8xy7 - SUBN Vx, Vy
     /// Set Vx = Vy - Vx, set VF = NOT borrow
@@ -143,7 +516,7 @@ class chip8 {
 
     /// 8xyE - SHL Vx {, Vy}
     /// Set Vx = Vx SHL 1
-    void shl();
+    template <class Q> void shl();
 
     /// 9xy0 - SNE Vx, Vy
     /// Skip next instruction if Vx != Vy
@@ -154,8 +527,8 @@ class chip8 {
     void ld_i();
 
     /// Bnnn - JP V0, addr
-    /// Jump to location nnn + V0 (jmp by offset)
-    void jpo();
+    /// Jump to location nnn + V0 (jmp by offset), xnn + Vx with QUIRK_JUMP_VX
+    template <class Q> void jpo();
 
     /// Cxkk - RND Vx, byte
     /// Set Vx = random byte AND kk
@@ -163,8 +536,10 @@ class chip8 {
 
     /// Dxyn - DRW Vx, Vy, nibble
     /// Display n-byte sprite starting at mem location I at (Vx, Vy)
-    /// Set VF = collision
-    void drw();
+    /// Dxy0 in hi-res mode displays a 16x16 sprite of 32 bytes (SUPER-CHIP)
+    /// With two planes selected the second plane's sprite follows the first one's (XO-CHIP)
+    /// Set VF = collision, sprites are clipped at the screen edges (wrapped with QUIRK_WRAP)
+    template <class Q> void drw();
 
     /// Ex9E - SKP Vx
     /// Skip next instruction if key with the value of Vx is pressed
@@ -204,11 +579,84 @@ class chip8 {
 
     /// Fx55 - LD [I], Vx
     /// Store registers V0 through Vx in memory starting at location I
-    void str_r();
+    /// With QUIRK_MEMORY_I, I is left at I + x + 1 (like read_r)
+    template <class Q> void str_r();
 
     /// Fx65 - LD Vx, [I]
     /// Read registers V0 through Vx from memory starting at location I
-    void read_r();
+    template <class Q> void read_r();
+
+    /*********************
+        SUPER-CHIP
+    **********************/
+
+    /// 00Cn - SCD nibble
+    /// Scroll the display down n lines
+    void scd();
+
+    /// 00FB - SCR
+    /// Scroll the display right 4 pixels
+    void scr();
+
+    /// 00FC - SCL
+    /// Scroll the display left 4 pixels
+    void scl();
+
+    /// 00FD - EXIT
+    /// Stop the program, it keeps jumping to this instruction
+    void halt();
+
+    /// 00FE - LOW
+    /// Switch to the 64x32 mode and clear the display
+    void low();
+
+    /// 00FF - HIGH
+    /// Switch to the 128x64 mode and clear the display
+    void high();
+
+    /// Fx30 - LD HF, Vx
+    /// Set I = location of the 8x10 sprite for digit Vx
+    void ld_hf();
+
+    /// Fx75 - LD R, Vx
+    /// Store registers V0 through Vx in the RPL flag registers
+    void str_rpl();
+
+    /// Fx85 - LD Vx, R
+    /// Read registers V0 through Vx from the RPL flag registers
+    void read_rpl();
+
+    /*********************
+        XO-CHIP
+    **********************/
+
+    /// 00Dn - SCU nibble
+    /// Scroll the display up n lines
+    void scu();
+
+    /// 5xy2 - LD [I], Vx - Vy
+    /// Store registers Vx through Vy (descending if x > y) in memory starting at I, I stays
+    void str_xy();
+
+    /// 5xy3 - LD Vx - Vy, [I]
+    /// Read registers Vx through Vy (descending if x > y) from memory starting at I, I stays
+    void read_xy();
+
+    /// F000 nnnn - LD I, long addr
+    /// Set I = nnnn, the word following the instruction
+    void ld_il();
+
+    /// Fn01 - PLANE n
+    /// Select the bitplanes (mask n) cls, drw and the scrolls work on
+    void plane();
+
+    /// F002 - AUDIO
+    /// Load the 16 byte audio pattern from memory starting at I
+    void ld_audio();
+
+    /// Fx3A - PITCH Vx
+    /// Set the pitch register = Vx, the pattern plays at 4000 * 2 ^ ((Vx - 64) / 48) Hz
+    void ld_pitch();
 };
 
 #endif
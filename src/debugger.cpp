@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <bit>
+
+#include "debugger.hpp"
+#include "utils.hpp"
+
+const char* break_reason_name(break_event::reason reason) {
+    switch (reason) {
+    case break_event::reason::breakpoint:
+        return "breakpoint";
+    case break_event::reason::opcode:
+        return "opcode";
+    case break_event::reason::memory:
+        return "memory";
+    case break_event::reason::reg:
+        return "register";
+    case break_event::reason::run_to:
+        return "run_to";
+    case break_event::reason::pause:
+        return "pause";
+    case break_event::reason::none:
+    default:
+        return "none";
+    }
+}
+
+void debugger::set_breakpoint(u16 addr, bool enabled) {
+    if (has_breakpoint(addr) == enabled) {
+        return;
+    }
+    _breakpoints[addr >> 6] ^= u64{1} << (addr & 63);
+    _breakpoint_count += enabled ? 1 : -1;
+}
+
+std::vector<u16> debugger::breakpoints() const {
+    std::vector<u16> out;
+    for (usize word = 0; word < _breakpoints.size(); word++) {
+        for (u64 bits = _breakpoints[word]; bits; bits &= bits - 1) {
+            out.push_back(static_cast<u16>(word * 64 + std::countr_zero(bits)));
+        }
+    }
+    return out;
+}
+
+void debugger::add_opcode_breakpoint(u16 pattern, u16 mask) {
+    _opcodes.emplace_back(pattern & mask, mask);
+}
+
+void debugger::remove_opcode_breakpoint(usize index) {
+    if (index < _opcodes.size()) {
+        _opcodes.erase(_opcodes.begin() + index);
+    }
+}
+
+void debugger::watch_memory(u16 first, u16 last) {
+    _watches.emplace_back(std::min(first, last), std::max(first, last));
+    rebuild_watched();
+}
+
+void debugger::remove_memory_watch(usize index) {
+    if (index < _watches.size()) {
+        _watches.erase(_watches.begin() + index);
+        rebuild_watched();
+    }
+}
+
+void debugger::rebuild_watched() {
+    _watched.fill(0);
+    for (auto [first, last] : _watches) {
+        for (usize addr = first; addr <= last; addr++) {
+            _watched[addr >> 6] |= u64{1} << (addr & 63);
+        }
+    }
+}
+
+void debugger::watch_register(u8 reg, bool enabled) {
+    if (reg > WATCH_I) {
+        return;
+    }
+    if (enabled) {
+        _watched_registers |= 1u << reg;
+    } else {
+        _watched_registers &= ~(1u << reg);
+    }
+}
+
+void debugger::clear() {
+    _breakpoints.fill(0);
+    _breakpoint_count = 0;
+    _opcodes.clear();
+    _watches.clear();
+    _watched.fill(0);
+    _watched_registers = 0;
+    _run_to = -1;
+}
+
+bool debugger::stop(break_event::reason reason, u16 pc, u16 addr) {
+    _paused = true;
+    _break = {reason, pc, addr};
+    return false;
+}
+
+void debugger::pause(u16 pc) {
+    if (!_paused) {
+        stop(break_event::reason::pause, pc);
+    }
+}
+
+void debugger::resume() {
+    _skip_once = _paused;
+    _paused = false;
+}
+
+void debugger::run_to(u16 addr) {
+    _run_to = addr;
+    resume();
+}
+
+void debugger::save_registers(const chip8& vm) {
+    if (_watched_registers || !_watches.empty()) {
+        _v = vm._v;
+        _i = vm._i;
+    }
+}
+
+void debugger::single_step(chip8& vm) {
+    save_registers(vm);
+    vm.run();
+    if (after(vm)) {
+        stop(break_event::reason::pause, vm._pc);
+    }
+    _skip_once = false;
+}
+
+bool debugger::before(const chip8& vm) {
+    if (_paused) {
+        return false;
+    }
+    u16 pc = vm._pc;
+    if (_skip_once) {
+        _skip_once = false;
+    } else {
+        if (_run_to == pc) {
+            _run_to = -1;
+            return stop(break_event::reason::run_to, pc);
+        }
+        if (has_breakpoint(pc)) {
+            return stop(break_event::reason::breakpoint, pc);
+        }
+        if (!_opcodes.empty()) {
+            u16 opcode = vm.fetch(pc);
+            for (auto [pattern, mask] : _opcodes) {
+                if ((opcode & mask) == pattern) {
+                    return stop(break_event::reason::opcode, pc);
+                }
+            }
+        }
+    }
+    save_registers(vm);
+    return true;
+}
+
+bool debugger::after(const chip8& vm) {
+    u16 opcode = vm._opcode;
+    usize index = chip8::instruction_index(opcode);
+    if (!_watches.empty() && index < MAX_INSTRUCTIONS &&
+        chip8::opcode_table[index]._flags & OP_WRITES_MEMORY) {
+        // the writers store from I on: Fx33 three digits, Fx55 V0-Vx, 5xy2 Vx-Vy
+        u8 x = get_x(opcode), y = get_y(opcode);
+        usize length = x + 1;
+        if (chip8::opcode_table[index]._opcode == 0xF033) {
+            length = 3;
+        } else if (chip8::opcode_table[index]._opcode == 0x5002) {
+            length = (x > y ? x - y : y - x) + 1;
+        }
+        for (usize b = 0; b < length; b++) {
+            u16 addr = static_cast<u16>(_i + b);
+            if (test(_watched, addr)) {
+                return stop(break_event::reason::memory, vm._pc, addr);
+            }
+        }
+    }
+    if (_watched_registers) {
+        for (u8 x = 0; x < TOTAL_REGISTERS; x++) {
+            if ((_watched_registers >> x) & 1 && vm._v[x] != _v[x]) {
+                return stop(break_event::reason::reg, vm._pc, x);
+            }
+        }
+        if ((_watched_registers >> WATCH_I) & 1 && vm._i != _i) {
+            return stop(break_event::reason::reg, vm._pc, WATCH_I);
+        }
+    }
+    return true;
+}
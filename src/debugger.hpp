@@ -0,0 +1,152 @@
+#ifndef DEBUGGER_HPP
+#define DEBUGGER_HPP
+
+#include <array>
+#include <utility>
+#include <vector>
+
+#include "chip8.hpp"
+#include "types.hpp"
+
+#define WATCH_I TOTAL_REGISTERS // watch_register() index of I, after V0-VF
+
+/// Why execution stopped, see debugger::last_break()
+struct break_event {
+    enum class reason : u8 {
+        none,
+        breakpoint, // about to execute an instruction at a breakpoint address
+        opcode,     // about to execute an instruction matching an opcode breakpoint
+        memory,     // an instruction wrote a watched memory byte, `_addr` is the first one
+        reg,        // an instruction changed a watched register, `_addr` is V index or WATCH_I
+        run_to,     // reached the run_to() address
+        pause,      // pause() or a single step
+    };
+    reason _reason{reason::none};
+    u16 _pc{};   // where execution stands now, the next instruction to run
+    u16 _addr{}; // the byte or register that triggered a watchpoint
+};
+
+/// Returns the name of a break reason as chip8-run reports it, e.g. "breakpoint"
+const char* break_reason_name(break_event::reason reason);
+
+/// Breakpoints and watchpoints of a chip8, see chip8::debug()
+/// PC breakpoints are a bit per address of the 64 KB space, memory watchpoints a second
+/// bitmap with the ranges kept for listing, register watchpoints a mask. While anything is
+/// armed (or execution is paused) step() interprets and checks every instruction, like
+/// profiling does. With nothing armed step() doesn't check anything per instruction.
+/// Only change a running machine's debugger from the thread running it, see
+/// emu_thread::paused().
+class debugger {
+  private:
+    using bitmap = std::array<u64, MEMORY_SIZE / 64>;
+
+    bitmap _breakpoints{};
+    usize _breakpoint_count{};
+    std::vector<std::pair<u16, u16>> _opcodes; // (opcode, mask) breakpoints
+    bitmap _watched{};
+    std::vector<std::pair<u16, u16>> _watches; // inclusive memory ranges
+    u32 _watched_registers{};                  // bit per V register, WATCH_I for I
+    int _run_to{-1};                           // temporary breakpoint, -1 if none
+
+    bool _paused{};
+    bool _skip_once{}; // resuming, the first instruction doesn't break on its address
+    break_event _break{};
+
+    // registers before the instruction being checked
+    std::array<u8, TOTAL_REGISTERS> _v{};
+    u16 _i{};
+
+    static bool test(const bitmap& bits, u16 addr) {
+        return (bits[addr >> 6] >> (addr & 63)) & 1;
+    }
+
+    /// Stops with reason, returns false so the run loops can `return stop(...)`
+    bool stop(break_event::reason reason, u16 pc, u16 addr = 0);
+
+    /// Rebuilds _watched from _watches
+    void rebuild_watched();
+
+    /// Keeps the registers the watchpoints compare against after the next instruction
+    void save_registers(const chip8& vm);
+
+  public:
+    /// Sets or clears a breakpoint on the instruction at addr
+    void set_breakpoint(u16 addr, bool enabled = true);
+
+    bool has_breakpoint(u16 addr) const {
+        return test(_breakpoints, addr);
+    }
+
+    /// Returns every breakpoint address, in order
+    std::vector<u16> breakpoints() const;
+
+    /// Breaks before any instruction with (opcode & mask) == (pattern & mask), e.g.
+    /// (0xD000, 0xF000) stops at every drw
+    void add_opcode_breakpoint(u16 pattern, u16 mask);
+
+    void remove_opcode_breakpoint(usize index);
+
+    const std::vector<std::pair<u16, u16>>& opcode_breakpoints() const {
+        return _opcodes;
+    }
+
+    /// Breaks after any instruction writing memory in [first, last]
+    void watch_memory(u16 first, u16 last);
+
+    void remove_memory_watch(usize index);
+
+    const std::vector<std::pair<u16, u16>>& memory_watches() const {
+        return _watches;
+    }
+
+    /// Breaks after any instruction changing Vx (x < 16) or I (WATCH_I)
+    void watch_register(u8 reg, bool enabled = true);
+
+    bool watching_register(u8 reg) const {
+        return (_watched_registers >> reg) & 1;
+    }
+
+    /// Removes every breakpoint and watchpoint, doesn't resume
+    void clear();
+
+    /// Returns true if step() has to check instructions: something can stop execution, or
+    /// it is stopped
+    bool armed() const {
+        return _breakpoint_count || !_opcodes.empty() || !_watches.empty() ||
+               _watched_registers || _run_to >= 0 || _paused;
+    }
+
+    /// Returns true while stopped, step() then runs nothing and the scheduler lets no
+    /// emulated time pass
+    bool paused() const {
+        return _paused;
+    }
+
+    /// Stops before the next instruction
+    void pause(u16 pc);
+
+    /// Continues from a stop, without breaking again on the instruction it stopped at
+    void resume();
+
+    /// Continues until the instruction at addr is about to run (or anything else breaks)
+    void run_to(u16 addr);
+
+    /// Runs exactly one instruction of vm whether paused or not, then stays paused
+    /// Breakpoints don't apply, watchpoints only record what the instruction touched
+    void single_step(chip8& vm);
+
+    /// Returns why execution last stopped
+    const break_event& last_break() const {
+        return _break;
+    }
+
+    /// Called by the run loop before executing the instruction at vm's pc, returns false
+    /// if execution stops there
+    bool before(const chip8& vm);
+
+    /// Called by the run loop after the instruction ran, returns false if it hit a
+    /// watchpoint
+    bool after(const chip8& vm);
+};
+
+#endif
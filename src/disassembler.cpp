@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "disassembler.hpp"
+#include "utils.hpp"
+
+// _flags bits
+#define DISASM_HEAD 0x01        // first byte of an instruction
+#define DISASM_BODY 0x02        // covered by an instruction, its first byte included
+#define DISASM_LONG 0x04        // head of a 4 byte F000 nnnn
+#define DISASM_CALL_TARGET 0x08 // gets a sub_ label
+#define DISASM_JUMP_TARGET 0x10 // gets an L_ label
+#define DISASM_CHUNK 64         // bytes update() compares at once
+
+namespace {
+
+/// Mnemonic per opcode_table pattern, %x/%y are register digits, %n the low nibble, %b kk,
+/// %a nnn and %l the word after the opcode
+struct mnemonic_format {
+    u16 _pattern;
+    const char* _format;
+};
+
+// clang-format off
+const mnemonic_format formats[] = {
+    {0x00E0, "CLS"},            {0x00EE, "RET"},             {0x00C0, "SCD %n"},
+    {0x00FB, "SCR"},            {0x00FC, "SCL"},             {0x00FD, "EXIT"},
+    {0x00FE, "LOW"},            {0x00FF, "HIGH"},            {0x00D0, "SCU %n"},
+    {0x0000, "SYS %a"},         {0x1000, "JP %a"},           {0x2000, "CALL %a"},
+    {0x3000, "SE V%x, %b"},     {0x4000, "SNE V%x, %b"},     {0x5000, "SE V%x, V%y"},
+    {0x6000, "LD V%x, %b"},     {0x7000, "ADD V%x, %b"},     {0x8000, "LD V%x, V%y"},
+    {0x8001, "OR V%x, V%y"},    {0x8002, "AND V%x, V%y"},    {0x8003, "XOR V%x, V%y"},
+    {0x8004, "ADD V%x, V%y"},   {0x8005, "SUB V%x, V%y"},    {0x8006, "SHR V%x, V%y"},
+    {0x8007, "SUBN V%x, V%y"},  {0x800E, "SHL V%x, V%y"},    {0x9000, "SNE V%x, V%y"},
+    {0xA000, "LD I, %a"},       {0xB000, "JP V0, %a"},       {0xC000, "RND V%x, %b"},
+    {0xD000, "DRW V%x, V%y, %n"}, {0xE09E, "SKP V%x"},       {0xE0A1, "SKNP V%x"},
+    {0xF007, "LD V%x, DT"},     {0xF00A, "LD V%x, K"},       {0xF015, "LD DT, V%x"},
+    {0xF018, "LD ST, V%x"},     {0xF01E, "ADD I, V%x"},      {0xF029, "LD F, V%x"},
+    {0xF033, "LD B, V%x"},      {0xF055, "LD [I], V%x"},     {0xF065, "LD V%x, [I]"},
+    {0xF030, "LD HF, V%x"},     {0xF075, "LD R, V%x"},       {0xF085, "LD V%x, R"},
+    {0x5002, "SAVE V%x-V%y"},   {0x5003, "LOAD V%x-V%y"},    {0xF000, "LD I, %l"},
+    {0xF001, "PLANE %x"},       {0xF002, "AUDIO"},           {0xF03A, "PITCH V%x"},
+};
+// clang-format on
+
+/// Returns the bytes of the instruction with opcode_table pattern op
+u8 length_of(u16 op) {
+    return op == LONG_I_OPCODE ? 4 : 2;
+}
+
+/// Returns true for the skips, which continue at the next instruction or the one after
+bool is_skip(u16 op) {
+    switch (op) {
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x9000:
+    case 0xE09E:
+    case 0xE0A1:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+u16 disassembler::pattern(u16 opcode) {
+    usize index = chip8::instruction_index(opcode);
+    return index == MAX_INSTRUCTIONS ? INVALID_PATTERN : chip8::opcode_table[index]._opcode;
+}
+
+disassembler::disassembler() {
+    reset();
+}
+
+void disassembler::reset() {
+    _memory.fill(0);
+    _flags.assign(MEMORY_SIZE, 0);
+    _pending.assign(1, START_ADDR);
+    _rows.clear();
+    _dirty = true;
+    _stats = {};
+}
+
+void disassembler::explore() {
+    auto fetch = [&](usize addr) {
+        return static_cast<u16>(_memory[addr] << 8 | _memory[(addr + 1) % MEMORY_SIZE]);
+    };
+    auto target = [&](u16 addr, u8 flag) {
+        if (!(_flags[addr] & flag)) {
+            _flags[addr] |= flag;
+            _dirty = true;
+        }
+        _pending.push_back(addr);
+    };
+
+    while (!_pending.empty()) {
+        usize pc = _pending.back();
+        _pending.pop_back();
+
+        // straight-line until a path ends, branches queue their other successor
+        while (pc + 1 < MEMORY_SIZE && !(_flags[pc] & DISASM_HEAD)) {
+            u16 opcode = fetch(pc);
+            u16 op = pattern(opcode);
+            u8 length = length_of(op);
+            if (op == INVALID_PATTERN || opcode == 0 || pc + length > MEMORY_SIZE) {
+                break; // invalid, or the zero fill after a program: data
+            }
+
+            _flags[pc] |= DISASM_HEAD | (length == 4 ? DISASM_LONG : 0);
+            for (usize b = pc; b < pc + length; b++) {
+                _flags[b] |= DISASM_BODY;
+            }
+            _stats.instructions++;
+            _stats.decoded++;
+            _dirty = true;
+
+            usize next = pc + length;
+            if (op == 0x1000) {
+                target(get_nnn(opcode), DISASM_JUMP_TARGET);
+                break;
+            }
+            if (op == 0x2000) {
+                target(get_nnn(opcode), DISASM_CALL_TARGET);
+            } else if (op == 0x00EE || op == 0x00FD || op == 0xB000) {
+                break; // the target isn't known until it runs, pc roots pick it up then
+            } else if (is_skip(op) && next + 1 < MEMORY_SIZE) {
+                usize skipped = next + (fetch(next) == LONG_I_OPCODE ? 4 : 2);
+                if (skipped < MEMORY_SIZE) {
+                    _pending.push_back(static_cast<u16>(skipped));
+                }
+            }
+            pc = next;
+        }
+    }
+}
+
+void disassembler::invalidate(usize lo, usize hi) {
+    usize first = lo < 3 ? 0 : lo - 3;
+    for (usize addr = first; addr <= hi; addr++) {
+        u8 length = _flags[addr] & DISASM_LONG ? 4 : 2;
+        if (!(_flags[addr] & DISASM_HEAD) || addr + length <= lo) {
+            continue;
+        }
+        _flags[addr] &= ~(DISASM_HEAD | DISASM_LONG);
+        for (usize b = addr; b < addr + length; b++) {
+            _flags[b] &= ~DISASM_BODY;
+        }
+        _pending.push_back(static_cast<u16>(addr)); // still reached, decoded again
+        _stats.instructions--;
+        _stats.invalidated++;
+        _dirty = true;
+    }
+
+    // instructions overlapping the dropped ones keep their bytes
+    for (usize addr = first; addr <= std::min<usize>(hi + 3, MEMORY_SIZE - 1); addr++) {
+        if (_flags[addr] & DISASM_HEAD) {
+            usize length = _flags[addr] & DISASM_LONG ? 4 : 2;
+            usize end = std::min<usize>(addr + length, MEMORY_SIZE);
+            for (usize b = addr; b < end; b++) {
+                _flags[b] |= DISASM_BODY;
+            }
+        }
+    }
+}
+
+bool disassembler::update(const std::array<u8, MEMORY_SIZE>& memory, u16 pc) {
+    for (usize chunk = 0; chunk < MEMORY_SIZE; chunk += DISASM_CHUNK) {
+        if (!std::memcmp(&_memory[chunk], &memory[chunk], DISASM_CHUNK)) {
+            continue;
+        }
+        // each run of written bytes that touches code drops the instructions over it
+        for (usize addr = chunk; addr < chunk + DISASM_CHUNK; addr++) {
+            if (_memory[addr] == memory[addr]) {
+                continue;
+            }
+            usize end = addr;
+            bool code = false;
+            for (; end < chunk + DISASM_CHUNK && _memory[end] != memory[end]; end++) {
+                code |= _flags[end] & DISASM_BODY;
+                _memory[end] = memory[end];
+            }
+            if (code) {
+                invalidate(addr, end - 1);
+            }
+            addr = end;
+        }
+    }
+
+    if (!(_flags[pc] & DISASM_HEAD)) {
+        _pending.push_back(pc);
+    }
+    explore();
+    if (!_dirty) {
+        return false;
+    }
+    rebuild();
+    return true;
+}
+
+void disassembler::rebuild() {
+    _rows.clear();
+    for (usize addr = 0; addr < MEMORY_SIZE;) {
+        u8 flags = _flags[addr];
+        if (flags & (DISASM_CALL_TARGET | DISASM_JUMP_TARGET)) {
+            _rows.push_back({static_cast<u16>(addr), listing_row::kind::label, 0});
+        }
+        if (flags & DISASM_HEAD) {
+            u8 length = flags & DISASM_LONG ? 4 : 2;
+            _rows.push_back({static_cast<u16>(addr), listing_row::kind::instruction, length});
+            addr += length;
+            continue;
+        }
+
+        // data up to the next aligned row, instruction or label
+        usize end = addr + 1;
+        while (end < MEMORY_SIZE && end % DISASM_DATA_ROW &&
+               !(_flags[end] & (DISASM_HEAD | DISASM_CALL_TARGET | DISASM_JUMP_TARGET))) {
+            end++;
+        }
+        _rows.push_back({static_cast<u16>(addr), listing_row::kind::data,
+                         static_cast<u8>(end - addr)});
+        addr = end;
+    }
+    _stats.rebuilds++;
+    _dirty = false;
+}
+
+usize disassembler::row_of(u16 addr) const {
+    auto after = std::upper_bound(_rows.begin(), _rows.end(), addr,
+                                  [](u16 a, const listing_row& row) { return a < row._addr; });
+    return after == _rows.begin() ? 0 : after - _rows.begin() - 1;
+}
+
+bool disassembler::is_code(u16 addr) const {
+    return _flags[addr] & DISASM_HEAD;
+}
+
+std::string disassembler::text(const listing_row& row) const {
+    char line[64];
+    u16 addr = row._addr;
+    switch (row._kind) {
+    case listing_row::kind::label:
+        snprintf(line, sizeof(line),
+                 _flags[addr] & DISASM_CALL_TARGET ? "sub_%03X:" : "L_%03X:", addr);
+        return line;
+    case listing_row::kind::instruction: {
+        u16 opcode = _memory[addr] << 8 | _memory[addr + 1];
+        if (row._length == 4) {
+            u16 next = _memory[addr + 2] << 8 | _memory[addr + 3];
+            snprintf(line, sizeof(line), "%04X  %04X %04X  ", addr, opcode, next);
+            return line + mnemonic(opcode, next);
+        }
+        snprintf(line, sizeof(line), "%04X  %04X       ", addr, opcode);
+        return line + mnemonic(opcode);
+    }
+    case listing_row::kind::data:
+        break;
+    }
+
+    snprintf(line, sizeof(line), "%04X  DB   ", addr);
+    std::string out = line;
+    for (usize b = 0; b < row._length; b++) {
+        snprintf(line, sizeof(line), b ? ", 0x%02X" : "0x%02X", _memory[addr + b]);
+        out += line;
+    }
+    return out;
+}
+
+std::string disassembler::mnemonic(u16 opcode, u16 next) {
+    // formats in opcode_table order, so decoding stays a decode_table lookup
+    static const auto by_index = [] {
+        std::array<const char*, MAX_INSTRUCTIONS> out{};
+        for (const auto& f : formats) {
+            out[chip8::instruction_index(f._pattern)] = f._format;
+        }
+        return out;
+    }();
+
+    usize index = chip8::instruction_index(opcode);
+    char buf[16];
+    if (index == MAX_INSTRUCTIONS) {
+        snprintf(buf, sizeof(buf), "DW 0x%04X", opcode);
+        return buf;
+    }
+    const char* format = by_index[index];
+    if (!format) {
+        return chip8::instruction_name(index); // an instruction without a mnemonic yet
+    }
+
+    std::string out;
+    for (const char* c = format; *c; c++) {
+        if (*c != '%') {
+            out += *c;
+            continue;
+        }
+        switch (*++c) {
+        case 'x':
+            snprintf(buf, sizeof(buf), "%X", get_x(opcode));
+            break;
+        case 'y':
+            snprintf(buf, sizeof(buf), "%X", get_y(opcode));
+            break;
+        case 'n':
+            snprintf(buf, sizeof(buf), "%X", opcode & 0xF);
+            break;
+        case 'b':
+            snprintf(buf, sizeof(buf), "0x%02X", get_kk(opcode));
+            break;
+        case 'a':
+            snprintf(buf, sizeof(buf), "0x%03X", get_nnn(opcode));
+            break;
+        case 'l':
+            snprintf(buf, sizeof(buf), "0x%04X", next);
+            break;
+        }
+        out += buf;
+    }
+    return out;
+}
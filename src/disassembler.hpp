@@ -0,0 +1,94 @@
+#ifndef DISASSEMBLER_HPP
+#define DISASSEMBLER_HPP
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+#include "types.hpp"
+
+#define DISASM_DATA_ROW 8      // bytes per data row, rows start 8-byte aligned
+#define INVALID_PATTERN 0xFFFF // pattern() of opcodes that aren't in opcode_table
+
+/// One line of a disassembly listing
+struct listing_row {
+    enum class kind : u8 {
+        label,       // sub_XXX: (call target) or L_XXX: (jump target) before its instruction
+        instruction, // 2 bytes, 4 for F000 nnnn
+        data,        // up to DISASM_DATA_ROW bytes never reached as code
+    };
+    u16 _addr;
+    kind _kind;
+    u8 _length; // bytes, 0 for labels
+};
+
+/// Disassembler counters
+struct disasm_stats {
+    u32 instructions;  // currently known as code
+    u64 decoded;       // instructions decoded so far, re-decodes included
+    u64 invalidated;   // instructions dropped because a write hit their bytes
+    u64 rebuilds;      // times the listing was rebuilt
+};
+
+/// Recursive descent disassembler for the Code dock, incremental over memory writes
+/// Decodes with the interpreter's decode_table and follows control flow from START_ADDR:
+/// jumps and calls add their targets, skips both of their successors, returns, exits and
+/// computed jumps end a path. Everything never reached stays data. pc is added as a root
+/// on every update(), so code only reached through Bnnn or returns shows up once it runs.
+/// update() diffs memory against the image analyzed last, only the instructions covering
+/// written bytes are decoded again, and the listing is only rebuilt when code changed.
+class disassembler {
+  private:
+    std::array<u8, MEMORY_SIZE> _memory{}; // image the analysis describes
+    std::vector<u8> _flags;                // per byte, DISASM_* bits
+    std::vector<u16> _pending;             // roots not explored yet
+    std::vector<listing_row> _rows;
+    bool _dirty{true}; // code changed since _rows was built
+    disasm_stats _stats{};
+
+    /// Follows control flow from every pending root
+    void explore();
+
+    /// Forgets the instructions covering [lo, hi] and queues them to be decoded again
+    void invalidate(usize lo, usize hi);
+
+    /// Rebuilds _rows from _flags
+    void rebuild();
+
+    /// Returns the opcode_table pattern opcode decodes to, e.g. 0x8004 for 0x8124
+    static u16 pattern(u16 opcode);
+
+  public:
+    disassembler();
+
+    /// Forgets everything, the next update() analyzes memory from START_ADDR again
+    void reset();
+
+    /// Brings the analysis up to date with memory and adds pc as an entry point
+    /// Returns true if the listing's rows changed
+    bool update(const std::array<u8, MEMORY_SIZE>& memory, u16 pc);
+
+    const std::vector<listing_row>& rows() const {
+        return _rows;
+    }
+
+    /// Returns the index of the row holding addr
+    usize row_of(u16 addr) const;
+
+    /// Returns the text of a row: address, bytes and mnemonic, label or data bytes
+    std::string text(const listing_row& row) const;
+
+    /// Returns true if addr is the first byte of a known instruction
+    bool is_code(u16 addr) const;
+
+    disasm_stats stats() const {
+        return _stats;
+    }
+
+    /// Returns the mnemonic of opcode, e.g. "LD V1, 0x02", next is the word after it
+    /// (the address of F000 nnnn)
+    static std::string mnemonic(u16 opcode, u16 next = 0);
+};
+
+#endif
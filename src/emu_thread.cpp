@@ -0,0 +1,118 @@
+#include <chrono>
+
+#include "emu_thread.hpp"
+
+emu_thread::emu_thread(chip8& vm, scheduler& sched) : _vm(vm), _scheduler(sched) {
+}
+
+emu_thread::~emu_thread() {
+    stop();
+}
+
+void emu_thread::start() {
+    if (running()) {
+        return;
+    }
+    _scheduler.reset_clock();
+    _running = true;
+    _thread = std::thread(&emu_thread::loop, this);
+}
+
+void emu_thread::stop() {
+    _running = false;
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void emu_thread::set_key(u8 key, bool pressed) {
+    if (!_input.push({emu_input::kind::key, key, pressed})) {
+        _input_overflows.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void emu_thread::write_memory(u16 addr, u8 val) {
+    if (!_input.push({emu_input::kind::write_memory, addr, val})) {
+        _input_overflows.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void emu_thread::set_clock_hz(u32 hz) {
+    if (!_input.push({emu_input::kind::clock_hz, 0, hz})) {
+        _input_overflows.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void emu_thread::apply_input() {
+    emu_input in;
+    while (_input.pop(in)) {
+        switch (in._kind) {
+        case emu_input::kind::key:
+            _vm.set_key(static_cast<u8>(in._addr), in._value != 0);
+            break;
+        case emu_input::kind::write_memory:
+            _vm.write_memory(in._addr, static_cast<u8>(in._value));
+            break;
+        case emu_input::kind::clock_hz:
+            _scheduler.set_clock_hz(in._value);
+            break;
+        }
+    }
+}
+
+void emu_thread::publish() {
+    if (_vm.get_video_dirty()) {
+        _video_serial++;
+        _vm.clear_video_dirty();
+    }
+
+    emu_frame& f = _frames.back();
+    f._video = _vm.get_framebuffer();
+    f._video_serial = _video_serial;
+    f._memory = _vm.get_memory();
+    f._v = _vm.get_v();
+    f._i = _vm.get_i();
+    f._pc = _vm.get_pc();
+    f._sp = _vm.get_sp();
+    f._stack = _vm.get_stack();
+    f._delay_timer = _vm.get_delay_timer();
+    f._sound_timer = _vm.get_sound_timer();
+    f._keypad = _vm.get_keypad();
+    f._blocks = _vm.get_block_stats();
+    f._idle_skipped = _vm.get_idle_skipped();
+    f._frames = _scheduler.get_frames();
+    f._late_frames = _scheduler.get_dropped_frames();
+    if (const rewind_buffer* rewind = _scheduler.get_rewind()) {
+        f._rewind = rewind->stats();
+    }
+    f._profiling = _vm.get_profile() != nullptr;
+    if (f._profiling) {
+        f._profile = *_vm.get_profile();
+    }
+    f._debug_paused = _vm.debug_paused();
+    if (const debugger* dbg = _vm.get_debugger()) {
+        f._break = dbg->last_break();
+    }
+    _frames.publish();
+}
+
+void emu_thread::loop() {
+    using clock = std::chrono::steady_clock;
+
+    publish(); // the state at start, so a front end has something to show right away
+    auto last = clock::now();
+    while (_running.load(std::memory_order_relaxed)) {
+        apply_input();
+
+        auto now = clock::now();
+        std::chrono::duration<double> elapsed = now - last;
+        last = now;
+        if (_scheduler.advance(elapsed.count())) {
+            publish();
+        }
+
+        // nothing is due before the next frame boundary
+        double idle = _scheduler.time_to_next_frame();
+        std::this_thread::sleep_for(std::chrono::duration<double>(idle));
+    }
+}
@@ -0,0 +1,149 @@
+#ifndef EMU_THREAD_HPP
+#define EMU_THREAD_HPP
+
+#include <atomic>
+#include <thread>
+
+#include "chip8.hpp"
+#include "debugger.hpp"
+#include "profile.hpp"
+#include "rewind.hpp"
+#include "scheduler.hpp"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
+#include "types.hpp"
+
+#define INPUT_QUEUE_SIZE 256
+
+/// Everything a front end shows, copied out by the emulation thread after each frame
+struct emu_frame {
+    framebuffer _video{};
+    u64 _video_serial{}; // bumped whenever the display changed, upload when it differs
+    std::array<u8, MEMORY_SIZE> _memory{};
+    std::array<u8, TOTAL_REGISTERS> _v{};
+    u16 _i{};
+    u16 _pc{};
+    u8 _sp{};
+    std::array<u16, STACK_SIZE> _stack{};
+    u8 _delay_timer{};
+    u8 _sound_timer{};
+    std::array<u8, MAX_KEYS> _keypad{};
+    block_stats _blocks{};
+    u64 _idle_skipped{}; // instructions skipped in idle loops, see chip8::set_idle_skip()
+    u64 _frames{};      // scheduler frames run so far
+    u64 _late_frames{}; // frames the scheduler dropped to catch up after a stall
+    rewind_stats _rewind{}; // zero unless the scheduler records a rewind_buffer
+    bool _profiling{};      // _profile holds the chip8's counters
+    profile _profile{};
+    bool _debug_paused{}; // the debugger holds execution, _break says why
+    break_event _break{};
+};
+
+/// Input for the emulation thread, applied before its next frame
+struct emu_input {
+    enum class kind : u8 {
+        key,          // _addr = key, _value = pressed
+        write_memory, // _addr = address, _value = byte
+        clock_hz,     // _value = instructions per second
+    };
+    kind _kind;
+    u16 _addr;
+    u32 _value;
+};
+
+/// Runs a chip8 and its scheduler on a thread of their own
+/// Finished frames go out through a triple buffer and input comes in through an SPSC queue,
+/// so neither the emulator nor the front end ever waits on the other. Anything else must only
+/// touch the chip8 or scheduler while the thread is stopped, see paused().
+class emu_thread {
+  private:
+    chip8& _vm;
+    scheduler& _scheduler;
+    triple_buffer<emu_frame> _frames;
+    spsc_queue<emu_input, INPUT_QUEUE_SIZE> _input;
+    std::atomic<u64> _input_overflows{};
+    u64 _video_serial{};
+
+    std::thread _thread;
+    std::atomic<bool> _running{};
+
+    void loop();
+    void apply_input();
+    void publish();
+
+  public:
+    emu_thread(chip8& vm, scheduler& sched);
+    ~emu_thread();
+
+    emu_thread(const emu_thread&) = delete;
+    emu_thread& operator=(const emu_thread&) = delete;
+
+    /// Starts emulating from the current state of the chip8
+    void start();
+
+    /// Stops emulating, returns once the thread is done with the chip8
+    void stop();
+
+    bool running() const {
+        return _running.load(std::memory_order_relaxed);
+    }
+
+    /// Runs fn with the thread stopped, then restarts it if it was running
+    template <typename F> void paused(F&& fn) {
+        bool was_running = running();
+        stop();
+        fn();
+        if (was_running) {
+            start();
+        }
+    }
+
+    /// Publishes the chip8's current state, only while stopped (e.g. after restoring one)
+    void refresh() {
+        if (!running()) {
+            publish();
+        }
+    }
+
+    /// Queues a key change, never waits
+    void set_key(u8 key, bool pressed);
+
+    /// Queues a memory write, never waits
+    void write_memory(u16 addr, u8 val);
+
+    /// Queues a new emulation speed, never waits
+    void set_clock_hz(u32 hz);
+
+    /// Makes the newest published frame current, returns false if there was none since the
+    /// last call (the front end shows the same frame twice)
+    bool acquire_frame() {
+        return _frames.acquire();
+    }
+
+    /// The frame of the last acquire_frame()
+    const emu_frame& frame() const {
+        return _frames.front();
+    }
+
+    /// Frames published so far
+    u64 published_frames() const {
+        return _frames.published();
+    }
+
+    /// Frames replaced before the front end acquired them
+    u64 dropped_frames() const {
+        return _frames.dropped();
+    }
+
+    /// acquire_frame() calls that found no new frame
+    u64 duplicated_frames() const {
+        return _frames.duplicated();
+    }
+
+    /// Inputs lost because the queue was full
+    u64 input_overflows() const {
+        return _input_overflows.load(std::memory_order_relaxed);
+    }
+};
+
+#endif
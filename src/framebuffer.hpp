@@ -0,0 +1,103 @@
+#ifndef FRAMEBUFFER_HPP
+#define FRAMEBUFFER_HPP
+
+#include <algorithm>
+#include <array>
+
+#include "types.hpp"
+
+#define CHIP8_WIDTH 64
+#define CHIP8_HEIGHT 32
+#define SCHIP_WIDTH 128 // SUPER-CHIP hi-res mode
+#define SCHIP_HEIGHT 64
+#define FRAMEBUFFER_WORDS 2                        // u64s per scanline, SCHIP_WIDTH / 64
+#define FRAMEBUFFER_PLANES 2                       // XO-CHIP bitplanes
+#define ALL_PLANES ((1 << FRAMEBUFFER_PLANES) - 1) // plane mask selecting every plane
+#define DISPLAY_SIZE (SCHIP_WIDTH * SCHIP_HEIGHT) // pixels of the largest mode
+
+// RGBA8 texels for expand_framebuffer<u32>(), byte order R G B A on little-endian hosts
+#define TEXEL_ON 0xFFFFFFFFu  // white
+#define TEXEL_OFF 0xFF000000u // opaque black
+#define TEXEL_PLANE2 0xFF0055FFu // XO-CHIP pixels lit in the second plane only, orange
+#define TEXEL_BOTH 0xFF00AAFFu   // and in both planes, amber
+
+/// Display of up to FRAMEBUFFER_PLANES bitplanes, 64x32 or 128x64 in SUPER-CHIP hi-res mode
+/// Scanline y of a plane is the FRAMEBUFFER_WORDS u64s from row(y, plane), pixel x is bit
+/// (63 - x % 64) of word x / 64 so the leftmost pixel is the most significant bit, like
+/// sprite bytes. Lo-res only uses the first word of the first CHIP8_HEIGHT scanlines.
+/// CHIP-8 and SUPER-CHIP ROMs only draw to plane 0, XO-CHIP ones select planes with Fn01.
+struct framebuffer {
+    std::array<u64, FRAMEBUFFER_PLANES * SCHIP_HEIGHT * FRAMEBUFFER_WORDS> _rows{};
+    bool _hires{};
+
+    usize width() const {
+        return _hires ? SCHIP_WIDTH : CHIP8_WIDTH;
+    }
+
+    usize height() const {
+        return _hires ? SCHIP_HEIGHT : CHIP8_HEIGHT;
+    }
+
+    u64* row(usize y, usize plane = 0) {
+        return _rows.data() + (plane * SCHIP_HEIGHT + y) * FRAMEBUFFER_WORDS;
+    }
+
+    const u64* row(usize y, usize plane = 0) const {
+        return _rows.data() + (plane * SCHIP_HEIGHT + y) * FRAMEBUFFER_WORDS;
+    }
+
+    /// Turns every pixel of the planes in mask off, the mode stays
+    void clear(u8 planes = ALL_PLANES) {
+        for (usize plane = 0; plane < FRAMEBUFFER_PLANES; plane++) {
+            if (planes & (1 << plane)) {
+                std::fill(row(0, plane), row(SCHIP_HEIGHT, plane), 0);
+            }
+        }
+    }
+
+    /// Returns true if any pixel of plane is lit
+    bool plane_used(usize plane) const {
+        return std::any_of(row(0, plane), row(SCHIP_HEIGHT, plane), [](u64 w) { return w; });
+    }
+
+    bool operator==(const framebuffer&) const = default;
+};
+
+/// Returns true if pixel (x, y) is lit in plane
+inline bool get_pixel(const framebuffer& fb, usize x, usize y, usize plane = 0) {
+    return (fb.row(y, plane)[x / 64] >> (63 - x % 64)) & 1;
+}
+
+/// Expands fb into width() * height() values, row major, palette[p] for every pixel where
+/// p has bit n set if the pixel is lit in plane n. Composites the planes in one pass, so
+/// renderers upload a single texture whatever the planes in use.
+template <typename T>
+void expand_framebuffer(const framebuffer& fb, T* out, const std::array<T, 4>& palette) {
+    // a byte at a time, testing constant masks lets the compiler vectorise without per-lane
+    // variable shifts. Scanlines with nothing in plane 1 (every CHIP-8 one) take two colours.
+    for (usize y = 0; y < fb.height(); y++) {
+        const u64* plane0 = fb.row(y, 0);
+        const u64* plane1 = fb.row(y, 1);
+        bool mono = !(plane1[0] | plane1[1]);
+        for (usize b = 0; b < fb.width() / 8; b++) {
+            u32 lo = (plane0[b / 8] >> (56 - 8 * (b % 8))) & 0xFF;
+            if (mono) {
+                for (usize bit = 0; bit < 8; bit++) {
+                    *out++ = (lo & (0x80u >> bit)) ? palette[1] : palette[0];
+                }
+                continue;
+            }
+            u32 hi = (plane1[b / 8] >> (56 - 8 * (b % 8))) & 0xFF;
+            for (usize bit = 0; bit < 8; bit++) {
+                *out++ = palette[((lo << bit) >> 7 & 1) | ((hi << bit) >> 6 & 2)];
+            }
+        }
+    }
+}
+
+/// Expands fb with `on` for pixels lit in any plane and `off` otherwise
+template <typename T> void expand_framebuffer(const framebuffer& fb, T* out, T on, T off) {
+    expand_framebuffer<T>(fb, out, {off, on, on, on});
+}
+
+#endif
@@ -3,35 +3,288 @@
 #include "imgui-SFML.h"
 #include "imgui.h"
 #include "imgui_memory_editor.h"
+#include "profile.hpp"
 #include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <ctime>
 
 #ifdef _WIN32
 #include <Windows.h>
 #include <commdlg.h>
 #endif
 
-gui::gui(bool dbg)
+gui::gui(bool dbg, engine e, u32 clock_hz, u8 quirks)
     : _rom_loaded(false), _DEBUG_MODE(dbg),
       _window(screen_res_to_use<sf::VideoMode>(dbg), "CHIP-8 Emulator") {
+    _vm.set_engine(e);
+    _vm.set_quirks(quirks);
+    _vm.set_idle_skip(true); // same results, less host CPU at high clocks
+    _scheduler.set_clock_hz(clock_hz); // the emulation thread starts once a ROM is loaded
+    _scheduler.set_rewind(&_rewind);
+    _scheduler.set_audio(&_audio);
+    _speaker.play(); // silent until the emulation thread renders frames
     _window.setFramerateLimit(MAX_FPS);
     _window.setPosition(sf::Vector2i(0, 0));
     ImGui::SFML::Init(_window);
-    _texture.create(CHIP8_WIDTH * SCALE_FACTOR, CHIP8_HEIGHT * SCALE_FACTOR);
+    _screen.create(CHIP8_WIDTH, CHIP8_HEIGHT);
+    _screen.setSmooth(false); // keep pixels sharp when scaled up
 }
 
 gui::~gui() {
+    _emu.stop();
     ImGui::SFML::Shutdown();
 }
 
+void gui::load(const std::string& rom, const std::string& state) {
+    // TODO: clear everything from previous ROM
+    stop_movie();
+    _emu.stop();
+    _vm.load_rom(rom);
+    _rom_path = rom;
+    _rom_loaded = true;
+    _has_quick_state = false;
+    _rewinding = false;
+    _rewind.clear();
+    _disasm.reset();
+    _vm.debug().clear(); // the addresses meant something else in the previous ROM
+    _vm.debug().resume();
+    if (!state.empty()) {
+        _vm.load_state_from(state); // prints why on failure, the ROM then starts fresh
+    }
+    _emu.start();
+}
+
+void gui::record_movie() {
+    if (!_rom_loaded) {
+        return;
+    }
+    _emu.stop();
+    _vm.load_rom(_rom_path);
+    _rewind.clear();
+    _rewinding = false;
+    _scheduler.record_movie(_movie, static_cast<u64>(time(nullptr)));
+    _emu.start();
+}
+
+void gui::play_movie(const std::string& filename) {
+    if (!_rom_loaded || !load_movie(filename, _movie)) {
+        return;
+    }
+    _emu.stop();
+    _vm.load_rom(_rom_path);
+    _rewind.clear();
+    _rewinding = false;
+    _scheduler.play_movie(_movie);
+    _emu.start();
+}
+
+void gui::stop_movie() {
+    bool recording = false;
+    _emu.paused([&] {
+        recording = _scheduler.recording_movie();
+        _scheduler.stop_movie();
+    });
+    if (recording) {
+        save_movie(_rom_path + ".movie", _movie);
+    }
+}
+
+void gui::save_quick_state() {
+    if (!_rom_loaded) {
+        return;
+    }
+    _emu.paused([&] { _vm.snapshot(_quick_state); });
+    _has_quick_state = true;
+    write_save_state(_rom_path + ".state", _quick_state);
+}
+
+void gui::load_quick_state() {
+    if (!_rom_loaded) {
+        return;
+    }
+    stop_movie();
+    _emu.paused([&] {
+        if (!_has_quick_state || !_vm.restore(_quick_state)) {
+            _vm.load_state_from(_rom_path + ".state");
+        }
+    });
+}
+
+void gui::rewind_to(usize age) {
+    if (!_rom_loaded) {
+        return;
+    }
+    stop_movie();
+    _emu.stop();
+    if (!_rewinding) {
+        _rewinding = true;
+        _rewind_age = 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    save_state state;
+    if (_rewind.get(age, state)) {
+        _vm.restore(state);
+        _rewind_age = age;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    _rewind_latency = elapsed.count();
+    _emu.refresh();
+}
+
+void gui::resume_from_rewind() {
+    if (!_rewinding) {
+        return;
+    }
+    _rewind.truncate(_rewind_age); // the restored state stays as the newest one
+    _rewinding = false;
+    _emu.start();
+}
+
+void gui::profiler_dock() {
+    ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+
+    const auto& frame = _emu.frame();
+    bool enabled = frame._profiling;
+    if (ImGui::Checkbox("Enabled", &enabled)) {
+        _emu.paused([&] { _vm.set_profiling(enabled); });
+        _emu.refresh(); // stopped threads don't publish the change on their own
+    }
+    if (!frame._profiling) {
+        ImGui::TextWrapped("Counts every instruction per opcode and address, the emulator "
+                           "interprets while this is on");
+        ImGui::End();
+        return;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset")) {
+        _emu.paused([&] {
+            _vm.set_profiling(false);
+            _vm.set_profiling(true);
+        });
+        _emu.refresh();
+    }
+
+    const profile& p = frame._profile;
+    ImGui::Text("Instructions: %llu", static_cast<unsigned long long>(p._total));
+
+    // oldest frame first once the rings wrapped
+    int frames = static_cast<int>(std::min<u64>(p._frames, PROFILE_FRAMES));
+    int oldest = p._frames < PROFILE_FRAMES ? 0 : static_cast<int>(p._frames % PROFILE_FRAMES);
+    ImGui::PlotLines("Cycles/frame", p._frame_cycles.data(), frames, oldest, nullptr, 0.0f,
+                     FLT_MAX, ImVec2(0, 40));
+    ImGui::PlotLines("us/frame", p._frame_us.data(), frames, oldest, nullptr, 0.0f, FLT_MAX,
+                     ImVec2(0, 40));
+
+    double total = std::max<double>(static_cast<double>(p._total), 1.0);
+    auto table_flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV;
+
+    // hottest addresses, with the opcode currently there
+    static std::array<u16, MEMORY_SIZE> addrs; // the whole address space, kept off the stack
+    std::iota(addrs.begin(), addrs.end(), 0);
+    usize hot = std::min<usize>(16, addrs.size());
+    std::partial_sort(addrs.begin(), addrs.begin() + hot, addrs.end(),
+                      [&](u16 l, u16 r) { return p._pc_hits[l] > p._pc_hits[r]; });
+    if (ImGui::BeginTable("hot", 4, table_flags)) {
+        ImGui::TableSetupColumn("Address");
+        ImGui::TableSetupColumn("Opcode");
+        ImGui::TableSetupColumn("Hits");
+        ImGui::TableSetupColumn("%");
+        ImGui::TableHeadersRow();
+        for (usize idx = 0; idx < hot && p._pc_hits[addrs[idx]]; idx++) {
+            u16 addr = addrs[idx];
+            u16 opcode = frame._memory[addr] << 8 | frame._memory[(addr + 1) % MEMORY_SIZE];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%03X", addr);
+            ImGui::TableNextColumn();
+            ImGui::Text("%04X", opcode);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(p._pc_hits[addr]));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", 100.0 * p._pc_hits[addr] / total);
+        }
+        ImGui::EndTable();
+    }
+
+    // instruction mix, most executed first
+    std::array<usize, MAX_INSTRUCTIONS + 1> mix;
+    std::iota(mix.begin(), mix.end(), 0);
+    std::sort(mix.begin(), mix.end(),
+              [&](usize l, usize r) { return p._instructions[l] > p._instructions[r]; });
+    if (ImGui::BeginTable("mix", 3, table_flags)) {
+        ImGui::TableSetupColumn("Instruction");
+        ImGui::TableSetupColumn("Count");
+        ImGui::TableSetupColumn("%");
+        ImGui::TableHeadersRow();
+        for (usize idx = 0; idx < mix.size() && p._instructions[mix[idx]]; idx++) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", chip8::instruction_name(mix[idx]).c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(p._instructions[mix[idx]]));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", 100.0 * p._instructions[mix[idx]] / total);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+void gui::rewind_dock() {
+    ImGui::Begin("Rewind", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+
+    // the emulation thread owns _rewind while it runs, read its published counters then
+    rewind_stats stats = _rewinding ? _rewind.stats() : _emu.frame()._rewind;
+    double seconds = static_cast<double>(stats.states) / TIMER_HZ;
+    ImGui::Text("History: %.1f s, %llu states (%llu keyframes)", seconds,
+                static_cast<unsigned long long>(stats.states),
+                static_cast<unsigned long long>(stats.keyframes));
+    double per_second = seconds > 0 ? stats.bytes / 1024.0 / seconds : 0.0;
+    ImGui::Text("Memory: %.2f / %.2f MB, %.1f KB per second", stats.bytes / 1048576.0,
+                stats.capacity / 1048576.0, per_second);
+
+    if (!_rewinding) {
+        if (ImGui::Button("Rewind") && stats.states) {
+            rewind_to(0);
+        }
+    } else {
+        int age = static_cast<int>(_rewind_age);
+        int oldest = static_cast<int>(_rewind.size()) - 1;
+        if (ImGui::SliderInt("Frames back", &age, 0, std::max(oldest, 0))) {
+            rewind_to(static_cast<usize>(age));
+        }
+        ImGui::Text("Restored in %.1f us", _rewind_latency * 1e6);
+        if (ImGui::Button("Resume")) {
+            resume_from_rewind();
+        }
+    }
+
+    ImGui::End();
+}
+
 void gui::registers_dock() {
+    // the read-only widgets below want mutable pointers, so work on copies of the state
+    const auto& frame = _emu.frame();
+    auto regs = frame._v;
+    auto index = frame._i;
+    auto pc = frame._pc;
+    auto sp = frame._sp;
+    auto stack = frame._stack;
+    auto delay_timer = frame._delay_timer;
+    auto sound_timer = frame._sound_timer;
+
     // make some copies (used to determine if value changed so we change color)
-    static auto copy_of_v = _v;
-    static auto copy_of_i = _i;
-    static auto copy_of_pc = _pc;
-    static auto copy_of_sp = _sp;
-    static auto copy_of_stack = _stack;
-    static auto copy_of_delay_timer = _delay_timer;
-    static auto copy_of_sound_timer = _sound_timer;
+    static auto copy_of_v = regs;
+    static auto copy_of_i = index;
+    static auto copy_of_pc = pc;
+    static auto copy_of_sp = sp;
+    static auto copy_of_stack = stack;
+    static auto copy_of_delay_timer = delay_timer;
+    static auto copy_of_sound_timer = sound_timer;
 
     auto white = ImVec4(255.0f, 255.0f, 255.0f, 1.0f);
     auto red = ImVec4(255.0f, 0.0f, 0.0f, 1.0f);
@@ -43,7 +296,7 @@ void gui::registers_dock() {
     ImGui::AlignTextToFramePadding();
     ImGui::PushItemWidth(30.0f);
 
-    for (int i = 0; i < _v.size(); i++) {
+    for (int i = 0; i < regs.size(); i++) {
         if (i && !(i % 4)) {
             ImGui::NewLine();
         }
@@ -51,9 +304,9 @@ void gui::registers_dock() {
         char label[6];
         snprintf(label, sizeof(label), "##v%X", i);
         ImGui::Text(&label[2]);
-        ImGui::PushStyleColor(ImGuiCol_Text, copy_of_v[i] == _v[i] ? white : red);
+        ImGui::PushStyleColor(ImGuiCol_Text, copy_of_v[i] == regs[i] ? white : red);
         ImGui::SameLine();
-        ImGui::InputScalar(label, ImGuiDataType_U8, &_v[i], NULL, NULL, "%02X", flags);
+        ImGui::InputScalar(label, ImGuiDataType_U8, &regs[i], NULL, NULL, "%02X", flags);
         ImGui::SameLine();
         ImGui::PopStyleColor();
     }
@@ -63,57 +316,66 @@ void gui::registers_dock() {
     // delay timer
     ImGui::Text("DT");
     ImGui::SameLine();
-    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_delay_timer == _delay_timer ? white : red);
-    ImGui::InputScalar("##DT", ImGuiDataType_U8, &_delay_timer, NULL, NULL, "%02X", flags);
+    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_delay_timer == delay_timer ? white : red);
+    ImGui::InputScalar("##DT", ImGuiDataType_U8, &delay_timer, NULL, NULL, "%02X", flags);
     ImGui::PopStyleColor();
     ImGui::SameLine();
 
     // sound timer
     ImGui::Text("ST");
     ImGui::SameLine();
-    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_sound_timer == _sound_timer ? white : red);
-    ImGui::InputScalar("##ST", ImGuiDataType_U8, &_sound_timer, NULL, NULL, "%02X", flags);
+    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_sound_timer == sound_timer ? white : red);
+    ImGui::InputScalar("##ST", ImGuiDataType_U8, &sound_timer, NULL, NULL, "%02X", flags);
     ImGui::PopStyleColor();
     ImGui::SameLine();
 
     // stack pointer
     ImGui::Text("SP");
     ImGui::SameLine();
-    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_sp == _sp ? white : red);
-    ImGui::InputScalar("##SP", ImGuiDataType_U8, &_sp, NULL, NULL, "%02X", flags);
+    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_sp == sp ? white : red);
+    ImGui::InputScalar("##SP", ImGuiDataType_U8, &sp, NULL, NULL, "%02X", flags);
     ImGui::PopStyleColor();
     ImGui::SameLine();
 
     // index register
     ImGui::TextColored(white, " I");
     ImGui::SameLine();
-    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_i == _i ? white : red);
-    ImGui::InputScalar("##I", ImGuiDataType_U16, &_i, NULL, NULL, "%02X", flags);
+    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_i == index ? white : red);
+    ImGui::InputScalar("##I", ImGuiDataType_U16, &index, NULL, NULL, "%02X", flags);
     ImGui::PopStyleColor();
 
     // program counter
     ImGui::TextColored(white, "PC");
     ImGui::SameLine();
-    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_pc == _pc ? white : red);
-    ImGui::InputScalar("##PC", ImGuiDataType_U16, &_pc, NULL, NULL, "%X", flags);
+    ImGui::PushStyleColor(ImGuiCol_Text, copy_of_pc == pc ? white : red);
+    ImGui::InputScalar("##PC", ImGuiDataType_U16, &pc, NULL, NULL, "%X", flags);
     ImGui::PopStyleColor();
 
     ImGui::PopItemWidth();
     ImGui::End();
 
     // update copies
-    copy_of_v = _v;
-    copy_of_i = _i;
-    copy_of_pc = _pc;
-    copy_of_sp = _sp;
-    copy_of_stack = _stack;
-    copy_of_delay_timer = _delay_timer;
-    copy_of_sound_timer = _sound_timer;
+    copy_of_v = regs;
+    copy_of_i = index;
+    copy_of_pc = pc;
+    copy_of_sp = sp;
+    copy_of_stack = stack;
+    copy_of_delay_timer = delay_timer;
+    copy_of_sound_timer = sound_timer;
 }
 
 void gui::memory_dock() {
     static MemoryEditor mem_edit;
-    mem_edit.DrawWindow("Memory", &_memory, _memory.size());
+    static emu_thread* emu = nullptr;
+    emu = &_emu;
+    // edits are queued to the emulation thread, which applies them with write_memory() so
+    // cached blocks over the edited bytes are dropped; the editor shows the published copy
+    // and never writes through the data pointer itself
+    mem_edit.WriteFn = [](ImU8*, size_t off, ImU8 d) {
+        emu->write_memory(static_cast<u16>(off), d);
+    };
+    const auto& memory = _emu.frame()._memory;
+    mem_edit.DrawWindow("Memory", const_cast<u8*>(memory.data()), memory.size());
 }
 
 void gui::keypad_dock() {
@@ -122,10 +384,10 @@ void gui::keypad_dock() {
     for (usize idx = 0; const auto& k : {0x1, 0x2, 0x3, 0xC, 0x4, 0x5, 0x6, 0xD, 0x7, 0x8, 0x9,
                                          0xE, 0xA, 0x0, 0xB, 0xF}) {
         ImGui::PushID(k);
-        if (ImGui::Selectable(to_string(k).c_str(), _keypad[k] == 1, 0, ImVec2{50, 50})) {
-            _keypad[k] = 1;
-        } else {
-            _keypad[k] = 0;
+        bool pressed = _emu.frame()._keypad[k] == 1;
+        bool clicked = ImGui::Selectable(to_string(k).c_str(), pressed, 0, ImVec2{50, 50});
+        if (clicked != pressed) {
+            _emu.set_key(k, clicked);
         }
         ImGui::PopID();
         if (++idx % 4 != 0) {
@@ -138,21 +400,179 @@ void gui::keypad_dock() {
 
 void gui::code_dock() {
     ImGui::Begin("Code", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+    if (!_rom_loaded) {
+        ImGui::End();
+        return;
+    }
 
-    static char text[1024 * 16] = "/*\n"
-                                  " int main() {\n"
-                                  "   return 0;\n"
-                                  " }\n"
-                                  "label:\n"
-                                  "\tlock cmpxchg8b eax\n";
+    // only the instructions over bytes written since the last frame are decoded again
+    const auto& frame = _emu.frame();
+    _disasm.update(frame._memory, frame._pc);
+    const auto& rows = _disasm.rows();
+    auto stats = _disasm.stats();
 
-    static ImGuiInputTextFlags flags = ImGuiInputTextFlags_AllowTabInput;
-    ImGui::CheckboxFlags("ImGuiInputTextFlags_ReadOnly", &flags, ImGuiInputTextFlags_ReadOnly);
-    ImGui::CheckboxFlags("ImGuiInputTextFlags_AllowTabInput", &flags,
-                         ImGuiInputTextFlags_AllowTabInput);
-    ImGui::InputTextMultiline("##source", text, IM_ARRAYSIZE(text),
-                              ImVec2(-FLT_MIN, ImGui::GetTextLineHeight() * 16), flags);
+    // the emulation thread writes the debugger's run state, read that from the frame
+    if (frame._debug_paused) {
+        if (ImGui::Button("Continue")) {
+            _emu.paused([&] { _vm.debug().resume(); });
+        }
+    } else if (ImGui::Button("Pause")) {
+        _emu.paused([&] { _vm.debug().pause(_vm.get_pc()); });
+        _emu.refresh();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Step")) {
+        _emu.paused([&] { _vm.debug().single_step(_vm); });
+        _emu.refresh();
+    }
+    ImGui::SameLine();
+    if (frame._debug_paused) {
+        ImGui::Text("Stopped at 0x%03X (%s)", frame._break._pc,
+                    break_reason_name(frame._break._reason));
+    } else {
+        ImGui::Text("Running");
+    }
+    ImGui::Checkbox("Follow PC", &_follow_pc);
+    ImGui::SameLine();
+    ImGui::Text("%u instructions, %llu redecoded", stats.instructions,
+                static_cast<unsigned long long>(stats.invalidated));
+
+    ImGui::BeginChild("##listing");
+    usize pc_row = _disasm.row_of(frame._pc);
+    float line = ImGui::GetTextLineHeightWithSpacing();
+    if (_follow_pc && frame._pc != _listing_pc) {
+        float y = pc_row * line;
+        float top = ImGui::GetScrollY(), height = ImGui::GetWindowHeight();
+        if (y < top || y + line > top + height) {
+            ImGui::SetScrollY(y - height / 2);
+        }
+        _listing_pc = frame._pc;
+    }
 
+    // a 64 KB image is thousands of rows, only the visible ones are formatted and drawn
+    // breakpoints only change on this thread, under paused(), so they can be read directly
+    const debugger& dbg = _vm.debug();
+    const ImVec4 gray(0.6f, 0.6f, 0.6f, 1.0f);
+    const ImVec4 red(1.0f, 0.3f, 0.3f, 1.0f);
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(rows.size()), line);
+    while (clipper.Step()) {
+        for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; r++) {
+            const auto& row = rows[r];
+            bool data = row._kind == listing_row::kind::data;
+            bool code = row._kind == listing_row::kind::instruction;
+            bool breakpoint = code && dbg.has_breakpoint(row._addr);
+            if (data || breakpoint) {
+                ImGui::PushStyleColor(ImGuiCol_Text, breakpoint ? red : gray);
+            }
+            ImGui::PushID(r);
+            // a click toggles the breakpoint, the context menu runs up to the row
+            bool current = static_cast<usize>(r) == pc_row;
+            if (ImGui::Selectable(_disasm.text(row).c_str(), current) && code) {
+                _emu.paused([&] { _vm.debug().set_breakpoint(row._addr, !breakpoint); });
+            }
+            if (code && ImGui::BeginPopupContextItem()) {
+                if (ImGui::MenuItem("Run to cursor")) {
+                    _emu.paused([&] { _vm.debug().run_to(row._addr); });
+                }
+                ImGui::EndPopup();
+            }
+            ImGui::PopID();
+            if (data || breakpoint) {
+                ImGui::PopStyleColor();
+            }
+        }
+    }
+    ImGui::EndChild();
+    ImGui::End();
+}
+
+void gui::breakpoints_dock() {
+    ImGui::Begin("Breakpoints", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+    const debugger& dbg = _vm.debug(); // only changed below, with the thread stopped
+    auto hex = ImGuiInputTextFlags_CharsHexadecimal;
+
+    ImGui::Text("Addresses (click a row in Code to toggle)");
+    for (u16 addr : dbg.breakpoints()) {
+        ImGui::PushID(addr);
+        if (ImGui::SmallButton("x")) {
+            _emu.paused([&] { _vm.debug().set_breakpoint(addr, false); });
+        }
+        ImGui::SameLine();
+        ImGui::TextUnformatted(_disasm.text(_disasm.rows()[_disasm.row_of(addr)]).c_str());
+        ImGui::PopID();
+    }
+
+    ImGui::Separator();
+    ImGui::Text("Opcodes");
+    static u16 pattern = 0xD000, mask = 0xF000;
+    ImGui::PushItemWidth(60.0f);
+    ImGui::InputScalar("Pattern", ImGuiDataType_U16, &pattern, nullptr, nullptr, "%04X", hex);
+    ImGui::SameLine();
+    ImGui::InputScalar("Mask", ImGuiDataType_U16, &mask, nullptr, nullptr, "%04X", hex);
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (ImGui::Button("Add##opcode")) {
+        _emu.paused([&] { _vm.debug().add_opcode_breakpoint(pattern, mask); });
+    }
+    const auto& opcodes = dbg.opcode_breakpoints();
+    for (usize n = 0; n < opcodes.size(); n++) {
+        ImGui::PushID(static_cast<int>(n));
+        if (ImGui::SmallButton("x")) {
+            _emu.paused([&] { _vm.debug().remove_opcode_breakpoint(n); });
+            ImGui::PopID();
+            break;
+        }
+        ImGui::SameLine();
+        ImGui::Text("%04X & %04X", opcodes[n].first, opcodes[n].second);
+        ImGui::PopID();
+    }
+
+    ImGui::Separator();
+    ImGui::Text("Memory writes");
+    static u16 first = START_ADDR, last = START_ADDR;
+    ImGui::PushItemWidth(60.0f);
+    ImGui::InputScalar("From", ImGuiDataType_U16, &first, nullptr, nullptr, "%03X", hex);
+    ImGui::SameLine();
+    ImGui::InputScalar("To", ImGuiDataType_U16, &last, nullptr, nullptr, "%03X", hex);
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (ImGui::Button("Add##memory")) {
+        _emu.paused([&] { _vm.debug().watch_memory(first, last); });
+    }
+    const auto& watches = dbg.memory_watches();
+    for (usize n = 0; n < watches.size(); n++) {
+        ImGui::PushID(static_cast<int>(n) + 0x10000);
+        if (ImGui::SmallButton("x")) {
+            _emu.paused([&] { _vm.debug().remove_memory_watch(n); });
+            ImGui::PopID();
+            break;
+        }
+        ImGui::SameLine();
+        ImGui::Text("0x%03X-0x%03X", watches[n].first, watches[n].second);
+        ImGui::PopID();
+    }
+
+    ImGui::Separator();
+    ImGui::Text("Register changes");
+    for (u8 reg = 0; reg <= WATCH_I; reg++) {
+        if (reg % 6) {
+            ImGui::SameLine();
+        }
+        bool watched = dbg.watching_register(reg);
+        char name[4] = "I";
+        if (reg < WATCH_I) {
+            snprintf(name, sizeof(name), "V%X", reg);
+        }
+        if (ImGui::Checkbox(name, &watched)) {
+            _emu.paused([&] { _vm.debug().watch_register(reg, watched); });
+        }
+    }
+
+    ImGui::Separator();
+    if (ImGui::Button("Clear all")) {
+        _emu.paused([&] { _vm.debug().clear(); });
+    }
     ImGui::End();
 }
 
@@ -184,10 +604,106 @@ void gui::show_main_menu_bar() {
                     return;
                 }
 #endif
-                // TODO: clear everything from previous ROM
-                load_rom(fname);
-                _rom_loaded = true;
+                load(fname);
+            }
+            if (ImGui::MenuItem("Save state", "F5", false, _rom_loaded)) {
+                save_quick_state();
+            }
+            if (ImGui::MenuItem("Load state", "F9", false, _rom_loaded)) {
+                load_quick_state();
+            }
+            ImGui::Separator();
+            // the thread owns the scheduler, but only this thread starts and stops movies
+            bool recording = _scheduler.recording_movie();
+            if (ImGui::MenuItem(recording ? "Stop recording" : "Record movie", nullptr, false,
+                                _rom_loaded)) {
+                recording ? stop_movie() : record_movie();
+            }
+            if (ImGui::MenuItem("Play movie", nullptr, false, _rom_loaded && !recording)) {
+                play_movie(_rom_path + ".movie");
+            }
+            ImGui::EndMenu();
+        } else if (ImGui::BeginMenu("Engine")) {
+            engine current = _vm.get_engine();
+            // the emulation thread only reads these, change them with it stopped
+            if (ImGui::MenuItem("Interpreter", nullptr, current == engine::interpreter)) {
+                _emu.paused([&] { _vm.set_engine(engine::interpreter); });
+            }
+            if (ImGui::MenuItem("Cached blocks", nullptr, current == engine::cached)) {
+                _emu.paused([&] { _vm.set_engine(engine::cached); });
+            }
+            if (ImGui::MenuItem("JIT", nullptr, current == engine::jit, jit::available())) {
+                _emu.paused([&] { _vm.set_engine(engine::jit); });
+            }
+            if (ImGui::BeginMenu("Quirks")) {
+                u8 quirks = _vm.get_quirks(); // only this thread changes them
+                for (const char* preset : {"default", "vip", "schip"}) {
+                    u8 set = 0;
+                    parse_quirks(preset, set);
+                    if (ImGui::MenuItem(preset, nullptr, (quirks & ~QUIRK_WRAP) == set)) {
+                        set |= quirks & QUIRK_WRAP;
+                        _emu.paused([&] { _vm.set_quirks(set); });
+                    }
+                }
+                ImGui::Separator();
+                for (const char* name : {"shift_vy", "memory_i", "vf_reset", "jump_vx"}) {
+                    u8 bit = 0;
+                    parse_quirks(name, bit);
+                    if (ImGui::MenuItem(name, nullptr, quirks & bit)) {
+                        _emu.paused([&] { _vm.set_quirks(quirks ^ bit); });
+                    }
+                }
+                ImGui::EndMenu();
+            }
+            if (ImGui::MenuItem("Wrap sprites", nullptr, _vm.get_sprite_wrap())) {
+                _emu.paused([&] { _vm.set_sprite_wrap(!_vm.get_sprite_wrap()); });
+            }
+            if (ImGui::MenuItem("Skip idle loops", nullptr, _vm.get_idle_skip())) {
+                _emu.paused([&] { _vm.set_idle_skip(!_vm.get_idle_skip()); });
+            }
+#ifdef CHIP8_TRACE
+            // only this thread changes the ring, under paused()
+            bool tracing = _vm.get_trace() != nullptr;
+            if (ImGui::MenuItem("Trace instructions", nullptr, tracing)) {
+                _emu.paused([&] { _vm.set_trace(tracing ? 0 : TRACE_DEFAULT_CAPACITY); });
+            }
+            if (ImGui::MenuItem("Dump trace", nullptr, false, tracing && _rom_loaded)) {
+                _emu.paused([&] { _vm.get_trace()->dump(_rom_path + ".c8tr"); });
+            }
+#endif
+            // read before the first change, so the thread isn't writing the clock yet
+            static int ipf = static_cast<int>(_scheduler.get_instructions_per_frame());
+            if (ImGui::SliderInt("Instructions/frame", &ipf, 1, 1000)) {
+                _emu.set_clock_hz(static_cast<u32>(ipf) * TIMER_HZ);
+            }
+            const auto& frame = _emu.frame();
+            const auto& stats = frame._blocks;
+            ImGui::Separator();
+            ImGui::Text("Block hits: %llu", static_cast<unsigned long long>(stats.hits));
+            ImGui::Text("Block misses: %llu", static_cast<unsigned long long>(stats.misses));
+            ImGui::Text("Invalidations: %llu",
+                        static_cast<unsigned long long>(stats.invalidations));
+            ImGui::Text("Idle skipped: %llu",
+                        static_cast<unsigned long long>(frame._idle_skipped));
+            ImGui::Separator();
+            ImGui::Text("Frames: %llu (%llu late)",
+                        static_cast<unsigned long long>(frame._frames),
+                        static_cast<unsigned long long>(frame._late_frames));
+            ImGui::Text("Dropped: %llu",
+                        static_cast<unsigned long long>(_emu.dropped_frames()));
+            ImGui::Text("Duplicated: %llu",
+                        static_cast<unsigned long long>(_emu.duplicated_frames()));
+            ImGui::Separator();
+            bool sound = _speaker.getVolume() > 0;
+            if (ImGui::MenuItem("Sound", nullptr, sound)) {
+                _speaker.setVolume(sound ? 0.f : 100.f);
             }
+            auto audio = _audio.stats();
+            ImGui::Text("Audio latency: %.1f ms (max %.1f ms)", _speaker.latency() * 1000,
+                        audio.max_queued * 1000.0 / AUDIO_SAMPLE_RATE);
+            ImGui::Text("Underruns: %llu, overflows: %llu samples",
+                        static_cast<unsigned long long>(audio.underruns),
+                        static_cast<unsigned long long>(audio.overflows));
             ImGui::EndMenu();
         } else if (ImGui::MenuItem(_DEBUG_MODE ? "Normal mode" : "Debug Mode")) {
             _DEBUG_MODE = !_DEBUG_MODE;
@@ -204,21 +720,22 @@ void gui::draw_emulator(const ImGuiWindowFlags& flags) {
     if (!_DEBUG_MODE) // only create a new imgui container if not in debug mode
         ImGui::Begin("Game", nullptr, flags);
     if (_rom_loaded) {
-        run();
-        _texture.clear();
-        for (usize row = 0, idx = 0; idx < DISPLAY_SIZE; idx++) {
-            usize col = (idx % CHIP8_WIDTH);
-            sf::RectangleShape pixel(sf::Vector2f(SCALE_FACTOR, SCALE_FACTOR));
-            pixel.setPosition(col * SCALE_FACTOR, row * SCALE_FACTOR);
-            pixel.setFillColor(_video[idx] == 1 ? sf::Color::White : sf::Color::Black);
-            _texture.draw(pixel);
-
-            if ((idx + 1) % CHIP8_WIDTH == 0) {
-                row++;
+        // one upload of the whole display, only when cls/drw touched it since the last one
+        const auto& frame = _emu.frame();
+        if (frame._video_serial != _screen_serial) {
+            // the texture follows the display mode, 64x32 or 128x64 once a SUPER-CHIP ROM
+            // switches to hi-res, and is drawn at the same size either way
+            usize w = frame._video.width(), h = frame._video.height();
+            if (_screen.getSize() != sf::Vector2u(w, h)) {
+                _screen.create(w, h);
             }
+            expand_framebuffer<u32>(frame._video, _pixels.data(),
+                                    {TEXEL_OFF, TEXEL_ON, TEXEL_PLANE2, TEXEL_BOTH});
+            _screen.update(reinterpret_cast<const sf::Uint8*>(_pixels.data()));
+            _screen_serial = frame._video_serial;
         }
-        _texture.display();
-        ImGui::Image(_texture);
+        ImGui::Image(_screen,
+                     sf::Vector2f(CHIP8_WIDTH * SCALE_FACTOR, CHIP8_HEIGHT * SCALE_FACTOR));
     } else {
         ImGui::Text("No ROM loaded!");
     }
@@ -228,6 +745,7 @@ void gui::draw_emulator(const ImGuiWindowFlags& flags) {
 
 void gui::display() {
     _window.clear();
+    _emu.acquire_frame(); // every dock of this frame shows the same emulator frame
 
     show_main_menu_bar();
     if (!_DEBUG_MODE) {
@@ -247,6 +765,9 @@ void gui::display() {
         keypad_dock();
         emulator_dock();
         registers_dock();
+        profiler_dock();
+        rewind_dock();
+        breakpoints_dock();
     }
 
     // ImGui::ShowDemoWindow();
@@ -260,7 +781,8 @@ void gui::handle_events() {
         ImGui::SFML::ProcessEvent(_window, event);
         if (event.type == sf::Event::Closed) {
             _window.close();
-        } else if (event.type == sf::Event::KeyPressed || sf::Event::KeyReleased) {
+        } else if (event.type == sf::Event::KeyPressed ||
+                   event.type == sf::Event::KeyReleased) {
             // Keypad layout:
             // Keypad       Keyboard
             //+-+-+-+-+    +-+-+-+-+
@@ -276,53 +798,71 @@ void gui::handle_events() {
             switch (event.key.code) {
             default:
                 break;
+            case sf::Keyboard::Key::F5:
+                if (state) {
+                    save_quick_state();
+                }
+                break;
+            case sf::Keyboard::Key::F9:
+                if (state) {
+                    load_quick_state();
+                }
+                break;
+            case sf::Keyboard::Key::BackSpace:
+                // held: one frame further back per key repeat, released: play on from there
+                if (state) {
+                    rewind_to(_rewinding ? _rewind_age + 1 : 0);
+                } else {
+                    resume_from_rewind();
+                }
+                break;
             case sf::Keyboard::Key::Num1:
-                _keypad[1] = state;
+                _emu.set_key(1, state);
                 break;
             case sf::Keyboard::Key::Num2:
-                _keypad[2] = state;
+                _emu.set_key(2, state);
                 break;
             case sf::Keyboard::Key::Num3:
-                _keypad[3] = state;
+                _emu.set_key(3, state);
                 break;
             case sf::Keyboard::Key::Num4:
-                _keypad[0xC] = state;
+                _emu.set_key(0xC, state);
                 break;
             case sf::Keyboard::Key::Q:
-                _keypad[4] = state;
+                _emu.set_key(4, state);
                 break;
             case sf::Keyboard::Key::W:
-                _keypad[5] = state;
+                _emu.set_key(5, state);
                 break;
             case sf::Keyboard::Key::E:
-                _keypad[6] = state;
+                _emu.set_key(6, state);
                 break;
             case sf::Keyboard::Key::R:
-                _keypad[0xD] = state;
+                _emu.set_key(0xD, state);
                 break;
             case sf::Keyboard::Key::A:
-                _keypad[7] = state;
+                _emu.set_key(7, state);
                 break;
             case sf::Keyboard::Key::S:
-                _keypad[8] = state;
+                _emu.set_key(8, state);
                 break;
             case sf::Keyboard::Key::D:
-                _keypad[9] = state;
+                _emu.set_key(9, state);
                 break;
             case sf::Keyboard::Key::F:
-                _keypad[0xE] = state;
+                _emu.set_key(0xE, state);
                 break;
             case sf::Keyboard::Key::Z:
-                _keypad[0xA] = state;
+                _emu.set_key(0xA, state);
                 break;
             case sf::Keyboard::Key::X:
-                _keypad[0] = state;
+                _emu.set_key(0, state);
                 break;
             case sf::Keyboard::Key::C:
-                _keypad[0xB] = state;
+                _emu.set_key(0xB, state);
                 break;
             case sf::Keyboard::Key::V:
-                _keypad[0xF] = state;
+                _emu.set_key(0xF, state);
                 break;
             }
         }
@@ -1,22 +1,94 @@
 #ifndef GUI_HPP
 #define GUI_HPP
+#include "audio.hpp"
+#include "audio_sfml.hpp"
 #include "chip8.hpp"
+#include "debugger.hpp"
+#include "disassembler.hpp"
+#include "emu_thread.hpp"
+#include "movie.hpp"
+#include "rewind.hpp"
+#include "scheduler.hpp"
 #include "imgui.h"
 #include <SFML/Graphics.hpp>
 
 #define MAX_FPS 60
 
-class gui : public chip8 {
+// evil? maybe
+#define MONITOR_WIDTH sf::VideoMode::getDesktopMode().width - 128
+#define MONITOR_HEIGHT sf::VideoMode::getDesktopMode().height - 128
+
+/// Returns screen resolution to use
+/// This can be used for functions that either need sf::VideoMode or
+/// sf::Vector2u
+template <typename T> constexpr T screen_res_to_use(bool dbg) {
+    return dbg ? T(MONITOR_WIDTH, MONITOR_HEIGHT)
+               : T(CHIP8_WIDTH * SCALE_FACTOR + 30, CHIP8_HEIGHT * SCALE_FACTOR + 35);
+    // 30 and 35 are random values to make it look good
+}
+
+/// SFML + ImGui front end, drives a chip8 through its public API
+class gui {
   private:
+    chip8 _vm;
+    rewind_buffer _rewind;     // a state per frame, recorded by the scheduler
+    audio_stream _audio;       // rendered by the scheduler, played by _speaker
+    sfml_audio_sink _speaker{_audio};
+    scheduler _scheduler{_vm}; // emulation speed and 60 Hz timers, independent of MAX_FPS
+    emu_thread _emu{_vm, _scheduler}; // runs both, the docks only read its published frames
     bool _rom_loaded;
+    std::string _rom_path;
+    save_state _quick_state{}; // last state saved this session, restored without a file read
+    bool _has_quick_state{};
+    bool _rewinding{};       // emulation stopped on a state from _rewind
+    usize _rewind_age{};     // frames back from the newest recorded state
+    double _rewind_latency{}; // seconds the last rewind_to() took
+    movie _movie;             // being recorded or replayed by _scheduler
+    disassembler _disasm;     // Code dock listing, updated from the published memory
+    bool _follow_pc{true};    // Code dock scrolls to keep pc in view
+    u16 _listing_pc{};        // pc the Code dock last scrolled to
     bool _DEBUG_MODE;
     sf::RenderWindow _window;
-    sf::RenderTexture _texture;
+    std::array<u32, DISPLAY_SIZE> _pixels{}; // RGBA8, see TEXEL_ON/TEXEL_OFF
+    sf::Texture _screen;                     // display mode's size, scaled when drawn
+    u64 _screen_serial{~0ull};               // emu_frame::_video_serial of _screen
 
   public:
-    gui(bool dbg);
+    gui(bool dbg, engine e = engine::interpreter, u32 clock_hz = DEFAULT_CLOCK_HZ,
+        u8 quirks = 0);
     ~gui();
 
+    /// Loads rom and starts emulating it, resuming from the save state file `state` if given
+    void load(const std::string& rom, const std::string& state = "");
+
+    /// Saves the machine state to the quick slot and to `<rom>.state`
+    void save_quick_state();
+
+    /// Restores the quick slot, or `<rom>.state` if nothing was saved this session
+    void load_quick_state();
+
+    /// Restarts the ROM and records a movie of it until stop_movie()
+    void record_movie();
+
+    /// Restarts the ROM and replays the movie in filename
+    void play_movie(const std::string& filename);
+
+    /// Stops recording or replaying, a recording is saved to `<rom>.movie`
+    /// Called before anything that breaks the run a movie describes (states, rewinding)
+    void stop_movie();
+
+    /// Stops emulating and shows the state recorded `age` frames before the newest one
+    void rewind_to(usize age);
+
+    /// Drops the states newer than the one rewound to and emulates on from it
+    void resume_from_rewind();
+
+    /// Draws profiler dock, hottest addresses and instruction mix while profiling
+    void profiler_dock();
+
+    /// Draws rewind dock
+    void rewind_dock();
+
     /// Draws registers dock
     void registers_dock();
 
@@ -26,9 +98,13 @@ class gui : public chip8 {
     /// Draws keypad dock
     void keypad_dock();
 
-    /// Draws code dock
+    /// Draws code dock, the disassembly of memory with pc highlighted
     void code_dock();
 
+    /// Draws breakpoints dock, the addresses, opcodes, memory and registers that stop
+    /// execution
+    void breakpoints_dock();
+
     /// Draws the emulator window
     void emulator_dock();
 
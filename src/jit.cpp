@@ -0,0 +1,485 @@
+#include <cstring>
+
+#include "chip8.hpp"
+#include "jit.hpp"
+#include "utils.hpp"
+
+#if CHIP8_HAS_JIT
+#include <sys/mman.h>
+#endif
+
+// host registers, x86 encoding numbers
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3 // chip8 instance
+#define RBP 5 // I
+#define HOST_V_BASE 8 // V registers are cached in r8b-r15b
+#define HOST_V_SLOTS 8
+
+// condition codes for setcc/jcc
+#define CC_B 0x2
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_A 0x7
+
+// 8-bit ALU opcodes, op r/m8, r8
+#define OP_ADD 0x00
+#define OP_OR 0x08
+#define OP_AND 0x20
+#define OP_SUB 0x28
+#define OP_XOR 0x30
+#define OP_CMP 0x38
+#define OP_MOV 0x88
+
+// /digit extensions of 0x80, op r/m8, imm8
+#define EXT_ADD 0
+#define EXT_AND 4
+#define EXT_CMP 7
+
+namespace {
+
+/// Byte distance between a member and the instance that owns it
+template <typename T> s32 offset_in(const chip8& vm, const T& member) {
+    return static_cast<s32>(reinterpret_cast<const u8*>(&member) -
+                            reinterpret_cast<const u8*>(&vm));
+}
+
+/// REX prefix for an 8-bit operation, always emitted so r8b-r15b and al-dl encode the same way
+u8 rex(u8 reg, u8 rm) {
+    return 0x40 | ((reg >> 3) & 1) << 2 | ((rm >> 3) & 1);
+}
+
+} // namespace
+
+jit::jit(chip8& vm) : _vm(vm) {
+    _off_v = offset_in(vm, vm._v);
+    _off_i = offset_in(vm, vm._i);
+    _off_pc = offset_in(vm, vm._pc);
+    _off_dt = offset_in(vm, vm._delay_timer);
+    _off_st = offset_in(vm, vm._sound_timer);
+    _off_opcode = offset_in(vm, vm._opcode);
+    _off_generation = offset_in(vm, vm._blocks.generation());
+    _off_memory = offset_in(vm, vm._memory);
+
+#if CHIP8_HAS_JIT
+    void* mem = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    _code = mem == MAP_FAILED ? nullptr : static_cast<u8*>(mem);
+#endif
+}
+
+jit::~jit() {
+#if CHIP8_HAS_JIT
+    if (_code) {
+        munmap(_code, JIT_CODE_SIZE);
+    }
+#endif
+}
+
+void jit::reset() {
+    _used = 0;
+}
+
+void jit::emit(std::initializer_list<u8> bytes) {
+    _buf.insert(_buf.end(), bytes);
+}
+
+void jit::emit32(u32 val) {
+    emit({static_cast<u8>(val), static_cast<u8>(val >> 8), static_cast<u8>(val >> 16),
+          static_cast<u8>(val >> 24)});
+}
+
+void jit::rr8(u8 opc, u8 dst, u8 src) {
+    emit({rex(src, dst), opc, static_cast<u8>(0xC0 | (src & 7) << 3 | (dst & 7))});
+}
+
+void jit::ri8(u8 ext, u8 dst, u8 imm) {
+    emit({rex(0, dst), 0x80, static_cast<u8>(0xC0 | ext << 3 | (dst & 7)), imm});
+}
+
+void jit::mov_ri8(u8 dst, u8 imm) {
+    emit({rex(0, dst), static_cast<u8>(0xB0 | (dst & 7)), imm});
+}
+
+void jit::load8(u8 dst, s32 disp) {
+    // mov r8, [rbx + disp32]
+    emit({rex(dst, 0), 0x8A, static_cast<u8>(0x80 | (dst & 7) << 3 | RBX)});
+    emit32(disp);
+}
+
+void jit::store8(s32 disp, u8 src) {
+    // mov [rbx + disp32], r8
+    emit({rex(src, 0), 0x88, static_cast<u8>(0x80 | (src & 7) << 3 | RBX)});
+    emit32(disp);
+}
+
+void jit::store16_imm(s32 disp, u16 imm) {
+    // mov word [rbx + disp32], imm16
+    emit({0x66, 0xC7, 0x83});
+    emit32(disp);
+    emit({static_cast<u8>(imm), static_cast<u8>(imm >> 8)});
+}
+
+void jit::setcc(u8 cc, u8 dst) {
+    emit({rex(0, dst), 0x0F, static_cast<u8>(0x90 | cc), static_cast<u8>(0xC0 | (dst & 7))});
+}
+
+u8 jit::reg_v(u8 x, bool load) {
+    if (_slot_of[x] >= 0) {
+        _pinned |= 1 << _slot_of[x];
+        return HOST_V_BASE + _slot_of[x];
+    }
+
+    // pick a free slot, or evict round-robin (never a register of the current instruction)
+    s8 slot = -1;
+    for (u8 n = 0; n < HOST_V_SLOTS && slot < 0; n++) {
+        if (_owner[n] < 0) {
+            slot = n;
+        }
+    }
+    while (slot < 0) {
+        u8 candidate = _next_victim++ % HOST_V_SLOTS;
+        if (!(_pinned & (1 << candidate))) {
+            slot = candidate;
+        }
+    }
+
+    if (_owner[slot] >= 0) {
+        u8 victim = _owner[slot];
+        if (_dirty[victim]) {
+            store8(_off_v + victim, HOST_V_BASE + slot);
+        }
+        _slot_of[victim] = -1;
+        _dirty[victim] = false;
+    }
+
+    _owner[slot] = x;
+    _slot_of[x] = slot;
+    _pinned |= 1 << slot;
+    if (load) {
+        load8(HOST_V_BASE + slot, _off_v + x);
+    }
+    return HOST_V_BASE + slot;
+}
+
+u8 jit::def_v(u8 x) {
+    u8 reg = reg_v(x, false);
+    _dirty[x] = true;
+    return reg;
+}
+
+u8 jit::use_def_v(u8 x) {
+    u8 reg = reg_v(x);
+    _dirty[x] = true;
+    return reg;
+}
+
+void jit::load_i() {
+    if (_i_state == 0) {
+        // movzx ebp, word [rbx + disp32]
+        emit({0x0F, 0xB7, 0xAB});
+        emit32(_off_i);
+        _i_state = 1;
+    }
+}
+
+void jit::flush() {
+    for (u8 x = 0; x < _dirty.size(); x++) {
+        if (_dirty[x]) {
+            store8(_off_v + x, HOST_V_BASE + _slot_of[x]);
+            _dirty[x] = false;
+        }
+    }
+    if (_i_state == 2) {
+        // mov [rbx + disp32], bp
+        emit({0x66, 0x89, 0xAB});
+        emit32(_off_i);
+        _i_state = 1;
+    }
+}
+
+void jit::spill() {
+    flush();
+    _slot_of.fill(-1);
+    _owner.fill(-1);
+    _i_state = 0;
+}
+
+void jit::exit_with(u32 executed) {
+    // add dword [rsp + 8], executed ; sub dword [rsp + 4], executed ; jmp chain
+    emit({0x81, 0x44, 0x24, 0x08});
+    emit32(executed);
+    emit({0x81, 0x6C, 0x24, 0x04});
+    emit32(executed);
+    emit({0xE9});
+    _exit_jumps.push_back(_buf.size());
+    emit32(0);
+}
+
+void jit::call_handler(u16 addr, u16 opcode, void (*fn)(chip8&)) {
+    spill();
+    store16_imm(_off_pc, addr + 2);
+    store16_imm(_off_opcode, opcode);
+    // mov rdi, rbx ; mov rax, fn ; call rax
+    emit({0x48, 0x89, 0xDF, 0x48, 0xB8});
+    u64 target = reinterpret_cast<u64>(fn);
+    emit32(static_cast<u32>(target));
+    emit32(static_cast<u32>(target >> 32));
+    emit({0xFF, 0xD0});
+}
+
+bool jit::translate(const basic_block& block, u8 idx) {
+    const auto& insn = block._insns[idx];
+    u16 addr = block._start + idx * 2;
+    u16 op = insn._opcode;
+    u8 x = get_x(op), y = get_y(op), kk = get_kk(op);
+    u8 rx, ry;
+    _pinned = 0;
+
+    // skips: the next _pc is addr + 2 or addr + 4 depending on cond, then the block ends
+    // a skipped F000 nnnn takes two words, the block doesn't cover it so test it when taken
+    auto skip = [&](u8 jump_if_no_skip) {
+        store16_imm(_off_pc, addr + 2);
+        emit({static_cast<u8>(0x70 | jump_if_no_skip), 0x1D}); // over the taken path
+        store16_imm(_off_pc, addr + 4);
+        emit({0x66, 0x81, 0xBB}); // cmp word [rbx + disp32], 0xF000 as stored, big-endian
+        emit32(_off_memory + addr + 2);
+        emit({0xF0, 0x00, 0x75, 0x09}); // jne over the 9-byte store
+        store16_imm(_off_pc, addr + 6);
+        exit_with(idx + 1);
+        return false;
+    };
+
+    switch (op & 0xF000) {
+    case 0x0000:
+        if (!chip8::is_sys(op)) {
+            break; // cls, ret and the SUPER-CHIP display instructions
+        }
+        return true; // sys, ignored
+    case 0x1000: // jp
+        flush();
+        store16_imm(_off_pc, get_nnn(op));
+        exit_with(idx + 1);
+        return false;
+    case 0x3000: // seq_kk
+    case 0x4000: // sne_kk
+        rx = reg_v(x);
+        flush();
+        ri8(EXT_CMP, rx, kk);
+        return skip((op & 0xF000) == 0x3000 ? CC_NE : CC_E);
+    case 0x5000: // seq
+    case 0x9000: // sne
+        if (op & 0xF) {
+            break; // XO-CHIP 5xy2/5xy3
+        }
+        rx = reg_v(x);
+        ry = reg_v(y);
+        flush();
+        rr8(OP_CMP, rx, ry);
+        return skip((op & 0xF000) == 0x5000 ? CC_NE : CC_E);
+    case 0x6000: // ld_kk
+        mov_ri8(def_v(x), kk);
+        return true;
+    case 0x7000: // add_kk
+        ri8(EXT_ADD, use_def_v(x), kk);
+        return true;
+    case 0x8000:
+        // quirky logic ops and shifts run the handler compiled for the instance's quirks
+        if ((_vm._quirks & QUIRK_VF_RESET) && (op & 0xF) >= 0x1 && (op & 0xF) <= 0x3) {
+            break;
+        }
+        if ((_vm._quirks & QUIRK_SHIFT_VY) && ((op & 0xF) == 0x6 || (op & 0xF) == 0xE)) {
+            break;
+        }
+        switch (op & 0xF) {
+        case 0x0: // ld
+            ry = reg_v(y);
+            rr8(OP_MOV, def_v(x), ry);
+            break;
+        case 0x1: // logic_or
+        case 0x2: // logic_and
+        case 0x3: // logic_xor
+            ry = reg_v(y);
+            rx = use_def_v(x);
+            rr8((op & 0xF) == 1 ? OP_OR : (op & 0xF) == 2 ? OP_AND : OP_XOR, rx, ry);
+            break;
+        case 0x4: // add: sum = Vx + Vy ; VF = carry ; Vx = sum
+            rx = reg_v(x);
+            ry = reg_v(y);
+            emit({rex(RAX, rx), 0x0F, 0xB6, static_cast<u8>(0xC0 | (rx & 7))}); // movzx eax, rx
+            emit({rex(RCX, ry), 0x0F, 0xB6, static_cast<u8>(0xC8 | (ry & 7))}); // movzx ecx, ry
+            emit({0x01, 0xC8, 0x3D, 0xFF, 0x00, 0x00, 0x00}); // add eax, ecx ; cmp eax, 0xFF
+            setcc(CC_A, RDX);
+            rr8(OP_MOV, def_v(0xF), RDX);
+            rr8(OP_MOV, use_def_v(x), RAX);
+            break;
+        case 0x5: // sub: VF = Vx < Vy ; Vx -= Vy
+            rx = reg_v(x);
+            ry = reg_v(y);
+            rr8(OP_CMP, rx, ry);
+            setcc(CC_B, RAX);
+            rr8(OP_MOV, def_v(0xF), RAX);
+            rr8(OP_SUB, use_def_v(x), reg_v(y));
+            break;
+        case 0x6: // shr: VF = Vx & 1 ; Vx >>= 1
+            rx = reg_v(x);
+            rr8(OP_MOV, RAX, rx);
+            ri8(EXT_AND, RAX, 1);
+            rr8(OP_MOV, def_v(0xF), RAX);
+            rx = use_def_v(x);
+            emit({rex(0, rx), 0xD0, static_cast<u8>(0xE8 | (rx & 7))}); // shr rx, 1
+            break;
+        case 0x7: // subn: VF = Vy > Vx ; Vx = Vy - Vx
+            rx = reg_v(x);
+            ry = reg_v(y);
+            rr8(OP_CMP, ry, rx);
+            setcc(CC_A, RAX);
+            rr8(OP_MOV, def_v(0xF), RAX);
+            rr8(OP_MOV, RCX, reg_v(y));
+            rr8(OP_SUB, RCX, reg_v(x));
+            rr8(OP_MOV, use_def_v(x), RCX);
+            break;
+        case 0xE: // shl: VF = Vx >> 7 ; Vx <<= 1
+            rx = reg_v(x);
+            rr8(OP_MOV, RAX, rx);
+            emit({0x40, 0xC0, 0xE8, 0x07}); // shr al, 7
+            rr8(OP_MOV, def_v(0xF), RAX);
+            rx = use_def_v(x);
+            emit({rex(0, rx), 0xD0, static_cast<u8>(0xE0 | (rx & 7))}); // shl rx, 1
+            break;
+        }
+        return true;
+    case 0xA000: // ld_i
+        emit({0x66, 0xBD, static_cast<u8>(op), static_cast<u8>(get_nnn(op) >> 8)}); // mov bp
+        _i_state = 2;
+        return true;
+    case 0xF000:
+        switch (kk) {
+        case 0x07: // ld_vx_dt
+            load8(def_v(x), _off_dt);
+            return true;
+        case 0x15: // ld_dt
+            store8(_off_dt, reg_v(x));
+            return true;
+        case 0x18: // ld_st
+            store8(_off_st, reg_v(x));
+            return true;
+        case 0x1E: // add_i
+            rx = reg_v(x);
+            load_i();
+            emit({rex(RAX, rx), 0x0F, 0xB6, static_cast<u8>(0xC0 | (rx & 7))}); // movzx eax, rx
+            emit({0x66, 0x01, 0xC5}); // add bp, ax
+            _i_state = 2;
+            return true;
+        case 0x29: // ld_f
+            rx = reg_v(x);
+            emit({rex(RAX, rx), 0x0F, 0xB6, static_cast<u8>(0xC0 | (rx & 7))}); // movzx eax, rx
+            emit({0x8D, 0x2C, 0x80}); // lea ebp, [rax + rax * 4]
+            _i_state = 2;
+            return true;
+        }
+        break;
+    }
+
+    // everything else runs its regular handler
+    call_handler(addr, op, insn._fn);
+    if (insn._flags & OP_ENDS_BLOCK) {
+        exit_with(idx + 1);
+        return false;
+    }
+    if (insn._flags & OP_WRITES_MEMORY) {
+        // the store may have overwritten this block: compare the block cache generation
+        // with the one saved on entry and leave if it changed
+        emit({0x8B, 0x83}); // mov eax, [rbx + disp32]
+        emit32(_off_generation);
+        emit({0x3B, 0x04, 0x24, 0x74, 0x00}); // cmp eax, [rsp] ; je over the exit
+        usize over = _buf.size();
+        exit_with(idx + 1);
+        _buf[over - 1] = static_cast<u8>(_buf.size() - over);
+    }
+    return true;
+}
+
+native_block jit::compile(const basic_block& block) {
+    if (!_code) {
+        return nullptr;
+    }
+
+    _buf.clear();
+    _exit_jumps.clear();
+    _slot_of.fill(-1);
+    _owner.fill(-1);
+    _dirty.fill(false);
+    _i_state = 0;
+
+    // prologue: save callee-saved registers, rbx = chip8 instance,
+    // [rsp] = generation on entry, [rsp + 4] = cycles left, [rsp + 8] = cycles executed
+    emit({0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57}); // push rbx ... r15
+    emit({0x48, 0x83, 0xEC, 0x18, 0x48, 0x89, 0xFB}); // sub rsp, 24 ; mov rbx, rdi
+    emit({0x8B, 0x83}); // mov eax, [rbx + disp32]
+    emit32(_off_generation);
+    emit({0x89, 0x04, 0x24, 0x89, 0x74, 0x24, 0x04}); // mov [rsp], eax ; mov [rsp + 4], esi
+    emit({0xC7, 0x44, 0x24, 0x08, 0x00, 0x00, 0x00, 0x00}); // mov dword [rsp + 8], 0
+
+    // linked blocks jump here: leave if the whole block doesn't fit in the cycles left
+    usize body = _buf.size();
+    emit({0x81, 0x7C, 0x24, 0x04}); // cmp dword [rsp + 4], length
+    emit32(block._length);
+    emit({0x0F, 0x82}); // jb ret
+    usize bail = _buf.size();
+    emit32(0);
+
+    bool open = true;
+    for (u8 idx = 0; idx < block._length && open; idx++) {
+        open = translate(block, idx);
+    }
+    if (open) {
+        // ran off the end of a straight-line block
+        flush();
+        store16_imm(_off_pc, block._end);
+        exit_with(block._length);
+    }
+
+    // block linking: every exit stored the next _pc, continue straight into the block there
+    // if it was compiled too, otherwise go back to chip8::run_cached()
+    usize chain = _buf.size();
+    emit({0x0F, 0xB7, 0x83}); // movzx eax, word [rbx + disp32]
+    emit32(_off_pc);
+    emit({0x3D}); // cmp eax, MEMORY_SIZE
+    emit32(MEMORY_SIZE);
+    emit({0x73, 0x15, 0x48, 0xB9}); // jae ret ; mov rcx, links
+    u64 links = reinterpret_cast<u64>(_vm._blocks.links());
+    emit32(static_cast<u32>(links));
+    emit32(static_cast<u32>(links >> 32));
+    emit({0x48, 0x8B, 0x04, 0xC1}); // mov rax, [rcx + rax * 8]
+    emit({0x48, 0x85, 0xC0, 0x74, 0x02, 0xFF, 0xE0}); // test rax, rax ; jz ret ; jmp rax
+
+    usize ret = _buf.size();
+    emit({0x8B, 0x44, 0x24, 0x08}); // mov eax, [rsp + 8]
+    emit({0x48, 0x83, 0xC4, 0x18}); // add rsp, 24
+    emit({0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3}); // pop ... ret
+
+    for (usize site : _exit_jumps) {
+        u32 rel = static_cast<u32>(chain - (site + 4));
+        std::memcpy(&_buf[site], &rel, sizeof(rel));
+    }
+    u32 rel = static_cast<u32>(ret - (bail + 4));
+    std::memcpy(&_buf[bail], &rel, sizeof(rel));
+
+    if (_used + _buf.size() > JIT_CODE_SIZE) {
+        return nullptr;
+    }
+
+#if CHIP8_HAS_JIT
+    u8* dst = _code + _used;
+    mprotect(_code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE);
+    std::memcpy(dst, _buf.data(), _buf.size());
+    mprotect(_code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+    _used += (_buf.size() + 15) & ~usize{15};
+    _vm._blocks.link(block._start, dst + body);
+    return reinterpret_cast<native_block>(dst);
+#else
+    return nullptr;
+#endif
+}
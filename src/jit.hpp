@@ -0,0 +1,94 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include <array>
+#include <vector>
+
+#include "block_cache.hpp"
+#include "types.hpp"
+
+// the JIT emits x86-64 System V code, everything else keeps using the block cache
+#if defined(__x86_64__) && defined(__unix__)
+#define CHIP8_HAS_JIT 1
+#else
+#define CHIP8_HAS_JIT 0
+#endif
+
+#define JIT_CODE_SIZE (1024 * 1024)
+#define JIT_HOT_THRESHOLD 8 // block runs before it gets compiled
+
+class chip8;
+
+/// x86-64 dynamic recompiler for basic blocks
+/// Within a block V registers live in r8b-r15b and I in bp, _pc is a constant. Instructions
+/// without an inline translation call their regular chip8 handler. Compiled blocks jump
+/// straight into the next compiled block while the cycle budget allows.
+class jit {
+  private:
+    chip8& _vm;
+    u8* _code{};   // executable buffer, mapped RX except while a block is copied in
+    usize _used{}; // bytes of _code handed out
+
+    // offsets of the chip8 state the generated code touches, relative to the instance
+    s32 _off_v, _off_i, _off_pc, _off_dt, _off_st, _off_opcode, _off_generation, _off_memory;
+
+    // code generation state for the block being compiled
+    std::vector<u8> _buf;
+    std::array<s8, 16> _slot_of{};  // V index -> host register, -1 if not cached
+    std::array<s8, 8> _owner{};     // host register r8+n -> V index, -1 if free
+    std::array<bool, 16> _dirty{};  // V index cached and modified
+    u8 _next_victim{};              // round-robin eviction
+    u8 _pinned{};                   // slots used by the instruction being translated
+    u8 _i_state{};                  // 0 = in memory, 1 = cached in bp, 2 = cached and modified
+    std::vector<usize> _exit_jumps; // rel32 patch sites that jump to the block linking code
+
+    // emitter helpers
+    void emit(std::initializer_list<u8> bytes);
+    void emit32(u32 val);
+    void rr8(u8 opc, u8 dst, u8 src);
+    void ri8(u8 ext, u8 dst, u8 imm);
+    void mov_ri8(u8 dst, u8 imm);
+    void load8(u8 dst, s32 disp);
+    void store8(s32 disp, u8 src);
+    void store16_imm(s32 disp, u16 imm);
+    void setcc(u8 cc, u8 dst);
+
+    /// Returns the host register holding V[x], loading it when `load` is set
+    u8 reg_v(u8 x, bool load = true);
+    /// Returns a host register for V[x] that is about to be overwritten
+    u8 def_v(u8 x);
+    /// Returns the host register holding V[x], marked as modified
+    u8 use_def_v(u8 x);
+    void load_i();
+    /// Writes every modified cached register back to the chip8 instance
+    void flush();
+    /// Flushes, then forgets every cached register (before calling a handler)
+    void spill();
+
+    void exit_with(u32 executed);
+    void call_handler(u16 addr, u16 opcode, void (*fn)(chip8&));
+
+    /// Translates one instruction, returns false if the block ends after it
+    bool translate(const basic_block& block, u8 idx);
+
+  public:
+    explicit jit(chip8& vm);
+    ~jit();
+
+    jit(const jit&) = delete;
+    jit& operator=(const jit&) = delete;
+
+    /// Returns true if this build can generate native code
+    static bool available() {
+        return CHIP8_HAS_JIT;
+    }
+
+    /// Translates block into native code
+    /// Returns nullptr if the code buffer is full, call reset() and try again
+    native_block compile(const basic_block& block);
+
+    /// Forgets every generated block
+    void reset();
+};
+
+#endif
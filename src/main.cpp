@@ -1,26 +1,61 @@
 #include "chip8.hpp"
 #include "gui.hpp"
 #include <iostream>
+#include <memory>
 #include <string>
 
 int main(int argc, char** argv) {
     bool dbg_mode = false;
+    engine e = engine::interpreter;
+    u32 clock_hz = DEFAULT_CLOCK_HZ;
+    u8 quirks = 0;
+    std::string rom, state, replay;
     for (int i = 1; i < argc; ++i) {
         const std::string& arg = argv[i];
         if ((arg == "-d") || (arg == "--debug")) {
             dbg_mode = true;
+        } else if (((arg == "-e") || (arg == "--engine")) && i + 1 < argc &&
+                   parse_engine(argv[i + 1], e)) {
+            i++;
+        } else if (((arg == "-s") || (arg == "--speed")) && i + 1 < argc) {
+            clock_hz = static_cast<u32>(std::stoul(argv[++i]));
+        } else if (((arg == "-q") || (arg == "--quirks")) && i + 1 < argc &&
+                   parse_quirks(argv[i + 1], quirks)) {
+            i++;
+        } else if (((arg == "-r") || (arg == "--rom")) && i + 1 < argc) {
+            rom = argv[++i];
+        } else if (((arg == "-l") || (arg == "--load-state")) && i + 1 < argc) {
+            state = argv[++i];
+        } else if (((arg == "-p") || (arg == "--play")) && i + 1 < argc) {
+            replay = argv[++i];
         } else {
             std::cerr << "Usage: " << argv[0] << " <option(s)>"
                       << "Options:\n"
                       << "\t-h,--help\t\tShow this help message\n"
-                      << "\t-d,--debug\tSpecify if program starts in debug mode" << std::endl;
+                      << "\t-d,--debug\tSpecify if program starts in debug mode\n"
+                      << "\t-e,--engine <name>\tExecution engine (interpreter, cached, jit,\n"
+                      << "\t\t\taot)\n"
+                      << "\t-s,--speed <hz>\tInstructions per second (default: "
+                      << DEFAULT_CLOCK_HZ << ")\n"
+                      << "\t-q,--quirks <names>\tInterpreter quirks, e.g. vip or schip,wrap\n"
+                      << "\t-r,--rom <file>\tROM to start with\n"
+                      << "\t-l,--load-state <file>\tResume the ROM from a save state\n"
+                      << "\t-p,--play <file>\tReplay a movie of the ROM" << std::endl;
             return 0;
         }
     }
 
-    gui emu_gui{dbg_mode};
-    while (emu_gui.running()) {
-        emu_gui.handle_events();
-        emu_gui.display();
+    // on the heap, the machine and the frames shared with the emulation thread hold the
+    // whole 64 KB address space several times over
+    auto emu_gui = std::make_unique<gui>(dbg_mode, e, clock_hz, quirks);
+    if (!rom.empty()) {
+        emu_gui->load(rom, state);
+        if (!replay.empty()) {
+            emu_gui->play_movie(replay);
+        }
+    }
+    while (emu_gui->running()) {
+        emu_gui->handle_events();
+        emu_gui->display();
     }
 }
\ No newline at end of file
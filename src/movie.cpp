@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "movie.hpp"
+
+namespace {
+
+void put_le(std::vector<u8>& out, u64 val, usize bytes) {
+    for (usize byte = 0; byte < bytes; byte++, val >>= 8) {
+        out.push_back(val & 0xFF);
+    }
+}
+
+u64 get_le(const u8* in, usize bytes) {
+    u64 val = 0;
+    for (usize byte = bytes; byte-- > 0;) {
+        val = val << 8 | in[byte];
+    }
+    return val;
+}
+
+} // namespace
+
+u64 movie_rom_hash(const chip8& vm) {
+    u64 hash = 0xCBF29CE484222325;
+    for (u8 byte : vm.get_memory()) {
+        hash = (hash ^ byte) * 0x100000001B3;
+    }
+    return hash;
+}
+
+bool save_movie(const std::string& filename, const movie& m) {
+    std::vector<u8> out(MOVIE_MAGIC, MOVIE_MAGIC + 4);
+    put_le(out, MOVIE_VERSION, 2);
+    put_le(out, m._quirks, 2);
+    put_le(out, m._seed, 8);
+    put_le(out, m._clock_hz, 4);
+    put_le(out, 0, 4);
+    put_le(out, m._rom_hash, 8);
+    put_le(out, m._frames, 8);
+    put_le(out, m._events.size(), 8);
+
+    u64 last = 0;
+    for (const auto& e : m._events) {
+        for (u64 delta = e._frame - last;; delta >>= 7) {
+            out.push_back(static_cast<u8>(delta >= 0x80 ? (delta & 0x7F) | 0x80 : delta));
+            if (delta < 0x80) {
+                break;
+            }
+        }
+        put_le(out, e._keys, 2);
+        last = e._frame;
+    }
+
+    std::ofstream ofs(filename, std::ios_base::binary | std::ios_base::trunc);
+    ofs.write(reinterpret_cast<const char*>(out.data()), out.size());
+    if (!ofs) {
+        fprintf(stderr, "[-] can't write movie %s \n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool load_movie(const std::string& filename, movie& m) {
+    std::ifstream ifs(filename, std::ios_base::binary);
+    if (!ifs) {
+        fprintf(stderr, "[-] movie %s not found \n", filename.c_str());
+        return false;
+    }
+    std::vector<u8> in{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    if (in.size() < MOVIE_HEADER_SIZE || std::memcmp(in.data(), MOVIE_MAGIC, 4) ||
+        get_le(&in[4], 2) != MOVIE_VERSION) {
+        fprintf(stderr, "[-] %s is not a version %d movie \n", filename.c_str(),
+                MOVIE_VERSION);
+        return false;
+    }
+
+    m._quirks = static_cast<u16>(get_le(&in[6], 2));
+    m._seed = get_le(&in[8], 8);
+    m._clock_hz = static_cast<u32>(get_le(&in[16], 4));
+    m._rom_hash = get_le(&in[24], 8);
+    m._frames = get_le(&in[32], 8);
+    u64 count = get_le(&in[40], 8);
+
+    m._events.clear();
+    usize pos = MOVIE_HEADER_SIZE;
+    u64 frame = 0;
+    for (u64 n = 0; n < count; n++) {
+        u64 delta = 0;
+        unsigned shift = 0;
+        for (; pos < in.size() && shift < 64; shift += 7) {
+            u8 byte = in[pos++];
+            delta |= static_cast<u64>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        if (pos + 2 > in.size()) {
+            fprintf(stderr, "[-] movie %s is truncated \n", filename.c_str());
+            return false;
+        }
+        frame += delta;
+        m._events.push_back({frame, static_cast<u16>(get_le(&in[pos], 2))});
+        pos += 2;
+    }
+    return true;
+}
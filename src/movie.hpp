@@ -0,0 +1,44 @@
+#ifndef MOVIE_HPP
+#define MOVIE_HPP
+
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+#include "types.hpp"
+
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 2
+#define MOVIE_HEADER_SIZE 48
+
+/// The keypad from one frame on, one bit per key
+struct movie_event {
+    u64 _frame; // frames since the movie started
+    u16 _keys;
+};
+
+/// Input of a run from power-on, enough to replay it bit for bit on any engine
+/// Recorded and replayed by scheduler::record_movie() and scheduler::play_movie()
+///
+/// File layout, little-endian: magic, u16 version, u16 quirks, u64 seed, u32 clock,
+/// u32 reserved, u64 ROM hash, u64 frames, u64 event count, then per event the varint
+/// frame distance to the previous event and the u16 keypad.
+struct movie {
+    u64 _seed{};
+    u32 _clock_hz{};
+    u16 _quirks{}; // chip8::get_quirks() of the run
+    u64 _rom_hash{}; // movie_rom_hash() of the machine it was recorded on
+    u64 _frames{};   // length, the keypad of the last event holds until then
+    std::vector<movie_event> _events;
+};
+
+/// Returns the hash movies use to tell which ROM they were recorded on, FNV-1a of memory
+u64 movie_rom_hash(const chip8& vm);
+
+/// Writes m to filename, returns false and prints the error on failure
+bool save_movie(const std::string& filename, const movie& m);
+
+/// Reads filename into m, returns false and prints the error on failure
+bool load_movie(const std::string& filename, movie& m);
+
+#endif
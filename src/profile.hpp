@@ -0,0 +1,31 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <array>
+
+#include "chip8.hpp"
+#include "types.hpp"
+
+#define PROFILE_FRAMES 120 // frames of history kept for the per frame graphs
+
+/// Execution counters collected while profiling is enabled, see chip8::set_profiling()
+struct profile {
+    // per opcode_table entry, the extra last slot counts opcodes that aren't in the table
+    std::array<u64, MAX_INSTRUCTIONS + 1> _instructions{};
+    std::array<u64, MEMORY_SIZE> _pc_hits{}; // instructions fetched per address
+    u64 _total{};                            // instructions counted
+
+    // rings indexed by frame % PROFILE_FRAMES, filled by the scheduler
+    std::array<float, PROFILE_FRAMES> _frame_cycles{}; // instructions run per frame
+    std::array<float, PROFILE_FRAMES> _frame_us{};     // host microseconds per frame
+    u64 _frames{};
+
+    /// Records one frame of `cycles` instructions that took `seconds` of host time
+    void end_frame(usize cycles, double seconds) {
+        _frame_cycles[_frames % PROFILE_FRAMES] = static_cast<float>(cycles);
+        _frame_us[_frames % PROFILE_FRAMES] = static_cast<float>(seconds * 1e6);
+        _frames++;
+    }
+};
+
+#endif
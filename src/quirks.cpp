@@ -0,0 +1,58 @@
+#include <array>
+#include <sstream>
+
+#include "quirks.hpp"
+
+namespace {
+
+struct quirk_name {
+    const char* _name;
+    u8 _quirks;
+};
+
+// presets first, so quirks_name() prefers them
+const std::array<quirk_name, 8> quirk_names = {{
+    {"default", 0},
+    {"vip", QUIRK_SHIFT_VY | QUIRK_MEMORY_I | QUIRK_VF_RESET},
+    {"schip", QUIRK_JUMP_VX},
+    {"shift_vy", QUIRK_SHIFT_VY},
+    {"memory_i", QUIRK_MEMORY_I},
+    {"vf_reset", QUIRK_VF_RESET},
+    {"jump_vx", QUIRK_JUMP_VX},
+    {"wrap", QUIRK_WRAP},
+}};
+
+} // namespace
+
+bool parse_quirks(const std::string& names, u8& quirks) {
+    u8 parsed = 0;
+    std::istringstream ss(names);
+    for (std::string name; std::getline(ss, name, ',');) {
+        bool found = false;
+        for (const auto& q : quirk_names) {
+            if (name == q._name) {
+                parsed |= q._quirks;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    quirks = parsed;
+    return true;
+}
+
+std::string quirks_name(u8 quirks) {
+    std::string name;
+    for (const auto& q : quirk_names) {
+        // the largest names that fit first: a preset, then single quirks for what is left
+        if (q._quirks && (quirks & q._quirks) == q._quirks) {
+            name += name.empty() ? "" : ",";
+            name += q._name;
+            quirks &= ~q._quirks;
+        }
+    }
+    return name.empty() ? "default" : name;
+}
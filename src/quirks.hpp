@@ -0,0 +1,37 @@
+#ifndef QUIRKS_HPP
+#define QUIRKS_HPP
+
+#include <string>
+
+#include "types.hpp"
+
+// Behaviours that differ between CHIP-8 interpreters, one bit each
+// 0 is the behaviour this emulator always had
+#define QUIRK_SHIFT_VY 0x01 // shr/shl shift Vy into Vx (COSMAC VIP) instead of Vx in place
+#define QUIRK_MEMORY_I 0x02 // str_r/read_r leave I past the last register instead of alone
+#define QUIRK_VF_RESET 0x04 // or/and/xor clear VF
+#define QUIRK_JUMP_VX 0x08  // Bxnn jumps to xnn + Vx (SCHIP) instead of nnn + V0
+#define QUIRK_WRAP 0x10     // drw wraps sprites around the screen edges instead of clipping
+#define QUIRK_SETS 0x20     // every combination of the bits above
+
+/// A quirk set as a type, handlers instantiated with it test constants instead of flags
+/// so every set compiles into its own handlers without quirk branches, see chip8::set_quirks()
+template <u8 Q> struct quirk_policy {
+    static_assert(Q < QUIRK_SETS);
+    static constexpr u8 bits = Q;
+    static constexpr bool shift_vy = Q & QUIRK_SHIFT_VY;
+    static constexpr bool memory_i = Q & QUIRK_MEMORY_I;
+    static constexpr bool vf_reset = Q & QUIRK_VF_RESET;
+    static constexpr bool jump_vx = Q & QUIRK_JUMP_VX;
+    static constexpr bool wrap = Q & QUIRK_WRAP;
+};
+
+/// Parses a comma separated list of quirk and preset names, e.g. "vip" or "schip,wrap"
+/// Presets: default (no quirks), vip (shift_vy, memory_i, vf_reset), schip (jump_vx)
+/// Returns false if a name is unknown
+bool parse_quirks(const std::string& names, u8& quirks);
+
+/// Returns quirks as parse_quirks() reads them back, by preset name where one matches
+std::string quirks_name(u8 quirks);
+
+#endif
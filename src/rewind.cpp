@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cstring>
+
+#include "rewind.hpp"
+
+namespace {
+
+// zero bytes a literal run swallows rather than ending, a new run costs two header bytes
+#define REWIND_MAX_GAP 2
+
+const save_state zero_state{};
+
+u8* put_varint(u8* out, usize val) {
+    while (val >= 0x80) {
+        *out++ = static_cast<u8>(val | 0x80);
+        val >>= 7;
+    }
+    *out++ = static_cast<u8>(val);
+    return out;
+}
+
+const u8* get_varint(const u8* in, const u8* end, usize& val) {
+    val = 0;
+    for (unsigned shift = 0; in < end; shift += 7) {
+        u8 byte = *in++;
+        val |= static_cast<usize>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return in;
+}
+
+} // namespace
+
+usize rewind_encode(const save_state& cur, const save_state& base, u8* out) {
+    u8* start = out;
+    usize pos = 0, last = 0; // last = end of the previous run
+    while (pos < SAVE_STATE_SIZE) {
+        // skip equal bytes a chunk, then a word at a time, most of a delta is unchanged
+        // memory (64 KB of it with XO-CHIP's address space)
+        while (pos + 64 <= SAVE_STATE_SIZE && !std::memcmp(&cur[pos], &base[pos], 64)) {
+            pos += 64;
+        }
+        while (pos + 8 <= SAVE_STATE_SIZE) {
+            u64 l, r;
+            std::memcpy(&l, &cur[pos], 8);
+            std::memcpy(&r, &base[pos], 8);
+            if (l != r) {
+                break;
+            }
+            pos += 8;
+        }
+        while (pos < SAVE_STATE_SIZE && cur[pos] == base[pos]) {
+            pos++;
+        }
+        if (pos == SAVE_STATE_SIZE) {
+            break;
+        }
+
+        usize run = pos, gap = 0;
+        for (; pos < SAVE_STATE_SIZE && gap <= REWIND_MAX_GAP; pos++) {
+            gap = cur[pos] == base[pos] ? gap + 1 : 0;
+        }
+        usize end = pos - gap;
+
+        out = put_varint(out, run - last);
+        out = put_varint(out, end - run);
+        for (usize idx = run; idx < end; idx++) {
+            *out++ = cur[idx] ^ base[idx];
+        }
+        last = pos = end;
+    }
+    return static_cast<usize>(out - start);
+}
+
+void rewind_apply(const u8* in, usize size, save_state& state) {
+    const u8* end = in + size;
+    usize pos = 0;
+    while (in < end) {
+        usize skip, count;
+        in = get_varint(in, end, skip);
+        in = get_varint(in, end, count);
+        pos += skip;
+        count = std::min<usize>({count, static_cast<usize>(end - in), SAVE_STATE_SIZE - pos});
+        for (usize idx = 0; idx < count; idx++) {
+            state[pos + idx] ^= in[idx];
+        }
+        in += count;
+        pos += count;
+    }
+}
+
+rewind_buffer::rewind_buffer(usize capacity, usize keyframe_interval)
+    : _data(std::max<usize>(capacity, REWIND_MIN_CAPACITY)),
+      _keyframe_interval(std::max<usize>(keyframe_interval, 1)),
+      _scratch(2 * SAVE_STATE_SIZE) {
+}
+
+bool rewind_buffer::overlaps(usize offset, usize size) const {
+    if (_entries.empty()) {
+        return false;
+    }
+    usize head = _entries.front()._offset;
+    if (head < _tail) {
+        return offset < _tail && head < offset + size;
+    }
+    // wrapped (or exactly full), entries live in [head, end) and [0, _tail)
+    return offset + size > head || offset < _tail;
+}
+
+void rewind_buffer::evict_group() {
+    do {
+        _bytes -= _entries.front()._size;
+        if (_entries.front()._seq == _entries.front()._key_seq) {
+            _keyframes--;
+        }
+        _entries.pop_front();
+        _evicted++;
+    } while (!_entries.empty() && _entries.front()._seq != _entries.front()._key_seq);
+    if (_entries.empty()) {
+        _tail = 0;
+    }
+}
+
+void rewind_buffer::push(const save_state& state) {
+    bool key = _entries.empty() || _entries.back()._key_seq != _key_seq ||
+               _next_seq - _key_seq >= _keyframe_interval;
+
+    usize size, offset;
+    for (;;) {
+        size = rewind_encode(state, key ? zero_state : _key, _scratch.data());
+        for (;;) {
+            offset = _tail + size > _data.size() ? 0 : _tail; // entries never wrap
+            if (!overlaps(offset, size)) {
+                break;
+            }
+            evict_group();
+        }
+        // making room dropped the keyframe this delta was encoded against
+        if (!key && (_entries.empty() || _entries.front()._seq > _key_seq)) {
+            key = true;
+            continue;
+        }
+        break;
+    }
+
+    std::memcpy(&_data[offset], _scratch.data(), size);
+    _tail = offset + size;
+    if (key) {
+        _key = state;
+        _key_seq = _next_seq;
+        _keyframes++;
+    }
+    auto at = static_cast<u32>(offset);
+    _entries.push_back({_next_seq, _key_seq, at, static_cast<u32>(size)});
+    _next_seq++;
+    _bytes += size;
+}
+
+void rewind_buffer::record(const chip8& vm) {
+    vm.snapshot(_current);
+    push(_current);
+}
+
+bool rewind_buffer::get(usize age, save_state& state) const {
+    if (age >= _entries.size()) {
+        return false;
+    }
+    const entry& e = _entries[_entries.size() - 1 - age];
+    const entry& k = _entries[e._key_seq - _entries.front()._seq];
+    state.fill(0);
+    rewind_apply(&_data[k._offset], k._size, state);
+    if (&e != &k) {
+        rewind_apply(&_data[e._offset], e._size, state);
+    }
+    return true;
+}
+
+void rewind_buffer::truncate(usize count) {
+    for (; count && !_entries.empty(); count--) {
+        _bytes -= _entries.back()._size;
+        if (_entries.back()._seq == _entries.back()._key_seq) {
+            _keyframes--;
+        }
+        _entries.pop_back();
+    }
+    if (_entries.empty()) {
+        _tail = 0;
+    } else {
+        _tail = _entries.back()._offset + _entries.back()._size;
+        _next_seq = _entries.back()._seq + 1;
+    }
+}
+
+void rewind_buffer::clear() {
+    truncate(_entries.size());
+}
+
+rewind_stats rewind_buffer::stats() const {
+    return {_entries.size(), _keyframes, _bytes, _data.size(), _evicted};
+}
@@ -0,0 +1,100 @@
+#ifndef REWIND_HPP
+#define REWIND_HPP
+
+#include <deque>
+#include <vector>
+
+#include "chip8.hpp"
+#include "save_state.hpp"
+#include "types.hpp"
+
+#define REWIND_DEFAULT_CAPACITY (8u << 20) // bytes of encoded history
+#define REWIND_KEYFRAME_INTERVAL 60        // states per keyframe, one second of frames
+#define REWIND_MIN_CAPACITY (4 * SAVE_STATE_SIZE)
+
+/// Counters of a rewind_buffer
+struct rewind_stats {
+    u64 states;    // states held, the oldest is states - 1 frames back
+    u64 keyframes; // of those, how many are encoded on their own
+    u64 bytes;     // encoded bytes held
+    u64 capacity;  // byte budget
+    u64 evicted;   // states dropped to stay within the budget
+};
+
+/// History of save states, one pushed per frame, under a fixed memory budget
+/// Every REWIND_KEYFRAME_INTERVAL-th state is a keyframe, the others store their XOR
+/// against the keyframe before them. Both are run-length encoded, a state that
+/// differs from its keyframe in a few registers and sprite rows takes tens of bytes.
+/// Encoded states live in one byte ring that never straddles its end, when it is full the
+/// oldest keyframe and its deltas are dropped together. Any state decodes in two passes,
+/// its keyframe and its own delta, so scrubbing back by any distance costs the same.
+class rewind_buffer {
+  private:
+    struct entry {
+        u64 _seq;     // states pushed before this one
+        u64 _key_seq; // _seq of the keyframe this state is encoded against
+        u32 _offset;  // into _data
+        u32 _size;
+    };
+
+    std::vector<u8> _data;
+    std::deque<entry> _entries; // oldest first, _seq contiguous
+    usize _tail{};              // end of the newest entry in _data
+    usize _keyframe_interval;
+
+    save_state _key{}; // decoded keyframe new deltas are encoded against
+    u64 _key_seq{};
+    u64 _next_seq{};
+    save_state _current{}; // scratch of record()
+    std::vector<u8> _scratch;
+
+    u64 _bytes{};
+    u64 _keyframes{};
+    u64 _evicted{};
+
+    /// Returns true if [offset, offset + size) overlaps a held entry
+    bool overlaps(usize offset, usize size) const;
+
+    /// Drops the oldest keyframe and every delta encoded against it
+    void evict_group();
+
+  public:
+    explicit rewind_buffer(usize capacity = REWIND_DEFAULT_CAPACITY,
+                           usize keyframe_interval = REWIND_KEYFRAME_INTERVAL);
+
+    rewind_buffer(const rewind_buffer&) = delete;
+    rewind_buffer& operator=(const rewind_buffer&) = delete;
+
+    /// Appends state as the newest entry, evicting the oldest ones if it doesn't fit
+    void push(const save_state& state);
+
+    /// Snapshots vm and pushes it, see chip8::snapshot()
+    void record(const chip8& vm);
+
+    /// Decodes the state `age` entries before the newest one (0 = newest) into state
+    /// Returns false if there is no such entry
+    bool get(usize age, save_state& state) const;
+
+    /// Drops the `count` newest entries, e.g. to resume from a state that was rewound to
+    void truncate(usize count);
+
+    /// Drops every entry, counters are kept
+    void clear();
+
+    /// Returns how many states are held
+    usize size() const {
+        return _entries.size();
+    }
+
+    rewind_stats stats() const;
+};
+
+/// Run-length encodes cur XOR base into out, which must hold 2 * SAVE_STATE_SIZE bytes
+/// The encoding is a sequence of (varint zero bytes to skip, varint count, count bytes),
+/// returns how many bytes were written
+usize rewind_encode(const save_state& cur, const save_state& base, u8* out);
+
+/// XORs the runs of an encoding made by rewind_encode() into state
+void rewind_apply(const u8* in, usize size, save_state& state);
+
+#endif
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SAVE_STATE_MMAP
+#endif
+
+#include "chip8.hpp"
+#include "save_state.hpp"
+
+bool valid_save_state(const u8* data, usize size) {
+    if (!data || size < SAVE_STATE_SIZE) {
+        return false;
+    }
+    u16 version = data[SAVE_STATE_OFF_VERSION] | data[SAVE_STATE_OFF_VERSION + 1] << 8;
+    u32 stored = 0;
+    for (usize byte = 4; byte-- > 0;) {
+        stored = stored << 8 | data[SAVE_STATE_OFF_SIZE + byte];
+    }
+    // a stack pointer past the stack would make the next call or ret index out of _stack
+    return !std::memcmp(data + SAVE_STATE_OFF_MAGIC, SAVE_STATE_MAGIC, 4) &&
+           version == SAVE_STATE_VERSION && stored == SAVE_STATE_SIZE &&
+           data[SAVE_STATE_OFF_SP] <= STACK_SIZE;
+}
+
+bool write_save_state(const std::string& filename, const save_state& state) {
+    std::ofstream ofs(filename, std::ios_base::binary | std::ios_base::trunc);
+    if (!ofs) {
+        fprintf(stderr, "[-] can't write save state %s \n", filename.c_str());
+        return false;
+    }
+    ofs.write(reinterpret_cast<const char*>(state.data()), state.size());
+    if (!ofs) {
+        fprintf(stderr, "[-] can't write save state %s \n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+save_state_file::save_state_file(const std::string& filename) {
+#ifdef SAVE_STATE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (base != MAP_FAILED) {
+                _mapping = base;
+                _data = static_cast<const u8*>(base);
+                _size = static_cast<usize>(st.st_size);
+            }
+        }
+        close(fd); // the mapping stays valid
+    }
+    if (_mapping) {
+        return;
+    }
+#endif
+
+    std::ifstream ifs(filename, std::ios_base::binary);
+    if (!ifs) {
+        fprintf(stderr, "[-] save state %s not found \n", filename.c_str());
+        return;
+    }
+    ifs.read(reinterpret_cast<char*>(_buffer.data()), _buffer.size());
+    _data = _buffer.data();
+    _size = static_cast<usize>(ifs.gcount());
+}
+
+save_state_file::~save_state_file() {
+#ifdef SAVE_STATE_MMAP
+    if (_mapping) {
+        munmap(_mapping, _size);
+    }
+#endif
+}
@@ -0,0 +1,77 @@
+#ifndef SAVE_STATE_HPP
+#define SAVE_STATE_HPP
+
+#include <array>
+#include <string>
+
+#include "types.hpp"
+
+#define SAVE_STATE_MAGIC "C8ST"
+#define SAVE_STATE_VERSION 4
+
+// save state layout, every multi-byte value little-endian, memory last so the small fields
+// keep their offsets whatever the address space
+#define SAVE_STATE_OFF_MAGIC 0     // 4 bytes
+#define SAVE_STATE_OFF_VERSION 4   // u16
+#define SAVE_STATE_OFF_SIZE 6      // u32, SAVE_STATE_SIZE of the writing version
+#define SAVE_STATE_OFF_V 10        // TOTAL_REGISTERS bytes
+#define SAVE_STATE_OFF_I 26        // u16
+#define SAVE_STATE_OFF_PC 28       // u16
+#define SAVE_STATE_OFF_SP 30       // u8
+#define SAVE_STATE_OFF_DT 31       // u8
+#define SAVE_STATE_OFF_ST 32       // u8
+#define SAVE_STATE_OFF_HIRES 33    // u8, 1 in SUPER-CHIP 128x64 mode
+#define SAVE_STATE_OFF_PLANES 34   // u8, XO-CHIP plane mask
+#define SAVE_STATE_OFF_PITCH 35    // u8, XO-CHIP pitch register
+#define SAVE_STATE_OFF_STACK 36    // STACK_SIZE u16
+#define SAVE_STATE_OFF_KEYPAD 68   // MAX_KEYS bytes
+#define SAVE_STATE_OFF_RNG 84      // u64, rnd's generator state
+#define SAVE_STATE_OFF_RPL 92      // RPL_REGISTERS bytes
+#define SAVE_STATE_OFF_AUDIO 108   // AUDIO_PATTERN_SIZE bytes
+#define SAVE_STATE_OFF_VIDEO 124   // u64s of framebuffer::_rows, every plane
+#define SAVE_STATE_OFF_MEMORY 2172 // MEMORY_SIZE bytes
+#define SAVE_STATE_SIZE 67708
+
+/// One chip8 snapshot in the binary save state format, see chip8::snapshot()
+/// Fixed size and allocation free, so taking one every frame costs a few copies
+using save_state = std::array<u8, SAVE_STATE_SIZE>;
+
+/// Returns true if data starts with a save state header this version can restore and a
+/// stack pointer within the stack
+bool valid_save_state(const u8* data, usize size);
+
+/// Writes a save state to filename, returns false and prints the error on failure
+bool write_save_state(const std::string& filename, const save_state& state);
+
+/// Read-only view of a save state file, memory mapped where the host supports it so
+/// restoring at startup reads straight from the page cache
+class save_state_file {
+  private:
+    const u8* _data{};
+    usize _size{};
+    void* _mapping{}; // base of the mapping, nullptr when the file was read into _buffer
+    save_state _buffer{};
+
+  public:
+    /// Opens filename, prints the error and leaves the view empty on failure
+    explicit save_state_file(const std::string& filename);
+    ~save_state_file();
+
+    save_state_file(const save_state_file&) = delete;
+    save_state_file& operator=(const save_state_file&) = delete;
+
+    /// Returns true if the file holds a save state this version can restore
+    bool valid() const {
+        return valid_save_state(_data, _size);
+    }
+
+    const u8* data() const {
+        return _data;
+    }
+
+    usize size() const {
+        return _size;
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+
+#include <chrono>
+#include <cstdio>
+
+#include "audio.hpp"
+#include "movie.hpp"
+#include "profile.hpp"
+#include "rewind.hpp"
+#include "scheduler.hpp"
+
+scheduler::scheduler(chip8& vm, u32 clock_hz) : _vm(vm), _clock_hz(clock_hz) {
+}
+
+void scheduler::set_clock_hz(u32 hz) {
+    _clock_hz = std::max<u32>(hz, 1);
+    _cycle_carry = 0;
+}
+
+void scheduler::record_movie(movie& m, u64 seed) {
+    _vm.set_seed(seed);
+    set_clock_hz(_clock_hz); // drop the carry, replays start without one too
+    m = movie{seed, _clock_hz, _vm.get_quirks(), movie_rom_hash(_vm), 0, {}};
+    _playing = nullptr;
+    _recording = &m;
+    _movie_start = _frames;
+}
+
+bool scheduler::play_movie(const movie& m) {
+    if (movie_rom_hash(_vm) != m._rom_hash) {
+        fprintf(stderr, "[-] the movie was recorded on another ROM \n");
+        return false;
+    }
+    _vm.set_seed(m._seed);
+    _vm.set_quirks(static_cast<u8>(m._quirks));
+    set_clock_hz(m._clock_hz);
+    _recording = nullptr;
+    _playing = &m;
+    _movie_start = _frames;
+    _movie_cursor = 0;
+    _movie_keys = 0;
+    return true;
+}
+
+void scheduler::stop_movie() {
+    _recording = nullptr;
+    _playing = nullptr;
+}
+
+void scheduler::movie_frame() {
+    u64 frame = _frames - _movie_start;
+    const auto& keypad = _vm.get_keypad();
+
+    if (_recording) {
+        u16 keys = 0;
+        for (usize key = 0; key < MAX_KEYS; key++) {
+            keys |= (keypad[key] ? 1 : 0) << key;
+        }
+        auto& events = _recording->_events;
+        if (events.empty() ? keys != 0 : events.back()._keys != keys) {
+            events.push_back({frame, keys});
+        }
+        _recording->_frames = frame + 1;
+        return;
+    }
+
+    if (frame >= _playing->_frames) {
+        _playing = nullptr; // over, live input takes the keypad back
+        return;
+    }
+    const auto& events = _playing->_events;
+    for (; _movie_cursor < events.size() && events[_movie_cursor]._frame <= frame;
+         _movie_cursor++) {
+        _movie_keys = events[_movie_cursor]._keys;
+    }
+    for (usize key = 0; key < MAX_KEYS; key++) {
+        _vm.set_key(static_cast<u8>(key), (_movie_keys >> key) & 1);
+    }
+}
+
+usize scheduler::run_frame() {
+    if (_vm.debug_paused()) {
+        return 0; // stopped at a break, no emulated time passes until it resumes
+    }
+    if (_recording || _playing) {
+        movie_frame();
+    }
+
+    // clocks that aren't a multiple of TIMER_HZ spread the remainder over the frames
+    _cycle_carry += _clock_hz;
+    usize cycles = _cycle_carry / TIMER_HZ;
+    _cycle_carry %= TIMER_HZ;
+
+    usize done;
+    if (profile* p = _vm.get_profile()) {
+        auto start = std::chrono::steady_clock::now();
+        done = _vm.step(cycles);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        p->end_frame(done, elapsed.count());
+    } else {
+        done = _vm.step(cycles);
+    }
+    if (_audio) {
+        _audio->render_frame(_vm); // the beep lasts as long as the sound timer is nonzero
+    }
+    _vm.tick_timers();
+    _frames++;
+    if (_rewind) {
+        _rewind->record(_vm);
+    }
+    return done;
+}
+
+u32 scheduler::advance(double seconds) {
+    const double frame = 1.0 / TIMER_HZ;
+    _accumulator += std::max(seconds, 0.0);
+
+    u32 ran = 0;
+    while (_accumulator >= frame && ran < SCHEDULER_MAX_CATCH_UP) {
+        run_frame();
+        _accumulator -= frame;
+        ran++;
+    }
+
+    // too far behind (breakpoint, window drag...), drop the backlog instead of spiralling
+    if (_accumulator >= frame) {
+        _dropped += static_cast<u64>(_accumulator / frame);
+        _accumulator = std::fmod(_accumulator, frame);
+    }
+    return ran;
+}
@@ -0,0 +1,130 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "chip8.hpp"
+#include "types.hpp"
+
+#define TIMER_HZ 60              // delay and sound timer rate, also one emulated frame
+#define DEFAULT_CLOCK_HZ 600     // instructions per second, 10 per frame
+#define SCHEDULER_MAX_CATCH_UP 5 // frames one advance() may run, the rest of a stall is lost
+
+class audio_stream;
+class rewind_buffer;
+struct movie;
+
+/// Drives a chip8 at a fixed timestep, independent of how often the host renders
+/// Emulated time is cut into 1/TIMER_HZ frames, each frame runs the instructions due at the
+/// configured clock then ticks the timers once. advance() turns host time into frames with
+/// an accumulator, so a 144 Hz display and a 30 Hz one emulate at the same speed.
+class scheduler {
+  private:
+    chip8& _vm;
+    u32 _clock_hz;
+    u32 _cycle_carry{};    // clock remainder carried to the next frame, in 1/TIMER_HZ units
+    double _accumulator{}; // host seconds not emulated yet
+    u64 _frames{};
+    u64 _dropped{}; // frames skipped because advance() fell too far behind
+    rewind_buffer* _rewind{};
+    audio_stream* _audio{};
+
+    // movie being recorded or replayed, frames count from _movie_start
+    movie* _recording{};
+    const movie* _playing{};
+    u64 _movie_start{};
+    usize _movie_cursor{};
+    u16 _movie_keys{};
+
+    /// Records or replays the keypad of the frame about to run
+    void movie_frame();
+
+  public:
+    explicit scheduler(chip8& vm, u32 clock_hz = DEFAULT_CLOCK_HZ);
+
+    /// Sets the emulated CPU speed in instructions per second
+    void set_clock_hz(u32 hz);
+
+    u32 get_clock_hz() const {
+        return _clock_hz;
+    }
+
+    /// Sets the emulated CPU speed in instructions per 1/TIMER_HZ frame
+    void set_instructions_per_frame(u32 ipf) {
+        set_clock_hz(ipf * TIMER_HZ);
+    }
+
+    u32 get_instructions_per_frame() const {
+        return _clock_hz / TIMER_HZ;
+    }
+
+    /// Records the state after every frame into rewind, nullptr stops recording
+    void set_rewind(rewind_buffer* rewind) {
+        _rewind = rewind;
+    }
+
+    rewind_buffer* get_rewind() const {
+        return _rewind;
+    }
+
+    /// Renders the sound of every frame into audio, nullptr stops rendering
+    void set_audio(audio_stream* audio) {
+        _audio = audio;
+    }
+
+    audio_stream* get_audio() const {
+        return _audio;
+    }
+
+    /// Restarts rnd's sequence from seed and records the keypad of every following frame
+    /// into m, start right after loading the ROM since a movie replays from power-on
+    void record_movie(movie& m, u64 seed);
+
+    /// Replays m from now on: seeds rnd and sets the clock and quirks m was
+    /// recorded with, then drives the keypad from its events, overriding live key changes
+    /// until it ends. Returns false and prints the error if the loaded ROM isn't m's.
+    bool play_movie(const movie& m);
+
+    /// Stops recording or replaying, a recorded movie is complete up to the last frame run
+    void stop_movie();
+
+    bool recording_movie() const {
+        return _recording;
+    }
+
+    /// Returns true until every frame of the replayed movie ran
+    bool playing_movie() const {
+        return _playing;
+    }
+
+    /// Runs one frame: the instructions due in 1/TIMER_HZ seconds, its sound, then one timer
+    /// tick
+    /// Returns how many instructions ran, none while the debugger holds the chip8 (a frame
+    /// that breaks halfway still ticks the timers)
+    usize run_frame();
+
+    /// Adds `seconds` of host time and runs every whole frame that is due
+    /// Returns how many frames ran
+    u32 advance(double seconds);
+
+    /// Returns the host seconds left until advance() has a whole frame to run
+    double time_to_next_frame() const {
+        double left = 1.0 / TIMER_HZ - _accumulator;
+        return left > 0 ? left : 0;
+    }
+
+    /// Forgets accumulated host time, e.g. after pausing
+    void reset_clock() {
+        _accumulator = 0;
+    }
+
+    /// Returns how many frames ran so far
+    u64 get_frames() const {
+        return _frames;
+    }
+
+    /// Returns how many frames advance() dropped to catch up after a stall
+    u64 get_dropped_frames() const {
+        return _dropped;
+    }
+};
+
+#endif
@@ -0,0 +1,647 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "simd_batch.hpp"
+#include "utils.hpp"
+
+namespace {
+
+// Lane-wise operations on one register of every lane, AVX2 when the build enables it and
+// plain loops the compiler may still vectorise otherwise. Conditions come back as u32 lane
+// masks, bit n set for lane n, which is also how groups of lanes are passed around.
+
+#if defined(__AVX2__)
+
+using vec8 = __m256i; // 32 x u8
+
+struct vec16 { // 32 x u16, lanes 0-15 and 16-31
+    __m256i _lo, _hi;
+};
+
+vec8 load(const lanes<u8>& l) {
+    return _mm256_load_si256(reinterpret_cast<const __m256i*>(l._lane.data()));
+}
+
+void store(lanes<u8>& l, vec8 v) {
+    _mm256_store_si256(reinterpret_cast<__m256i*>(l._lane.data()), v);
+}
+
+vec16 load(const lanes<u16>& l) {
+    auto p = reinterpret_cast<const __m256i*>(l._lane.data());
+    return {_mm256_load_si256(p), _mm256_load_si256(p + 1)};
+}
+
+void store(lanes<u16>& l, vec16 v) {
+    auto p = reinterpret_cast<__m256i*>(l._lane.data());
+    _mm256_store_si256(p, v._lo);
+    _mm256_store_si256(p + 1, v._hi);
+}
+
+vec8 splat8(u8 val) {
+    return _mm256_set1_epi8(static_cast<char>(val));
+}
+
+vec16 splat16(u16 val) {
+    __m256i v = _mm256_set1_epi16(static_cast<short>(val));
+    return {v, v};
+}
+
+/// 0xFF in every lane whose bit is set
+vec8 mask8(u32 bits) {
+    // byte n of each 128-bit half picks the mask byte holding its bit, then tests the bit
+    const __m256i pick = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, //
+                                          2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bit = _mm256_set1_epi64x(static_cast<long long>(0x8040201008040201ULL));
+    __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(bits)), pick);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(v, bit), bit);
+}
+
+__m256i mask16_half(u16 bits) {
+    const __m256i bit = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048,
+                                          4096, 8192, 16384, static_cast<short>(32768));
+    __m256i v = _mm256_and_si256(_mm256_set1_epi16(static_cast<short>(bits)), bit);
+    return _mm256_cmpeq_epi16(v, bit);
+}
+
+vec8 select(u32 bits, vec8 a, vec8 b) {
+    return _mm256_blendv_epi8(b, a, mask8(bits));
+}
+
+vec16 select(u32 bits, vec16 a, vec16 b) {
+    return {_mm256_blendv_epi8(b._lo, a._lo, mask16_half(static_cast<u16>(bits))),
+            _mm256_blendv_epi8(b._hi, a._hi, mask16_half(static_cast<u16>(bits >> 16)))};
+}
+
+vec8 vadd(vec8 a, vec8 b) {
+    return _mm256_add_epi8(a, b);
+}
+
+vec8 vadds(vec8 a, vec8 b) {
+    return _mm256_adds_epu8(a, b);
+}
+
+vec8 vsub(vec8 a, vec8 b) {
+    return _mm256_sub_epi8(a, b);
+}
+
+vec8 vsubs(vec8 a, vec8 b) {
+    return _mm256_subs_epu8(a, b);
+}
+
+vec8 vand(vec8 a, vec8 b) {
+    return _mm256_and_si256(a, b);
+}
+
+vec8 vor(vec8 a, vec8 b) {
+    return _mm256_or_si256(a, b);
+}
+
+vec8 vxor(vec8 a, vec8 b) {
+    return _mm256_xor_si256(a, b);
+}
+
+vec8 vshr(vec8 a, int n) {
+    // no 8-bit shifts, shift 16-bit lanes and drop what crossed in from the upper byte
+    return _mm256_and_si256(_mm256_srli_epi16(a, n), splat8(static_cast<u8>(0xFF >> n)));
+}
+
+vec8 vshl1(vec8 a) {
+    return _mm256_add_epi8(a, a);
+}
+
+u32 eq_bits(vec8 a, vec8 b) {
+    return static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+}
+
+u32 lt_bits(vec8 a, vec8 b) {
+    __m256i le = _mm256_cmpeq_epi8(_mm256_min_epu8(a, b), a);
+    return static_cast<u32>(_mm256_movemask_epi8(le)) & ~eq_bits(a, b);
+}
+
+vec16 vadd(vec16 a, vec16 b) {
+    return {_mm256_add_epi16(a._lo, b._lo), _mm256_add_epi16(a._hi, b._hi)};
+}
+
+vec16 widen(vec8 a) {
+    return {_mm256_cvtepu8_epi16(_mm256_castsi256_si128(a)),
+            _mm256_cvtepu8_epi16(_mm256_extracti128_si256(a, 1))};
+}
+
+vec16 vmul5(vec16 a) {
+    return {_mm256_add_epi16(_mm256_slli_epi16(a._lo, 2), a._lo),
+            _mm256_add_epi16(_mm256_slli_epi16(a._hi, 2), a._hi)};
+}
+
+u32 eq_bits(vec16 a, vec16 b) {
+    // packs interleaves the 128-bit halves, the permute puts the lanes back in order
+    __m256i packed = _mm256_packs_epi16(_mm256_cmpeq_epi16(a._lo, b._lo),
+                                        _mm256_cmpeq_epi16(a._hi, b._hi));
+    packed = _mm256_permute4x64_epi64(packed, 0xD8);
+    return static_cast<u32>(_mm256_movemask_epi8(packed));
+}
+
+#else
+
+using vec8 = std::array<u8, SIMD_LANES>;
+using vec16 = std::array<u16, SIMD_LANES>;
+
+vec8 load(const lanes<u8>& l) {
+    return l._lane;
+}
+
+void store(lanes<u8>& l, const vec8& v) {
+    l._lane = v;
+}
+
+vec16 load(const lanes<u16>& l) {
+    return l._lane;
+}
+
+void store(lanes<u16>& l, const vec16& v) {
+    l._lane = v;
+}
+
+vec8 splat8(u8 val) {
+    vec8 r;
+    r.fill(val);
+    return r;
+}
+
+vec16 splat16(u16 val) {
+    vec16 r;
+    r.fill(val);
+    return r;
+}
+
+vec8 mask8(u32 bits) {
+    vec8 r;
+    for (usize l = 0; l < SIMD_LANES; l++) {
+        r[l] = (bits >> l) & 1 ? 0xFF : 0;
+    }
+    return r;
+}
+
+template <typename V> V select(u32 bits, const V& a, const V& b) {
+    V r;
+    for (usize l = 0; l < SIMD_LANES; l++) {
+        r[l] = (bits >> l) & 1 ? a[l] : b[l];
+    }
+    return r;
+}
+
+template <typename V, typename F> V map(const V& a, const V& b, F fn) {
+    V r;
+    for (usize l = 0; l < SIMD_LANES; l++) {
+        r[l] = fn(a[l], b[l]);
+    }
+    return r;
+}
+
+vec8 vadd(const vec8& a, const vec8& b) {
+    return map(a, b, [](u8 x, u8 y) { return static_cast<u8>(x + y); });
+}
+
+vec8 vadds(const vec8& a, const vec8& b) {
+    return map(a, b, [](u8 x, u8 y) { return static_cast<u8>(x + y > 0xFF ? 0xFF : x + y); });
+}
+
+vec8 vsub(const vec8& a, const vec8& b) {
+    return map(a, b, [](u8 x, u8 y) { return static_cast<u8>(x - y); });
+}
+
+vec8 vsubs(const vec8& a, const vec8& b) {
+    return map(a, b, [](u8 x, u8 y) { return static_cast<u8>(x > y ? x - y : 0); });
+}
+
+vec8 vand(const vec8& a, const vec8& b) {
+    return map(a, b, [](u8 x, u8 y) { return static_cast<u8>(x & y); });
+}
+
+vec8 vor(const vec8& a, const vec8& b) {
+    return map(a, b, [](u8 x, u8 y) { return static_cast<u8>(x | y); });
+}
+
+vec8 vxor(const vec8& a, const vec8& b) {
+    return map(a, b, [](u8 x, u8 y) { return static_cast<u8>(x ^ y); });
+}
+
+vec8 vshr(const vec8& a, int n) {
+    return map(a, a, [n](u8 x, u8) { return static_cast<u8>(x >> n); });
+}
+
+vec8 vshl1(const vec8& a) {
+    return map(a, a, [](u8 x, u8) { return static_cast<u8>(x << 1); });
+}
+
+template <typename V> u32 eq_bits(const V& a, const V& b) {
+    u32 bits = 0;
+    for (usize l = 0; l < SIMD_LANES; l++) {
+        bits |= static_cast<u32>(a[l] == b[l]) << l;
+    }
+    return bits;
+}
+
+u32 lt_bits(const vec8& a, const vec8& b) {
+    u32 bits = 0;
+    for (usize l = 0; l < SIMD_LANES; l++) {
+        bits |= static_cast<u32>(a[l] < b[l]) << l;
+    }
+    return bits;
+}
+
+vec16 vadd(const vec16& a, const vec16& b) {
+    return map(a, b, [](u16 x, u16 y) { return static_cast<u16>(x + y); });
+}
+
+vec16 widen(const vec8& a) {
+    vec16 r;
+    for (usize l = 0; l < SIMD_LANES; l++) {
+        r[l] = a[l];
+    }
+    return r;
+}
+
+vec16 vmul5(const vec16& a) {
+    return map(a, a, [](u16 x, u16) { return static_cast<u16>(x * 5); });
+}
+
+#endif
+
+/// 0 or 1 in every lane, from a lane mask
+vec8 flag(u32 bits) {
+    return vand(mask8(bits), splat8(1));
+}
+
+/// Calls fn(lane) for every lane in bits, lowest first
+template <typename F> void for_each_lane(u32 bits, F fn) {
+    for (; bits; bits &= bits - 1) {
+        fn(static_cast<usize>(std::countr_zero(bits)));
+    }
+}
+
+/// Returns true if simd_batch::exec_vector() handles opcode
+/// display and memory instructions need the lane's chip8, rnd its random sequence. Key
+/// instructions only read each lane's keypad, so they run per lane without leaving the batch.
+bool has_vector_form(u16 opcode) {
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        return opcode == 0x00E0 || opcode == 0x00EE || chip8::is_sys(opcode);
+    case 0x5000:
+    case 0x9000:
+        return (opcode & 0xF) == 0;
+    case 0x8000:
+        return (opcode & 0xF) <= 7 || (opcode & 0xF) == 0xE;
+    case 0xC000:
+    case 0xD000:
+        return false;
+    case 0xE000:
+        return (opcode & 0xFF) == 0x9E || (opcode & 0xFF) == 0xA1;
+    case 0xF000:
+        switch (opcode & 0xFF) {
+        case 0x07:
+        case 0x0A:
+        case 0x15:
+        case 0x18:
+        case 0x1E:
+        case 0x29:
+            return true;
+        default:
+            return false;
+        }
+    default:
+        return true;
+    }
+}
+
+/// Returns true if opcode has a vector form that only matches the default quirks
+/// Lanes with other quirks run these through their own quirk set's handler
+bool depends_on_quirks(u16 opcode) {
+    switch (opcode & 0xF000) {
+    case 0x8000:
+        return (opcode & 0xF) == 0x1 || (opcode & 0xF) == 0x2 || (opcode & 0xF) == 0x3 ||
+               (opcode & 0xF) == 0x6 || (opcode & 0xF) == 0xE;
+    case 0xB000:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+simd_batch::simd_batch(usize count) {
+    count = std::min<usize>(count, SIMD_LANES);
+    for (usize l = 0; l < count; l++) {
+        _lanes.push_back(std::make_unique<chip8>());
+    }
+    _active = count == 32 ? ~0u : (1u << count) - 1;
+}
+
+void simd_batch::tick_timers() {
+    if (!_loaded) {
+        for (auto& vm : _lanes) {
+            vm->tick_timers();
+        }
+        return;
+    }
+    store(_delay_timer, vsubs(load(_delay_timer), splat8(1)));
+    store(_sound_timer, vsubs(load(_sound_timer), splat8(1)));
+    _stale = true;
+}
+
+bool simd_batch::vectorized() {
+#if defined(__AVX2__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void simd_batch::load_lanes() {
+    _code = _lanes.empty() ? std::array<u8, MEMORY_SIZE>{} : _lanes[0]->_memory;
+    _shared = 0;
+    _quirked = 0;
+    for (usize l = 0; l < _lanes.size(); l++) {
+        const chip8& vm = *_lanes[l];
+        if (vm._quirks & ~QUIRK_WRAP) { // drw always runs per lane
+            _quirked |= 1u << l;
+        }
+        for (usize r = 0; r < TOTAL_REGISTERS; r++) {
+            _v[r]._lane[l] = vm._v[r];
+        }
+        for (usize s = 0; s < STACK_SIZE; s++) {
+            _stack[s]._lane[l] = vm._stack[s];
+        }
+        _i._lane[l] = vm._i;
+        _pc._lane[l] = vm._pc;
+        _sp._lane[l] = vm._sp;
+        _delay_timer._lane[l] = vm._delay_timer;
+        _sound_timer._lane[l] = vm._sound_timer;
+
+        if (!std::memcmp(vm._memory.data(), _code.data(), MEMORY_SIZE)) {
+            _shared |= 1u << l;
+        }
+    }
+}
+
+void simd_batch::store_lanes() const {
+    if (!_stale) {
+        return;
+    }
+    _stale = false;
+    for (usize l = 0; l < _lanes.size(); l++) {
+        chip8& vm = *_lanes[l];
+        for (usize r = 0; r < TOTAL_REGISTERS; r++) {
+            vm._v[r] = _v[r]._lane[l];
+        }
+        for (usize s = 0; s < STACK_SIZE; s++) {
+            vm._stack[s] = _stack[s]._lane[l];
+        }
+        vm._i = _i._lane[l];
+        vm._pc = _pc._lane[l];
+        vm._sp = _sp._lane[l];
+        vm._delay_timer = _delay_timer._lane[l];
+        vm._sound_timer = _sound_timer._lane[l];
+    }
+}
+
+usize simd_batch::step(usize cycles) {
+    if (_lanes.empty()) {
+        return 0;
+    }
+
+    if (!_loaded) {
+        load_lanes();
+        _loaded = true;
+    }
+    _stale = true;
+    for (usize n = 0; n < cycles; n++) {
+        cycle();
+    }
+    return cycles;
+}
+
+u16 simd_batch::fetch(usize lane, u16 pc) const {
+    const auto& memory = (_shared >> lane) & 1 ? _code : _lanes[lane]->_memory;
+    return memory[pc & (MEMORY_SIZE - 1)] << 8 | memory[(pc + 1) & (MEMORY_SIZE - 1)];
+}
+
+void simd_batch::cycle() {
+    u32 todo = _active;
+    while (todo) {
+        usize leader = std::countr_zero(todo);
+        u16 pc = _pc._lane[leader];
+        u16 opcode = fetch(leader, pc);
+
+        // every lane at the same pc, minus those whose own memory holds another opcode there
+        u32 group = eq_bits(load(_pc), splat16(pc)) & todo;
+        u32 check = (_shared >> leader) & 1 ? group & ~_shared : group & ~(1u << leader);
+        for_each_lane(check, [&](usize l) {
+            if (fetch(l, pc) != opcode) {
+                group &= ~(1u << l);
+            }
+        });
+        todo &= ~group;
+        _stats.groups++;
+
+        if (exec_vector(opcode, group)) {
+            _stats.vector_insns += std::popcount(group);
+            continue;
+        }
+        for_each_lane(group, [&](usize l) { exec_scalar(l, opcode); });
+        _stats.scalar_insns += std::popcount(group);
+    }
+}
+
+void simd_batch::exec_scalar(usize lane, u16 opcode) {
+    chip8& vm = *_lanes[lane];
+
+    // call and ret always take the vector path, so the stack stays in the SoA arrays
+    for (usize r = 0; r < TOTAL_REGISTERS; r++) {
+        vm._v[r] = _v[r]._lane[lane];
+    }
+    vm._i = _i._lane[lane];
+    vm._pc = _pc._lane[lane] + 2;
+    vm._delay_timer = _delay_timer._lane[lane];
+    vm._sound_timer = _sound_timer._lane[lane];
+    vm._opcode = opcode;
+
+    vm._handlers[opcode](vm);
+
+    for (usize r = 0; r < TOTAL_REGISTERS; r++) {
+        _v[r]._lane[lane] = vm._v[r];
+    }
+    _i._lane[lane] = vm._i;
+    _pc._lane[lane] = vm._pc;
+    _delay_timer._lane[lane] = vm._delay_timer;
+    _sound_timer._lane[lane] = vm._sound_timer;
+
+    u8 idx = chip8::decode_table[opcode];
+    if (idx != INVALID_INSTRUCTION && (chip8::opcode_table[idx]._flags & OP_WRITES_MEMORY)) {
+        _shared &= ~(1u << lane); // its memory may differ from _code from now on
+    }
+}
+
+bool simd_batch::exec_vector(u16 opcode, u32 group) {
+    if (!has_vector_form(opcode) || ((group & _quirked) && depends_on_quirks(opcode))) {
+        return false;
+    }
+
+    u8 x = get_x(opcode);
+    u8 y = get_y(opcode);
+    u8 kk = get_kk(opcode);
+    u16 nnn = get_nnn(opcode);
+
+    // writes only reach the lanes of the group, the others keep their values
+    auto set_v = [&](u8 r, auto val) { store(_v[r], select(group, val, load(_v[r]))); };
+    auto set_pc = [&](u32 lanes, auto val) { store(_pc, select(lanes, val, load(_pc))); };
+    // a skipped F000 nnnn is two words, the lanes that land on one move past it too
+    auto skip = [&](u32 taken) {
+        set_pc(taken & group, vadd(load(_pc), splat16(2)));
+        for_each_lane(taken & group, [&](usize l) {
+            if (fetch(l, _pc._lane[l]) == LONG_I_OPCODE) {
+                _pc._lane[l] += 2;
+            }
+        });
+    };
+
+    set_pc(group, vadd(load(_pc), splat16(2)));
+
+    switch (opcode & 0xF000) {
+    case 0x0000:
+        if (opcode == 0x00E0) {
+            for_each_lane(group, [&](usize l) {
+                _lanes[l]->_video.clear(_lanes[l]->_planes);
+                _lanes[l]->_video_dirty = true;
+            });
+        } else if (opcode == 0x00EE) {
+            for_each_lane(group, [&](usize l) {
+                u8 sp = --_sp._lane[l];
+                _pc._lane[l] = _stack[sp % STACK_SIZE]._lane[l];
+            });
+        }
+        break;
+    case 0x1000:
+        set_pc(group, splat16(nnn));
+        break;
+    case 0x2000:
+        for_each_lane(group, [&](usize l) {
+            u8 sp = _sp._lane[l]++;
+            _stack[sp % STACK_SIZE]._lane[l] = _pc._lane[l];
+        });
+        set_pc(group, splat16(nnn));
+        break;
+    case 0x3000:
+        skip(eq_bits(load(_v[x]), splat8(kk)));
+        break;
+    case 0x4000:
+        skip(~eq_bits(load(_v[x]), splat8(kk)));
+        break;
+    case 0x5000:
+        skip(eq_bits(load(_v[x]), load(_v[y])));
+        break;
+    case 0x6000:
+        set_v(x, splat8(kk));
+        break;
+    case 0x7000:
+        set_v(x, vadd(load(_v[x]), splat8(kk)));
+        break;
+    case 0x8000:
+        // VF is written before Vx, reloading after it keeps chip8.cpp's result when x or y
+        // is F
+        switch (opcode & 0xF) {
+        case 0x0:
+            set_v(x, load(_v[y]));
+            break;
+        case 0x1:
+            set_v(x, vor(load(_v[x]), load(_v[y])));
+            break;
+        case 0x2:
+            set_v(x, vand(load(_v[x]), load(_v[y])));
+            break;
+        case 0x3:
+            set_v(x, vxor(load(_v[x]), load(_v[y])));
+            break;
+        case 0x4: {
+            auto vx = load(_v[x]), vy = load(_v[y]);
+            auto sum = vadd(vx, vy);
+            set_v(0xF, flag(~eq_bits(vadds(vx, vy), sum))); // saturated only on carry
+            set_v(x, sum);
+            break;
+        }
+        case 0x5:
+            set_v(0xF, flag(lt_bits(load(_v[x]), load(_v[y]))));
+            set_v(x, vsub(load(_v[x]), load(_v[y])));
+            break;
+        case 0x6:
+            set_v(0xF, vand(load(_v[x]), splat8(1)));
+            set_v(x, vshr(load(_v[x]), 1));
+            break;
+        case 0x7:
+            set_v(0xF, flag(lt_bits(load(_v[x]), load(_v[y]))));
+            set_v(x, vsub(load(_v[y]), load(_v[x])));
+            break;
+        case 0xE:
+            set_v(0xF, vshr(load(_v[x]), 7));
+            set_v(x, vshl1(load(_v[x])));
+            break;
+        }
+        break;
+    case 0x9000:
+        skip(~eq_bits(load(_v[x]), load(_v[y])));
+        break;
+    case 0xA000:
+        store(_i, select(group, splat16(nnn), load(_i)));
+        break;
+    case 0xB000:
+        set_pc(group, vadd(splat16(nnn), widen(load(_v[0]))));
+        break;
+    case 0xE000: {
+        u32 down = 0;
+        for_each_lane(group, [&](usize l) {
+            if (_lanes[l]->_keypad[_v[x]._lane[l] & 0xF]) {
+                down |= 1u << l;
+            }
+        });
+        skip(kk == 0x9E ? down : ~down);
+        break;
+    }
+    case 0xF000:
+        switch (opcode & 0xFF) {
+        case 0x07:
+            set_v(x, load(_delay_timer));
+            break;
+        case 0x0A:
+            // the lowest key down goes to Vx, lanes without one stay on the wait
+            for_each_lane(group, [&](usize l) {
+                const auto& keypad = _lanes[l]->_keypad;
+                auto key = std::find(keypad.begin(), keypad.end(), 1);
+                if (key == keypad.end()) {
+                    _pc._lane[l] -= 2;
+                } else {
+                    _v[x]._lane[l] = static_cast<u8>(key - keypad.begin());
+                }
+            });
+            break;
+        case 0x15:
+            store(_delay_timer, select(group, load(_v[x]), load(_delay_timer)));
+            break;
+        case 0x18:
+            store(_sound_timer, select(group, load(_v[x]), load(_sound_timer)));
+            break;
+        case 0x1E:
+            store(_i, select(group, vadd(load(_i), widen(load(_v[x]))), load(_i)));
+            break;
+        case 0x29:
+            store(_i, select(group, vmul5(widen(load(_v[x]))), load(_i)));
+            break;
+        }
+        break;
+    }
+    return true;
+}
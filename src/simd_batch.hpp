@@ -0,0 +1,116 @@
+#ifndef SIMD_BATCH_HPP
+#define SIMD_BATCH_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "chip8.hpp"
+#include "types.hpp"
+
+#define SIMD_LANES 32 // instances per batch, a u8 register of all lanes fills a 256-bit vector
+
+/// One register across every lane of a batch
+template <typename T> struct alignas(32) lanes {
+    std::array<T, SIMD_LANES> _lane{};
+};
+
+/// Counters of the instructions run by simd_batch::step()
+struct simd_stats {
+    u64 groups;       // lane groups stepped together, one per distinct pc and cycle
+    u64 vector_insns; // lane instructions executed by the vector path
+    u64 scalar_insns; // lane instructions executed one lane at a time by chip8's handlers
+};
+
+/// Steps up to SIMD_LANES chip8 instances in lockstep, one instruction per lane per cycle
+/// Registers, timers and the stack are kept as structure-of-arrays, so every lane that
+/// shares the current pc (and opcode) executes register instructions with a handful of
+/// vector operations. Memory, video and keypad stay in each lane's chip8; key instructions
+/// read them in place, drw and memory instructions, and opcodes without a vector form, run
+/// per lane through chip8's handlers. Lanes that diverge just form smaller groups and
+/// converge again when their pcs meet. The arrays stay loaded from one step() to the next,
+/// only a lane handed out for changes makes the next step() load them again.
+class simd_batch {
+  private:
+    lanes<u8> _v[TOTAL_REGISTERS];
+    lanes<u16> _i, _pc;
+    lanes<u8> _sp, _delay_timer, _sound_timer;
+    lanes<u16> _stack[STACK_SIZE];
+
+    std::vector<std::unique_ptr<chip8>> _lanes;
+    u32 _active{}; // one bit per lane in use
+
+    // the SoA arrays stay resident between step() calls: _loaded until a lane is handed out
+    // for changes, _stale while the lanes' own registers lag behind the arrays
+    bool _loaded{};
+    mutable bool _stale{};
+
+    // lane 0's memory when the lanes were loaded, lanes in _shared have the same bytes and
+    // never wrote memory since, so their opcodes can be read from here instead of per lane
+    std::array<u8, MEMORY_SIZE> _code{};
+    u32 _shared{};
+    u32 _quirked{}; // lanes whose quirks change instructions that have a vector form
+
+    simd_stats _stats{};
+
+    /// Copies the lanes' registers into the SoA arrays and snapshots the shared code
+    void load_lanes();
+
+    /// Copies the SoA registers back into the lanes if they are stale
+    void store_lanes() const;
+
+    /// Runs one instruction on every active lane
+    void cycle();
+
+    /// Returns the opcode at pc in lane's memory
+    u16 fetch(usize lane, u16 pc) const;
+
+    /// Executes opcode on every lane of group with vector operations, pc already fetched
+    /// Returns false, without touching any state, if opcode has no vector form
+    bool exec_vector(u16 opcode, u32 group);
+
+    /// Executes opcode on one lane with chip8's own handler
+    void exec_scalar(usize lane, u16 opcode);
+
+  public:
+    /// Creates `count` lanes (at most SIMD_LANES), each a freshly constructed chip8
+    explicit simd_batch(usize count = SIMD_LANES);
+
+    simd_batch(const simd_batch&) = delete;
+    simd_batch& operator=(const simd_batch&) = delete;
+
+    usize size() const {
+        return _lanes.size();
+    }
+
+    /// Returns a lane, set it up (ROM, keys, quirks) or inspect it between calls to step()
+    /// The lane's engine setting is ignored, the batch always interprets. The next step()
+    /// reloads every lane since this one may have changed, inspect through the const
+    /// overload to keep the batch resident.
+    chip8& operator[](usize lane) {
+        store_lanes();
+        _loaded = false;
+        return *_lanes[lane];
+    }
+
+    const chip8& operator[](usize lane) const {
+        store_lanes();
+        return *_lanes[lane];
+    }
+
+    /// Runs `cycles` instructions on every lane, returns how many each lane executed
+    usize step(usize cycles);
+
+    /// Ticks the timers of every lane, meant to be called at 60 Hz like chip8::tick_timers()
+    void tick_timers();
+
+    /// Returns the counters accumulated by step()
+    const simd_stats& stats() const {
+        return _stats;
+    }
+
+    /// Returns true if this build executes groups with AVX2, false if with plain lane loops
+    static bool vectorized();
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+#include "types.hpp"
+
+/// Bounded lock-free single producer, single consumer ring buffer
+/// `N` must be a power of two, the queue holds up to N values.
+template <typename T, usize N> class spsc_queue {
+  private:
+    static_assert(N && (N & (N - 1)) == 0, "spsc_queue size must be a power of two");
+
+    std::array<T, N> _ring{};
+    alignas(64) std::atomic<usize> _head{}; // next slot to read, written by the consumer
+    alignas(64) std::atomic<usize> _tail{}; // next slot to write, written by the producer
+
+  public:
+    /// Producer: appends val, returns false without waiting if the queue is full
+    bool push(const T& val) {
+        usize tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        _ring[tail & (N - 1)] = val;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer: removes the oldest value into val, returns false if the queue is empty
+    bool pop(T& val) {
+        usize head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        val = _ring[head & (N - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Producer: appends as many of the n values as fit, returns how many, never waits
+    usize push(const T* vals, usize n) {
+        usize tail = _tail.load(std::memory_order_relaxed);
+        n = std::min(n, N - (tail - _head.load(std::memory_order_acquire)));
+        usize first = std::min(n, N - (tail & (N - 1)));
+        std::copy_n(vals, first, &_ring[tail & (N - 1)]);
+        std::copy_n(vals + first, n - first, &_ring[0]);
+        _tail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    /// Consumer: removes up to n of the oldest values into out, returns how many
+    usize pop(T* out, usize n) {
+        usize head = _head.load(std::memory_order_relaxed);
+        n = std::min(n, _tail.load(std::memory_order_acquire) - head);
+        usize first = std::min(n, N - (head & (N - 1)));
+        std::copy_n(&_ring[head & (N - 1)], first, out);
+        std::copy_n(&_ring[0], n - first, out + first);
+        _head.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    /// Values queued right now, a lower bound on the consumer and an upper one on the producer
+    usize size() const {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+};
+
+#endif
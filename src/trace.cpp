@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "trace.hpp"
+
+namespace {
+
+void put_le(std::vector<u8>& out, u64 val, usize bytes) {
+    for (usize byte = 0; byte < bytes; byte++, val >>= 8) {
+        out.push_back(val & 0xFF);
+    }
+}
+
+u64 get_le(const u8* in, usize bytes) {
+    u64 val = 0;
+    for (usize byte = bytes; byte-- > 0;) {
+        val = val << 8 | in[byte];
+    }
+    return val;
+}
+
+} // namespace
+
+trace_ring::trace_ring(usize capacity)
+    : _entries(std::bit_ceil(std::max<usize>(capacity, 1))), _mask(_entries.size() - 1) {
+}
+
+std::vector<trace_entry> trace_ring::entries() const {
+    u64 held = std::min<u64>(_count, _entries.size());
+    std::vector<trace_entry> out;
+    out.reserve(held);
+    for (u64 n = _count - held; n < _count; n++) {
+        out.push_back(_entries[n & _mask]);
+    }
+    return out;
+}
+
+bool trace_ring::dump(const std::string& filename) const {
+    auto held = entries();
+    std::vector<u8> out(TRACE_MAGIC, TRACE_MAGIC + 4);
+    put_le(out, TRACE_VERSION, 2);
+    put_le(out, sizeof(trace_entry), 2);
+    put_le(out, _count, 8);
+    put_le(out, held.size(), 4);
+    put_le(out, 0, 4);
+    for (const auto& e : held) {
+        put_le(out, e._pc, 2);
+        put_le(out, e._opcode, 2);
+        put_le(out, e._i, 2);
+        out.push_back(e._vx);
+        out.push_back(e._vf);
+    }
+
+    std::ofstream ofs(filename, std::ios_base::binary | std::ios_base::trunc);
+    ofs.write(reinterpret_cast<const char*>(out.data()), out.size());
+    if (!ofs) {
+        fprintf(stderr, "[-] can't write trace %s \n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool load_trace(const std::string& filename, std::vector<trace_entry>& entries, u64& total) {
+    std::ifstream ifs(filename, std::ios_base::binary);
+    if (!ifs) {
+        fprintf(stderr, "[-] trace %s not found \n", filename.c_str());
+        return false;
+    }
+    std::vector<u8> in{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    if (in.size() < TRACE_HEADER_SIZE || std::memcmp(in.data(), TRACE_MAGIC, 4) ||
+        get_le(&in[4], 2) != TRACE_VERSION || get_le(&in[6], 2) != sizeof(trace_entry)) {
+        fprintf(stderr, "[-] %s is not a version %d trace \n", filename.c_str(),
+                TRACE_VERSION);
+        return false;
+    }
+
+    total = get_le(&in[8], 8);
+    u64 count = get_le(&in[16], 4);
+    if (in.size() < TRACE_HEADER_SIZE + count * sizeof(trace_entry)) {
+        fprintf(stderr, "[-] trace %s is truncated \n", filename.c_str());
+        return false;
+    }
+    entries.clear();
+    for (const u8* e = &in[TRACE_HEADER_SIZE]; count--; e += sizeof(trace_entry)) {
+        entries.push_back({static_cast<u16>(get_le(e, 2)), static_cast<u16>(get_le(e + 2, 2)),
+                           static_cast<u16>(get_le(e + 4, 2)), e[6], e[7]});
+    }
+    return true;
+}
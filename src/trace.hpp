@@ -0,0 +1,60 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+#define TRACE_MAGIC "C8TR"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 24
+#define TRACE_DEFAULT_CAPACITY (1u << 16) // entries, 512 KB
+
+/// One executed instruction, state as it was right after it ran
+struct trace_entry {
+    u16 _pc;     // address the opcode was fetched from
+    u16 _opcode;
+    u16 _i;
+    u8 _vx;      // V[x] of the opcode, the register most instructions write
+    u8 _vf;      // flags
+};
+static_assert(sizeof(trace_entry) == 8);
+
+/// Fixed size ring of the last executed instructions of one chip8
+/// Filled by chip8::step() in builds configured with CHIP8_TRACE, see chip8::set_trace().
+///
+/// Dump layout, little-endian: magic, u16 version, u16 entry size, u64 instructions
+/// recorded in total, u32 entries in the dump, u32 reserved, then the entries oldest first
+/// as u16 pc, u16 opcode, u16 I, u8 Vx, u8 VF.
+class trace_ring {
+  private:
+    std::vector<trace_entry> _entries; // power of two sized
+    usize _mask;
+    u64 _count{};
+
+  public:
+    /// Rounds capacity up to a power of two
+    explicit trace_ring(usize capacity = TRACE_DEFAULT_CAPACITY);
+
+    void push(const trace_entry& e) {
+        _entries[_count++ & _mask] = e;
+    }
+
+    /// Returns how many instructions were pushed since construction
+    u64 count() const {
+        return _count;
+    }
+
+    /// Returns the held entries, oldest first
+    std::vector<trace_entry> entries() const;
+
+    /// Writes the held entries to filename, returns false and prints the error on failure
+    bool dump(const std::string& filename) const;
+};
+
+/// Reads a dump written by trace_ring::dump(), `total` is the count() when it was written
+/// Returns false and prints the error on failure
+bool load_trace(const std::string& filename, std::vector<trace_entry>& entries, u64& total);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+
+#include "types.hpp"
+
+/// Lock-free single producer, single consumer handoff of the latest value
+/// The producer fills back() and publish()es it, the consumer acquire()s the newest published
+/// value into front(). Neither side ever waits: three slots mean the producer always has one
+/// to write while the consumer holds another, values nobody acquired in time are replaced.
+template <typename T> class triple_buffer {
+  private:
+    static constexpr u8 FRESH = 0x4; // set in _middle when it holds a value not acquired yet
+
+    std::array<T, 3> _slots{};
+    u8 _back{0};  // producer only
+    u8 _front{1}; // consumer only
+    alignas(64) std::atomic<u8> _middle{2};
+
+    // readable from either thread, each written by one side only
+    alignas(64) std::atomic<u64> _published{};
+    std::atomic<u64> _dropped{};
+    alignas(64) std::atomic<u64> _duplicated{};
+
+  public:
+    /// Producer: the slot to fill before publish()
+    T& back() {
+        return _slots[_back];
+    }
+
+    /// Producer: hands back() over to the consumer, replacing a value it didn't acquire yet
+    void publish() {
+        u8 prev = _middle.exchange(_back | FRESH, std::memory_order_acq_rel);
+        _back = prev & 0x3;
+        _published.fetch_add(1, std::memory_order_relaxed);
+        if (prev & FRESH) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /// Consumer: makes the newest published value front(), returns false (and counts a
+    /// duplicate) if nothing was published since the last call
+    bool acquire() {
+        if (!(_middle.load(std::memory_order_relaxed) & FRESH)) {
+            _duplicated.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & 0x3;
+        return true;
+    }
+
+    /// Consumer: the value of the last successful acquire()
+    const T& front() const {
+        return _slots[_front];
+    }
+
+    /// Values published so far
+    u64 published() const {
+        return _published.load(std::memory_order_relaxed);
+    }
+
+    /// Values replaced before the consumer acquired them
+    u64 dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+    /// acquire() calls that found no new value, so the consumer showed the old one again
+    u64 duplicated() const {
+        return _duplicated.load(std::memory_order_relaxed);
+    }
+};
+
+#endif
@@ -1,7 +1,8 @@
 #ifndef TYPES_HPP
 #define TYPES_HPP
 
-#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
 
 // :D
 
@@ -17,10 +18,6 @@ using u16 = uint16_t;
 using u32 = uint32_t;
 using u64 = uint64_t;
 
-// evil? maybe
-#define MONITOR_WIDTH sf::VideoMode::getDesktopMode().width - 128
-#define MONITOR_HEIGHT sf::VideoMode::getDesktopMode().height - 128
-
 /// Represents a "point" by (x,y)
 typedef struct point { u32 x, y; } point_t;
 
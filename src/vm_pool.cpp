@@ -0,0 +1,142 @@
+#include <algorithm>
+
+#include "vm_pool.hpp"
+
+vm_pool::vm_pool(usize threads) {
+    if (!threads) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (usize idx = 0; idx < threads; idx++) {
+        _queues.push_back(std::make_unique<task_queue>());
+    }
+    for (usize idx = 0; idx < threads; idx++) {
+        _workers.emplace_back(&vm_pool::worker, this, idx);
+    }
+}
+
+vm_pool::~vm_pool() {
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stop = true;
+    }
+    _start.notify_all();
+    for (auto& t : _workers) {
+        t.join();
+    }
+}
+
+chip8& vm_pool::add() {
+    _instances.push_back(std::make_unique<instance>());
+    return _instances.back()->_vm;
+}
+
+void vm_pool::run(u64 cycles, u64 slice) {
+    if (_instances.empty() || !cycles) {
+        return;
+    }
+
+    // contiguous ranges per worker, neighbouring instances stay on one core unless stolen
+    usize per_worker = (_instances.size() + _queues.size() - 1) / _queues.size();
+    for (usize idx = 0; idx < _instances.size(); idx++) {
+        _instances[idx]->_remaining = cycles;
+        auto& queue = *_queues[idx / per_worker];
+        std::lock_guard<std::mutex> guard(queue._lock);
+        queue._tasks.push_back(static_cast<u32>(idx));
+    }
+    for (auto& queue : _queues) {
+        queue->_slices = 0;
+        queue->_steals = 0;
+    }
+
+    std::unique_lock<std::mutex> guard(_lock);
+    _slice = std::max<u64>(slice, 1);
+    _pending = _instances.size();
+    _epoch++;
+    _start.notify_all();
+    _done.wait(guard, [this] { return _pending == 0; });
+}
+
+pool_stats vm_pool::stats() const {
+    pool_stats total{};
+    for (const auto& queue : _queues) {
+        total.slices += queue->_slices;
+        total.steals += queue->_steals;
+    }
+    return total;
+}
+
+bool vm_pool::pop(usize self, u32& task) {
+    auto& queue = *_queues[self];
+    std::lock_guard<std::mutex> guard(queue._lock);
+    if (queue._tasks.empty()) {
+        return false;
+    }
+    task = queue._tasks.back();
+    queue._tasks.pop_back();
+    return true;
+}
+
+bool vm_pool::steal(usize self, u32& task) {
+    for (usize n = 1; n < _queues.size(); n++) {
+        auto& victim = *_queues[(self + n) % _queues.size()];
+        std::unique_lock<std::mutex> guard(victim._lock, std::try_to_lock);
+        if (!guard.owns_lock() || victim._tasks.empty()) {
+            continue;
+        }
+        task = victim._tasks.front();
+        victim._tasks.pop_front();
+        guard.unlock();
+
+        _queues[self]->_steals++;
+        return true;
+    }
+    return false;
+}
+
+void vm_pool::worker(usize self) {
+    u64 seen = 0;
+    while (true) {
+        u64 slice;
+        {
+            std::unique_lock<std::mutex> guard(_lock);
+            _start.wait(guard, [&] { return _stop || _epoch != seen; });
+            if (_stop) {
+                return;
+            }
+            seen = _epoch;
+            slice = _slice;
+        }
+
+        while (_pending.load(std::memory_order_acquire)) {
+            u32 task;
+            if (!pop(self, task) && !steal(self, task)) {
+                std::this_thread::yield(); // everything left is being run by other workers
+                continue;
+            }
+
+            auto& inst = *_instances[task];
+            u64 n = std::min(slice, inst._remaining);
+            inst._remaining -= n;
+            while (n) {
+                u64 part = std::min(n, _ipf - inst._frame);
+                inst._vm.step(part);
+                n -= part;
+                inst._frame += part;
+                if (inst._frame == _ipf) {
+                    inst._vm.tick_timers();
+                    inst._frame = 0;
+                }
+            }
+            _queues[self]->_slices++;
+
+            if (inst._remaining) {
+                std::lock_guard<std::mutex> guard(_queues[self]->_lock);
+                _queues[self]->_tasks.push_back(task);
+            } else if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> guard(_lock);
+                _done.notify_all();
+            }
+        }
+    }
+}
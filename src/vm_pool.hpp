@@ -0,0 +1,106 @@
+#ifndef VM_POOL_HPP
+#define VM_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+#include "scheduler.hpp"
+#include "types.hpp"
+
+#define CACHE_LINE_SIZE 64
+#define POOL_SLICE 4096 // instructions an instance runs before its worker picks the next task
+
+/// Scheduler counters of the last vm_pool::run()
+struct pool_stats {
+    u64 slices; // tasks executed
+    u64 steals; // tasks taken from another worker's queue
+};
+
+/// Steps many independent chip8 instances on a work-stealing thread pool, ticking the timers
+/// of every instance after each of its frames like scheduler::run_frame()
+/// Every instance is its own cache line aligned allocation, so workers never share lines
+/// while stepping. Each worker owns a queue of instance indices, runs one slice of the task
+/// at its back and pushes it back if it isn't done; idle workers steal from the front of
+/// the other queues.
+class vm_pool {
+  private:
+    struct alignas(CACHE_LINE_SIZE) instance {
+        chip8 _vm;
+        u64 _remaining{}; // only touched by the worker holding the task
+        u64 _frame{};     // instructions run since the last timer tick, likewise
+    };
+
+    struct alignas(CACHE_LINE_SIZE) task_queue {
+        std::mutex _lock;
+        std::deque<u32> _tasks;
+        // owner-only counters, complete once run() returns
+        u64 _slices{};
+        u64 _steals{};
+    };
+
+    std::vector<std::unique_ptr<instance>> _instances;
+    std::vector<std::unique_ptr<task_queue>> _queues; // one per worker
+    std::vector<std::thread> _workers;
+
+    // run state, published to the workers by bumping _epoch under _lock
+    std::mutex _lock;
+    std::condition_variable _start, _done;
+    u64 _epoch{};
+    bool _stop{};
+    u64 _slice{POOL_SLICE};
+    u64 _ipf{DEFAULT_CLOCK_HZ / TIMER_HZ};
+    alignas(CACHE_LINE_SIZE) std::atomic<usize> _pending{};
+
+    void worker(usize self);
+    bool pop(usize self, u32& task);
+    bool steal(usize self, u32& task);
+
+  public:
+    /// Starts `threads` workers, 0 means one per hardware thread
+    explicit vm_pool(usize threads = 0);
+    ~vm_pool();
+
+    vm_pool(const vm_pool&) = delete;
+    vm_pool& operator=(const vm_pool&) = delete;
+
+    /// Sets how many instructions make one 1/TIMER_HZ frame, between two timer ticks
+    /// Must not be called while run() runs
+    void set_instructions_per_frame(u64 ipf) {
+        _ipf = std::max<u64>(ipf, 1);
+    }
+
+    u64 get_instructions_per_frame() const {
+        return _ipf;
+    }
+
+    /// Adds an instance, set it up (engine, ROM) through the returned reference
+    chip8& add();
+
+    usize size() const {
+        return _instances.size();
+    }
+
+    usize threads() const {
+        return _workers.size();
+    }
+
+    chip8& operator[](usize idx) {
+        return _instances[idx]->_vm;
+    }
+
+    /// Steps every instance `cycles` instructions, `slice` at a time, blocks until all are done
+    /// Must not be called on instances while it runs
+    void run(u64 cycles, u64 slice = POOL_SLICE);
+
+    /// Returns the scheduler counters of the last run()
+    pool_stats stats() const;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "aot.hpp"
+#include "probe.hpp"
+
+#define AOT_RUNNER_IPF 1000 // instructions per timed frame
+#define AOT_CHECK_SLICE 97  // instructions per checked frame, odd so frames end mid-block
+
+// defined by the translation unit chip8_aot generated
+extern const aot_program chip8_aot_program;
+
+namespace {
+
+/// Loads the recompiled ROM into vm
+void load(probe_chip8& vm, engine e) {
+    const auto& program = chip8_aot_program;
+    vm.set_engine(e);
+    vm.set_quirks(program._quirks);
+    vm.set_aot_program(&program);
+    vm.load_rom(std::vector<u8>(program._image + START_ADDR, program._image + program._image_size));
+    vm.set_seed(0);
+}
+
+/// Runs one frame of `ipf` instructions the way the bench lockstep suite does: the scripted
+/// keys of that frame, the instructions, then a timer tick
+void run_frame(probe_chip8& vm, u64 frame, u64 ipf) {
+    script_keys(vm, frame);
+    vm.step(ipf);
+    vm.tick_timers();
+}
+
+/// Returns the wall time of `frames` frames of AOT_RUNNER_IPF instructions in seconds
+double run(probe_chip8& vm, u64 frames) {
+    auto start = std::chrono::steady_clock::now();
+    for (u64 frame = 0; frame < frames; frame++) {
+        run_frame(vm, frame, AOT_RUNNER_IPF);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    u64 cycles = 100'000'000;
+    bool check = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string& arg = argv[i];
+        if ((arg == "-c" || arg == "--cycles") && i + 1 < argc) {
+            cycles = std::stoull(argv[++i]);
+        } else if (arg == "--check") {
+            check = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " <option(s)>\n"
+                      << "Runs " << chip8_aot_program._name << " recompiled ahead of time\n"
+                      << "Options:\n"
+                      << "\t-c,--cycles <n>\tInstructions to execute, in frames of "
+                      << AOT_RUNNER_IPF << " (" << AOT_CHECK_SLICE
+                      << " with --check) with scripted keys and a timer tick\n"
+                      << "\t--check\t\tCompare against the interpreter while running" << std::endl;
+            return 0;
+        }
+    }
+
+    probe_chip8 vm, reference;
+    load(vm, engine::aot);
+    load(reference, engine::interpreter);
+
+    if (check) {
+        // same frames as the bench lockstep suite
+        for (u64 done = 0; done < cycles; done += AOT_CHECK_SLICE) {
+            run_frame(reference, done / AOT_CHECK_SLICE, AOT_CHECK_SLICE);
+            run_frame(vm, done / AOT_CHECK_SLICE, AOT_CHECK_SLICE);
+            if (!vm.same_state(reference)) {
+                u64 cycles_done = done + AOT_CHECK_SLICE;
+                fprintf(stderr, "[-] diverged from the interpreter near pc %03X after %llu cycles\n",
+                        reference.pc(), static_cast<unsigned long long>(cycles_done));
+                return 1;
+            }
+        }
+        printf("%s: %llu cycles match the interpreter\n", chip8_aot_program._name,
+               static_cast<unsigned long long>(cycles));
+        return 0;
+    }
+
+    u64 frames = std::max<u64>(cycles / AOT_RUNNER_IPF, 1);
+    cycles = frames * AOT_RUNNER_IPF;
+    double seconds = run(vm, frames);
+    double reference_seconds = run(reference, frames);
+
+    const auto& stats = vm.get_block_stats();
+    printf("%s: %llu instructions in %llu frames\n", chip8_aot_program._name,
+           static_cast<unsigned long long>(cycles), static_cast<unsigned long long>(frames));
+    printf("  aot          %9.3f ms %14.0f ops/s\n", seconds * 1000.0, cycles / seconds);
+    printf("  interpreter  %9.3f ms %14.0f ops/s\n", reference_seconds * 1000.0,
+           cycles / reference_seconds);
+    printf("  %llu block lookups, %llu misses, %llu invalidations\n",
+           static_cast<unsigned long long>(stats.hits),
+           static_cast<unsigned long long>(stats.misses),
+           static_cast<unsigned long long>(stats.invalidations));
+    if (!vm.same_state(reference)) {
+        fprintf(stderr, "[-] final state differs from the interpreter\n");
+        return 1;
+    }
+}
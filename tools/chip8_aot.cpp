@@ -0,0 +1,43 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "aot.hpp"
+
+int main(int argc, char** argv) {
+    if (argc < 3 || argc > 5) {
+        std::cerr << "Usage: " << argv[0] << " <rom> <output.cpp> [symbol] [quirks]\n"
+                  << "Recompiles a ROM into C++, defining `const aot_program <symbol>`"
+                  << " (default: chip8_aot_program) for the given quirks (as chip8-run -q,"
+                  << " default: none)" << std::endl;
+        return 0;
+    }
+    u8 quirks = 0;
+    if (argc == 5 && !parse_quirks(argv[4], quirks)) {
+        fprintf(stderr, "[-] unknown quirks %s \n", argv[4]);
+        return 1;
+    }
+
+    std::ifstream ifs(argv[1], std::ios_base::binary);
+    if (!ifs) {
+        fprintf(stderr, "[-] ROM %s not found \n", argv[1]);
+        return 1;
+    }
+    std::vector<u8> rom{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    if (START_ADDR + rom.size() > MEMORY_SIZE) {
+        fprintf(stderr, "[-] %s's ROM data exceeds %d bytes \n", argv[1], MEMORY_SIZE);
+        return 1;
+    }
+
+    auto name = std::filesystem::path(argv[1]).filename().string();
+    std::string symbol = argc >= 4 ? argv[3] : "chip8_aot_program";
+
+    std::ofstream ofs(argv[2], std::ios_base::binary);
+    ofs << aot::translate(rom, name, symbol, quirks);
+    if (!ofs) {
+        fprintf(stderr, "[-] can't write %s \n", argv[2]);
+        return 1;
+    }
+}
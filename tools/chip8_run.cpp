@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "audio.hpp"
+#include "chip8.hpp"
+#include "debugger.hpp"
+#include "movie.hpp"
+#include "scheduler.hpp"
+
+#define DEFAULT_INSTRUCTIONS_PER_FRAME (DEFAULT_CLOCK_HZ / TIMER_HZ)
+
+namespace {
+
+/// Key change scheduled by an input script
+struct input_event {
+    u64 frame;
+    u8 key;
+    bool pressed;
+};
+
+/// Where a run stops, see --break and --watch
+struct stop_points {
+    std::vector<u16> breakpoints;
+    std::vector<std::pair<u16, u16>> watches; // inclusive memory ranges
+};
+
+/// Result of one ROM run
+struct run_result {
+    std::string rom;
+    u64 instructions; // executed, idle_skipped not included
+    u64 frames;
+    double seconds;
+    u64 framebuffer_hash;
+    u64 idle_skipped; // instructions counted as run without running them, see --idle-skip
+    break_event stop; // reason none unless a breakpoint or watchpoint ended the run
+};
+
+/// Parses a hex address or `lo-hi` range, e.g. 0x2F0 or 2F0-2FF
+bool parse_range(const std::string& str, std::pair<u16, u16>& range) {
+    char* end;
+    unsigned long lo = strtoul(str.c_str(), &end, 16);
+    unsigned long hi = lo;
+    if (*end == '-') {
+        hi = strtoul(end + 1, &end, 16);
+    }
+    if (end == str.c_str() || *end || lo >= MEMORY_SIZE || hi >= MEMORY_SIZE) {
+        return false;
+    }
+    range = {static_cast<u16>(lo), static_cast<u16>(hi)};
+    return true;
+}
+
+/// Parses an input script, one `<frame> <key> <down|up>` event per line, # starts a comment
+/// Returns false and prints the offending line on errors
+bool load_script(const std::string& filename, std::vector<input_event>& events) {
+    std::ifstream ifs(filename);
+    if (!ifs) {
+        fprintf(stderr, "[-] input script %s not found \n", filename.c_str());
+        return false;
+    }
+
+    std::string line;
+    for (usize number = 1; std::getline(ifs, line); number++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream ss(line);
+        std::string state;
+        u64 frame;
+        unsigned key;
+        if (!(ss >> frame)) {
+            continue; // blank or comment
+        }
+        if (!(ss >> std::hex >> key >> state) || key >= MAX_KEYS ||
+            (state != "down" && state != "up")) {
+            fprintf(stderr, "[-] %s:%zu: expected `<frame> <key 0-F> <down|up>` \n",
+                    filename.c_str(), number);
+            return false;
+        }
+        events.push_back({frame, static_cast<u8>(key), state == "down"});
+    }
+
+    auto by_frame = [](const input_event& l, const input_event& r) {
+        return l.frame < r.frame;
+    };
+    std::stable_sort(events.begin(), events.end(), by_frame);
+    return true;
+}
+
+/// FNV-1a over the visible part of the framebuffer, stable across runs and hosts
+/// XO-CHIP's second plane only counts once something is drawn to it
+u64 hash_framebuffer(const chip8& vm) {
+    const framebuffer& fb = vm.get_framebuffer();
+    u64 hash = 0xCBF29CE484222325;
+    for (usize plane = 0; plane < FRAMEBUFFER_PLANES; plane++) {
+        if (plane && !fb.plane_used(plane)) {
+            continue;
+        }
+        for (usize y = 0; y < fb.height(); y++) {
+            for (usize w = 0; w < fb.width() / 64; w++) {
+                u64 word = fb.row(y, plane)[w];
+                for (usize byte = 0; byte < sizeof(word); byte++, word >>= 8) {
+                    hash = (hash ^ (word & 0xFF)) * 0x100000001B3;
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+/// Escapes a string for a JSON string literal
+std::string json_string(const std::string& str) {
+    std::string out = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+/// Runs rom for `frames` 60 Hz frames of `ipf` instructions, applying events at frame
+/// boundaries. With `record` the run is recorded into it, with `replay` seed, ipf, quirks
+/// and events are ignored and the movie drives the run instead. With `wav` the sound of
+/// every frame is written to that file. The run ends early at the first of `stops` hit.
+run_result run_rom(const std::string& rom, engine e, u8 quirks, bool idle_skip, u64 frames,
+                   u64 ipf, u64 seed, const std::vector<input_event>& events, movie* record,
+                   const movie* replay, const std::string& trace, const std::string& wav,
+                   const stop_points& stops) {
+    chip8 vm;
+    vm.set_engine(e);
+    vm.set_idle_skip(idle_skip);
+    vm.set_quirks(quirks);
+    vm.load_rom(rom);
+    scheduler sched(vm);
+    sched.set_instructions_per_frame(static_cast<u32>(ipf));
+    vm.set_seed(seed);
+    if (record) {
+        sched.record_movie(*record, seed);
+    } else if (replay && !sched.play_movie(*replay)) {
+        exit(1);
+    }
+#ifdef CHIP8_TRACE
+    if (!trace.empty()) {
+        vm.set_trace(TRACE_DEFAULT_CAPACITY);
+    }
+#else
+    (void)trace; // --trace is only parsed in trace builds
+#endif
+    audio_stream audio;
+    wav_sink sink;
+    if (!wav.empty()) {
+        if (!sink.open(wav)) {
+            exit(1);
+        }
+        sched.set_audio(&audio);
+    }
+    for (u16 addr : stops.breakpoints) {
+        vm.debug().set_breakpoint(addr);
+    }
+    for (auto [first, last] : stops.watches) {
+        vm.debug().watch_memory(first, last);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto next = events.begin();
+    u64 instructions = 0;
+    u64 frame = 0;
+    for (; frame < frames && !vm.debug_paused(); frame++) {
+        for (; !replay && next != events.end() && next->frame <= frame; next++) {
+            vm.set_key(next->key, next->pressed);
+        }
+        instructions += sched.run_frame();
+        if (!wav.empty()) {
+            sink.drain(audio); // every frame, so the ring never overflows
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+#ifdef CHIP8_TRACE
+    if (!trace.empty() && !vm.get_trace()->dump(trace)) {
+        exit(1);
+    }
+#endif
+    if (!sink.close()) {
+        exit(1);
+    }
+
+    break_event stop = vm.debug_paused() ? vm.get_debugger()->last_break() : break_event{};
+    u64 skipped = vm.get_idle_skipped();
+    return {rom, instructions - skipped, frame, elapsed.count(), hash_framebuffer(vm), skipped,
+            stop};
+}
+
+void usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " <option(s)> <rom...>\n"
+              << "Runs every ROM headless as fast as possible and prints a JSON report\n"
+              << "Options:\n"
+              << "\t-c,--cycles <n>\tInstructions to run per ROM (default: 1000000)\n"
+              << "\t-f,--frames <n>\tFrames to run per ROM instead of a cycle budget\n"
+              << "\t--ipf <n>\t\tInstructions per frame (default: "
+              << DEFAULT_INSTRUCTIONS_PER_FRAME << ")\n"
+              << "\t-i,--input <file>\tInput script, `<frame> <key> <down|up>` per line\n"
+              << "\t-s,--seed <n>\t\tRandom seed (default: 0)\n"
+              << "\t--record <file>\tRecord the run (seed, ipf, input) into a movie\n"
+              << "\t--replay <file>\tReplay a movie, for its length unless -f is given\n"
+              << "\t--break <addr>\tStop at the instruction at a hex address\n"
+              << "\t--watch <lo[-hi]>\tStop after a write to a hex address or range\n"
+              << "\t--wav <file>\t\tWrite the sound of the run, 16-bit mono "
+              << AUDIO_SAMPLE_RATE << " Hz\n"
+#ifdef CHIP8_TRACE
+              << "\t--trace <file>\tDump the last instructions run, see chip8_trace\n"
+#endif
+              << "\t-q,--quirks <names>\tInterpreter quirks, comma separated: a preset\n"
+              << "\t\t\t(default, vip, schip) and/or shift_vy, memory_i, vf_reset,\n"
+              << "\t\t\tjump_vx, wrap\n"
+              << "\t--idle-skip\t\tSkip the rest of a frame spent in an idle loop (timer or\n"
+              << "\t\t\tkey waits), same results\n"
+              << "\t--wrap\t\tWrap sprites around the screen edges instead of clipping\n"
+              << "\t-e,--engine <name>\tExecution engine (interpreter, cached, jit, aot),\n"
+              << "\t\t\taot runs like cached here, see chip8_aot"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    u64 cycles = 1'000'000;
+    u64 frames = 0;
+    u64 ipf = DEFAULT_INSTRUCTIONS_PER_FRAME;
+    u64 seed = 0;
+    std::string record_file, replay_file, trace_file, wav_file;
+    movie recorded, replay;
+    u8 quirks = 0;
+    bool idle_skip = false;
+    engine e = engine::interpreter;
+    std::vector<input_event> events;
+    std::vector<std::string> roms;
+    stop_points stops;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string& arg = argv[i];
+        if ((arg == "-c" || arg == "--cycles") && i + 1 < argc) {
+            cycles = std::stoull(argv[++i]);
+        } else if ((arg == "-f" || arg == "--frames") && i + 1 < argc) {
+            frames = std::stoull(argv[++i]);
+        } else if (arg == "--ipf" && i + 1 < argc) {
+            ipf = std::max<u64>(1, std::stoull(argv[++i]));
+        } else if (arg == "--idle-skip") {
+            idle_skip = true;
+        } else if (arg == "--wrap") {
+            quirks |= QUIRK_WRAP;
+        } else if ((arg == "-q" || arg == "--quirks") && i + 1 < argc) {
+            u8 parsed;
+            if (!parse_quirks(argv[++i], parsed)) {
+                fprintf(stderr, "[-] unknown quirks %s \n", argv[i]);
+                return 1;
+            }
+            quirks |= parsed;
+        } else if ((arg == "-s" || arg == "--seed") && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--record" && i + 1 < argc) {
+            record_file = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if ((arg == "--break" || arg == "--watch") && i + 1 < argc) {
+            std::pair<u16, u16> range;
+            bool single = arg == "--break";
+            if (!parse_range(argv[++i], range) || (single && range.first != range.second)) {
+                fprintf(stderr, "[-] bad address %s \n", argv[i]);
+                return 1;
+            }
+            if (single) {
+                stops.breakpoints.push_back(range.first);
+            } else {
+                stops.watches.push_back(range);
+            }
+        } else if (arg == "--wav" && i + 1 < argc) {
+            wav_file = argv[++i];
+#ifdef CHIP8_TRACE
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_file = argv[++i];
+#endif
+        } else if ((arg == "-i" || arg == "--input") && i + 1 < argc) {
+            if (!load_script(argv[++i], events)) {
+                return 1;
+            }
+        } else if ((arg == "-e" || arg == "--engine") && i + 1 < argc &&
+                   parse_engine(argv[i + 1], e)) {
+            i++;
+        } else if (arg[0] != '-') {
+            roms.push_back(arg);
+        } else {
+            usage(argv[0]);
+            return 0;
+        }
+    }
+
+    if (roms.empty()) {
+        usage(argv[0]);
+        return 0;
+    }
+    for (const auto& rom : roms) {
+        if (!std::filesystem::is_regular_file(rom)) {
+            fprintf(stderr, "[-] ROM %s not found \n", rom.c_str());
+            return 1;
+        }
+    }
+    bool one_rom = !record_file.empty() || !trace_file.empty() || !wav_file.empty();
+    if (one_rom && roms.size() != 1) {
+        fprintf(stderr, "[-] --record, --trace and --wav take exactly one ROM \n");
+        return 1;
+    }
+    if (!replay_file.empty()) {
+        if (!load_movie(replay_file, replay)) {
+            return 1;
+        }
+        ipf = std::max<u64>(1, replay._clock_hz / TIMER_HZ);
+        quirks = static_cast<u8>(replay._quirks);
+        frames = frames ? frames : replay._frames;
+    }
+    if (!frames) {
+        frames = (cycles + ipf - 1) / ipf;
+    }
+
+    std::vector<run_result> results;
+    for (const auto& rom : roms) {
+        results.push_back(run_rom(rom, e, quirks, idle_skip, frames, ipf, seed, events,
+                                  record_file.empty() ? nullptr : &recorded,
+                                  replay_file.empty() ? nullptr : &replay, trace_file,
+                                  wav_file, stops));
+    }
+    if (!record_file.empty() && !save_movie(record_file, recorded)) {
+        return 1;
+    }
+
+    // instructions and instructions_per_second count what ran, idle_skipped what didn't
+    u64 total_instructions = 0;
+    u64 total_skipped = 0;
+    double total_seconds = 0;
+    printf("{\n  \"engine\": \"%s\",\n  \"quirks\": \"%s\",\n"
+           "  \"instructions_per_frame\": %llu,\n  \"roms\": [\n",
+           engine_name(e), quirks_name(quirks).c_str(), static_cast<unsigned long long>(ipf));
+    for (usize idx = 0; idx < results.size(); idx++) {
+        const auto& r = results[idx];
+        total_instructions += r.instructions;
+        total_skipped += r.idle_skipped;
+        total_seconds += r.seconds;
+        printf("    {\"rom\": %s, \"frames\": %llu, \"instructions\": %llu, "
+               "\"wall_time_s\": %.6f, \"instructions_per_second\": %.0f, "
+               "\"framebuffer_hash\": \"%016llx\", \"idle_skipped\": %llu",
+               json_string(r.rom).c_str(), static_cast<unsigned long long>(r.frames),
+               static_cast<unsigned long long>(r.instructions), r.seconds,
+               r.instructions / r.seconds,
+               static_cast<unsigned long long>(r.framebuffer_hash),
+               static_cast<unsigned long long>(r.idle_skipped));
+        if (r.stop._reason != break_event::reason::none) {
+            printf(", \"break\": {\"reason\": \"%s\", \"pc\": \"0x%03X\", "
+                   "\"addr\": \"0x%03X\"}",
+                   break_reason_name(r.stop._reason), r.stop._pc, r.stop._addr);
+        }
+        printf("}%s\n", idx + 1 < results.size() ? "," : "");
+    }
+    printf("  ],\n  \"instructions\": %llu,\n  \"idle_skipped\": %llu,\n"
+           "  \"wall_time_s\": %.6f,\n  \"instructions_per_second\": %.0f\n}\n",
+           static_cast<unsigned long long>(total_instructions),
+           static_cast<unsigned long long>(total_skipped), total_seconds,
+           total_instructions / total_seconds);
+}
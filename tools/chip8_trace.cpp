@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+#include "trace.hpp"
+
+namespace {
+
+void usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " <option(s)> <trace>\n"
+              << "Prints an instruction trace dumped by a CHIP8_TRACE build, oldest first\n"
+              << "Options:\n"
+              << "\t-n,--last <n>\tOnly the last n instructions\n"
+              << "\t--pc <addr>\tOnly instructions fetched from addr (hex)" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    u64 last = 0;
+    int pc = -1;
+    std::string filename;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string& arg = argv[i];
+        if ((arg == "-n" || arg == "--last") && i + 1 < argc) {
+            last = std::stoull(argv[++i]);
+        } else if (arg == "--pc" && i + 1 < argc) {
+            pc = std::stoi(argv[++i], nullptr, 16);
+        } else if (arg[0] != '-' && filename.empty()) {
+            filename = arg;
+        } else {
+            usage(argv[0]);
+            return 0;
+        }
+    }
+    if (filename.empty()) {
+        usage(argv[0]);
+        return 0;
+    }
+
+    std::vector<trace_entry> entries;
+    u64 total;
+    if (!load_trace(filename, entries, total)) {
+        return 1;
+    }
+
+    // index of the first held entry among every instruction the trace saw
+    u64 first = total - entries.size();
+    usize start = last && last < entries.size() ? entries.size() - last : 0;
+    printf("# %llu instructions traced, %zu held, from #%llu\n",
+           static_cast<unsigned long long>(total), entries.size(),
+           static_cast<unsigned long long>(first));
+    for (usize n = start; n < entries.size(); n++) {
+        const auto& e = entries[n];
+        if (pc >= 0 && e._pc != pc) {
+            continue;
+        }
+        std::string name = chip8::instruction_name(chip8::instruction_index(e._opcode));
+        printf("#%-10llu %03X: %04X  %-8s I=%03X V%X=%02X VF=%02X\n",
+               static_cast<unsigned long long>(first + n), e._pc, e._opcode, name.c_str(),
+               e._i, (e._opcode >> 8) & 0xF, e._vx, e._vf);
+    }
+}